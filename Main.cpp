@@ -1,9 +1,13 @@
 #include <GL/glew.h>
 #include <GL/freeglut.h>
+#include "AnalyticShape.h"
 #include "GLRenderer.h"
 #include "MeshReader.h"
 #include "MeshSweeper.h"
+#include "PathTracer.h"
+#include "SamplerBenchmark.h"
 #include "Scene.h"
+#include "WavefrontTracer.h"
 
 #define WIN_W 800
 #define WIN_H 600
@@ -28,6 +32,21 @@ const float ZOOM_SCALE = 1.01f;
 bool animateFlag;
 const int UPDATE_RATE = 40;
 
+// Ray tracer globals
+bool watertightFlag;
+bool wavefrontFlag;
+bool pathTracingFlag;
+bool progressiveFlag;
+bool adaptiveFlag;
+bool packetFlag = true;
+RayTracer* progressiveTracer;
+GLImagePresenter* presenter;
+const int MAX_PASSES = 256;
+
+// Spherical light globals
+Light* sphericalLight;
+const REAL SPHERICAL_LIGHT_RADIUS = 1;
+
 inline void
 printControls()
 {
@@ -40,7 +59,18 @@ printControls()
     "(+) zoom in      (-) zoom out\n"
     "GL render mode controls:\n"
     "------------------------\n"
-    "(,) wireframe    (/) Smooth\n\n");
+    "(,) wireframe    (/) Smooth\n"
+    "Ray tracer controls:\n"
+    "--------------------\n"
+    "(r) ray trace the current view into rt.ppm\n"
+    "(v) toggle wavefront ray tracing for (r)\n"
+    "(i) toggle path tracing for (r) and (g)\n"
+    "(b) benchmark the samplers of the path tracer\n"
+    "(e) toggle adaptive sampling for (r) and (g)\n"
+    "(g) toggle progressive ray traced view\n"
+    "(k) toggle ray packets for (r) and (g)\n"
+    "(t) toggle watertight ray/triangle test\n"
+    "(l) toggle a spherical light (soft shadows in path tracing)\n\n");
 }
 
 void
@@ -110,11 +140,30 @@ initGL(int *argc, char **argv)
   glutReportErrors();
 }
 
+void
+drawProgressive()
+{
+  int w = glutGet(GLUT_WINDOW_WIDTH);
+  int h = glutGet(GLUT_WINDOW_HEIGHT);
+
+  progressiveTracer->setImageSize(w, h);
+  progressiveTracer->watertight = watertightFlag;
+  progressiveTracer->render();
+  glViewport(0, 0, w, h);
+  presenter->draw(progressiveTracer->getFrameBuffer(), w, h);
+  // Keep refining the image while the view does not change
+  if (progressiveTracer->getNumberOfPasses() < MAX_PASSES)
+    glutPostRedisplay();
+}
+
 void
 displayCallback()
 {
   processKeys();
-  renderer->render();
+  if (progressiveFlag)
+    drawProgressive();
+  else
+    renderer->render();
   glutSwapBuffers();
 }
 
@@ -162,6 +211,75 @@ idleCallback()
   }
 }
 
+RayTracer*
+newTracer()
+{
+  Camera* camera = renderer->getCamera();
+  RayTracer* tracer;
+
+  if (pathTracingFlag)
+    tracer = new PathTracer(*scene, camera);
+  else if (wavefrontFlag)
+    tracer = new WavefrontTracer(*scene, camera);
+  else
+    tracer = new RayTracer(*scene, camera);
+  tracer->bvhCacheDirectory = ".";
+  tracer->adaptive = adaptiveFlag;
+  tracer->packets = packetFlag;
+  return tracer;
+}
+
+void
+newProgressiveTracer()
+{
+  delete progressiveTracer;
+  progressiveTracer = newTracer();
+  progressiveTracer->progressive = true;
+  // One path per pixel per frame
+  if (pathTracingFlag)
+    ((PathTracer*)progressiveTracer)->samplesPerPixel = 1;
+}
+
+void
+rayTrace()
+{
+  RayTracer* tracer = newTracer();
+  RayTracer& rt = *tracer;
+
+  rt.setImageSize(glutGet(GLUT_WINDOW_WIDTH), glutGet(GLUT_WINDOW_HEIGHT));
+  rt.watertight = watertightFlag;
+  rt.render();
+  if (rt.saveImage("rt.ppm"))
+    printf("Ray traced image saved to rt.ppm "
+      "(%s test: %.3f s, BVH build %.3f s)\n",
+      watertightFlag ? "watertight" : "fast",
+      rt.getRenderTime(),
+      rt.getBuildTime());
+  if (pathTracingFlag)
+  {
+    PathTracer& pt = (PathTracer&)rt;
+
+    printf("Path tracing: %lld samples in %.3f s (%.0f samples/s)\n",
+      pt.getNumberOfSamples(),
+      pt.getSampleTime(),
+      pt.getSamplesPerSecond());
+  }
+  else if (wavefrontFlag)
+  {
+    WavefrontTracer& wt = (WavefrontTracer&)rt;
+
+    printf("Wavefront: %lld rays, %lld shadow rays\n",
+      wt.getNumberOfRays(),
+      wt.getNumberOfShadowRays());
+  }
+  else
+    rt.getTileScheduler().printStats();
+  if (adaptiveFlag && rt.saveHeatmap("heatmap.ppm"))
+    printf("Sample heatmap saved to heatmap.ppm (%d converged tiles)\n",
+      rt.getNumberOfConvergedTiles());
+  delete tracer;
+}
+
 void
 keyboardCallback(unsigned char key, int /*x*/, int /*y*/)
 {
@@ -183,34 +301,126 @@ keyboardUpCallback(unsigned char key, int /*x*/, int /*y*/)
       glutIdleFunc(animateFlag ? idleCallback : 0);
       glutPostRedisplay();
       break;
+    case 'r':
+      rayTrace();
+      break;
+    case 'g':
+      progressiveFlag ^= true;
+      if (progressiveTracer == 0)
+      {
+        newProgressiveTracer();
+        presenter = new GLImagePresenter();
+      }
+      progressiveTracer->resetAccumulation();
+      glutPostRedisplay();
+      break;
+    case 'v':
+      wavefrontFlag ^= true;
+      printf("Wavefront ray tracing %s\n", wavefrontFlag ? "on" : "off");
+      break;
+    case 'b':
+      // A quarter of the window size keeps the reference fast
+      benchmarkSamplers(*scene,
+        renderer->getCamera(),
+        glutGet(GLUT_WINDOW_WIDTH) / 4,
+        glutGet(GLUT_WINDOW_HEIGHT) / 4);
+      break;
+    case 'e':
+      adaptiveFlag ^= true;
+      printf("Adaptive sampling %s\n", adaptiveFlag ? "on" : "off");
+      if (progressiveTracer != 0)
+      {
+        progressiveTracer->adaptive = adaptiveFlag;
+        progressiveTracer->resetAccumulation();
+      }
+      glutPostRedisplay();
+      break;
+    case 'i':
+      pathTracingFlag ^= true;
+      printf("Path tracing %s\n", pathTracingFlag ? "on" : "off");
+      if (progressiveTracer != 0)
+        newProgressiveTracer();
+      glutPostRedisplay();
+      break;
+    case 'k':
+      packetFlag ^= true;
+      printf("Ray packets %s\n", packetFlag ? "on" : "off");
+      if (progressiveTracer != 0)
+        progressiveTracer->packets = packetFlag;
+      glutPostRedisplay();
+      break;
+    case 't':
+      watertightFlag ^= true;
+      printf("Watertight ray/triangle test %s\n",
+        watertightFlag ? "on" : "off");
+      if (progressiveTracer != 0)
+        progressiveTracer->resetAccumulation();
+      glutPostRedisplay();
+      break;
+    case 'l':
+      // The light replaces the default light of the renderers
+      if (sphericalLight == 0)
+      {
+        sphericalLight = new Light(vec3(0, 10, 10), Color::gray);
+        sphericalLight->radius = SPHERICAL_LIGHT_RADIUS;
+        scene->addLight(sphericalLight);
+      }
+      else
+      {
+        scene->deleteLight(sphericalLight);
+        sphericalLight = 0;
+      }
+      printf("Spherical light %s\n", sphericalLight != 0 ? "on" : "off");
+      glutPostRedisplay();
+      break;
   }
 }
 
 Actor*
 newActor(
-  TriangleMesh* mesh,
+  Primitive* p,
   const vec3& position = vec3::null(),
   const vec3& size = vec3(1, 1, 1),
   const Color& color = Color::white)
 {
-  Primitive* p = new TriangleMeshShape(mesh);
-
   p->setMaterial(MaterialFactory::New(color));
   p->setTRS(position, quat::identity(), size);
   return new Actor(*p);
 }
 
+Actor*
+newActor(
+  TriangleMesh* mesh,
+  const vec3& position = vec3::null(),
+  const vec3& size = vec3(1, 1, 1),
+  const Color& color = Color::white)
+{
+  return newActor(new TriangleMeshShape(mesh), position, size, color);
+}
+
 void
 createScene()
 {
-  TriangleMesh* s = MeshSweeper::makeSphere();
-
   scene = new Scene("test");
-  scene->addActor(newActor(s, vec3(-3, -3, 0), vec3(1, 1, 1), Color::yellow));
-  scene->addActor(newActor(s, vec3(+3, -3, 0), vec3(2, 1, 1), Color::green));
-  scene->addActor(newActor(s, vec3(+3, +3, 0), vec3(1, 2, 1), Color::red));
-  scene->addActor(newActor(s, vec3(-3, +3, 0), vec3(1, 1, 2), Color::blue));
-  s = MeshReader().execute("f-16.obj");
+  scene->addActor(newActor(new SphereShape(),
+    vec3(-3, -3, 0),
+    vec3(1, 1, 1),
+    Color::yellow));
+  scene->addActor(newActor(new SphereShape(),
+    vec3(+3, -3, 0),
+    vec3(2, 1, 1),
+    Color::green));
+  scene->addActor(newActor(new SphereShape(),
+    vec3(+3, +3, 0),
+    vec3(1, 2, 1),
+    Color::red));
+  scene->addActor(newActor(new SphereShape(),
+    vec3(-3, +3, 0),
+    vec3(1, 1, 2),
+    Color::blue));
+
+  TriangleMesh* s = MeshReader().execute("f-16.obj");
+
   scene->addActor(newActor(s, vec3(2, -4, -10)));
 }
 
@@ -0,0 +1,142 @@
+#ifndef __AnalyticShape_h
+#define __AnalyticShape_h
+
+//[]------------------------------------------------------------------------[]
+//|                                                                          |
+//|                          GVSG Graphics Classes                           |
+//|                               Version 1.0                                |
+//|                                                                          |
+//|              Copyright 2010-2014, Paulo Aristarco Pagliosa              |
+//|              All Rights Reserved.                                        |
+//|                                                                          |
+//[]------------------------------------------------------------------------[]
+//
+//  OVERVIEW: AnalyticShape.h
+//  ========
+//  Class definition for analytic shapes.
+
+#include "Model.h"
+#include "Ray.h"
+#include "TriangleMesh.h"
+
+namespace Graphics
+{ // begin namespace Graphics
+
+
+//////////////////////////////////////////////////////////
+//
+// AnalyticShape: generic analytic shape class
+// =============
+//
+// A primitive whose surface is intersected exactly by the ray tracer,
+// instead of through a tessellation. The shape is defined in its own
+// coordinates and placed in the scene by the primitive matrix, as
+// the vertices of a TriangleMeshShape. The triangle mesh of the shape
+// is only made (by tessellate()) when asked for, e.g., by GLRenderer.
+class AnalyticShape: public Primitive
+{
+public:
+  // Closest intersection with distance in (ray.tMin, ray.tMax) (ray in
+  // shape coordinates). If any, set the distance, the hit point in
+  // shape coordinates (in hit.p) and the unit normal at the hit (in
+  // shape coordinates) and return true; otherwise, hit is untouched
+  virtual bool intersect(const Ray&, Intersection& hit) const = 0;
+
+  // Get the bounds in shape coordinates
+  const Bounds3& getBounds() const
+  {
+    return bounds;
+  }
+
+  Bounds3 boundingBox() const;
+  const TriangleMesh* triangleMesh() const;
+
+protected:
+  Bounds3 bounds;
+
+  virtual TriangleMesh* tessellate() const = 0;
+
+private:
+  mutable ObjectPtr<TriangleMesh> mesh;
+
+}; // AnalyticShape
+
+
+//////////////////////////////////////////////////////////
+//
+// SphereShape: analytic sphere class
+// ===========
+class SphereShape: public AnalyticShape
+{
+public:
+  // Constructor
+  SphereShape(const vec3& center = vec3::null(), REAL radius = 1);
+
+  Object* clone() const;
+  bool intersect(const Ray&, Intersection&) const;
+
+private:
+  vec3 center;
+  REAL radius;
+
+  TriangleMesh* tessellate() const;
+
+}; // SphereShape
+
+
+//////////////////////////////////////////////////////////
+//
+// BoxShape: analytic box class
+// ========
+//
+// Box aligned to the axes of the shape coordinates, given by its
+// center and size.
+class BoxShape: public AnalyticShape
+{
+public:
+  // Constructor
+  BoxShape(const vec3& center = vec3::null(),
+    const vec3& size = vec3(1, 1, 1));
+
+  Object* clone() const;
+  bool intersect(const Ray&, Intersection&) const;
+
+private:
+  TriangleMesh* tessellate() const;
+
+}; // BoxShape
+
+
+//////////////////////////////////////////////////////////
+//
+// CylinderShape: analytic capped cylinder class
+// =============
+//
+// The parameters are those of MeshSweeper::makeCylinder(): one cap is
+// centered at center, with the given normal, and the axis goes height
+// units away from it, along -normal.
+class CylinderShape: public AnalyticShape
+{
+public:
+  // Constructor
+  CylinderShape(const vec3& center,
+    REAL radius,
+    const vec3& normal,
+    REAL height);
+
+  Object* clone() const;
+  bool intersect(const Ray&, Intersection&) const;
+
+private:
+  vec3 center;
+  REAL radius;
+  vec3 axis; // unit vector from the cap at center to the other cap
+  REAL height;
+
+  TriangleMesh* tessellate() const;
+
+}; // CylinderShape
+
+} // end namespace Graphics
+
+#endif // __AnalyticShape_h
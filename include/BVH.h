@@ -0,0 +1,704 @@
+#ifndef __BVH_h
+#define __BVH_h
+
+//[]------------------------------------------------------------------------[]
+//|                                                                          |
+//|                          GVSG Graphics Library                           |
+//|                               Version 1.0                                |
+//|                                                                          |
+//|              Copyright 2007-2014, Paulo Aristarco Pagliosa              |
+//|              All Rights Reserved.                                        |
+//|                                                                          |
+//[]------------------------------------------------------------------------[]
+//
+//  OVERVIEW: BVH.h
+//  ========
+//  Class definitions for bounding volume hierarchy and BVH builder.
+
+#include <chrono>
+#include "Geometry/Bounds3.h"
+#include "Hash.h"
+#include "Object.h"
+#include "Ray.h"
+#include "RayPacket.h"
+#include "SIMD.h"
+#include "ThreadPool.h"
+
+using namespace Ds;
+using namespace Geometry;
+using namespace System;
+
+namespace Graphics
+{ // begin namespace Graphics
+
+#define BVH_MAX_DEPTH 64
+#define BVH_MAX_LEAF_SIZE 0xffff
+#define BVH_MIN_PARALLEL_REFIT 4096
+
+//
+// SAH cost constants
+//
+#define SAH_TRAVERSAL_COST    (REAL)1
+#define SAH_INTERSECTION_COST (REAL)1
+
+//
+// Auxiliary function
+//
+__host__ __device__ inline bool
+intersectBounds3(const Bounds3& b, const Ray& ray, const vec3& invD)
+{
+  const vec3& p1 = b.getMin();
+  const vec3& p2 = b.getMax();
+  REAL t1 = ray.tMin;
+  REAL t2 = ray.tMax;
+
+  for (int i = 0; i < 3; i++)
+  {
+    REAL tNear = (p1[i] - ray.origin[i]) * invD[i];
+    REAL tFar = (p2[i] - ray.origin[i]) * invD[i];
+
+    if (tNear > tFar)
+      dSwap<REAL>(tNear, tFar);
+    if (tNear > t1)
+      t1 = tNear;
+    if (tFar < t2)
+      t2 = tFar;
+    if (t1 > t2)
+      return false;
+  }
+  return true;
+}
+
+class BVHBuilder;
+
+
+//////////////////////////////////////////////////////////
+//
+// BVH: bounding volume hierarchy class
+// ===
+//
+// Nodes are stored in depth-first order: the first child of an
+// interior node immediately follows it in the node array.
+class BVH: public Object
+{
+public:
+  // 32-byte record; node arrays are cache-line-aligned, so a node
+  // never straddles two cache lines
+  struct Node: public CacheAligned
+  {
+    Bounds3 bounds;
+    int index;    // first primitive (leaf) or second child (interior)
+    uint16 count; // number of primitives (0 for interior nodes)
+    uint16 axis;  // split axis (interior nodes)
+
+    bool isLeaf() const
+    {
+      return count != 0;
+    }
+
+  }; // Node
+
+  // Constructor
+  BVH():
+    nodes(0),
+    numberOfNodes(0),
+    primitiveIds(0),
+    numberOfPrimitives(0),
+    numberOfPrimitiveIds(0),
+    buildTime(0),
+    cost(0),
+    buildCost(0)
+  {
+    // do nothing
+  }
+
+  // Destructor
+  ~BVH();
+
+  Bounds3 bounds() const
+  {
+    return numberOfNodes != 0 ? nodes[0].bounds : Bounds3();
+  }
+
+  int getNumberOfNodes() const
+  {
+    return numberOfNodes;
+  }
+
+  int getNumberOfPrimitives() const
+  {
+    return numberOfPrimitives;
+  }
+
+  // Get the size of the primitive id array (greater than the number
+  // of primitives if a builder referenced a primitive in many leaves)
+  int getNumberOfPrimitiveIds() const
+  {
+    return numberOfPrimitiveIds;
+  }
+
+  const Node* getNodes() const
+  {
+    return nodes;
+  }
+
+  const int* getPrimitiveIds() const
+  {
+    return primitiveIds;
+  }
+
+  // Get the time spent in the last build or refit (in seconds)
+  double getBuildTime() const
+  {
+    return buildTime;
+  }
+
+  // Get the SAH cost of the tree
+  REAL getCost() const
+  {
+    return cost;
+  }
+
+  // Get the SAH cost of the tree when it was last built
+  REAL getBuildCost() const
+  {
+    return buildCost;
+  }
+
+  // Get the ratio between the current SAH cost and the cost when
+  // the tree was last built (1 after a build)
+  REAL getDegradation() const
+  {
+    return buildCost > 0 ? cost / buildCost : 1;
+  }
+
+  // Recompute the SAH cost of the tree
+  REAL computeCost() const;
+
+  // Recompute the bounds of the nodes, bottom-up, keeping the tree
+  // topology. boundsOf(primitiveId) returns the bounds of a primitive
+  template <typename BoundsFunction>
+  void refit(const BoundsFunction& boundsOf);
+
+  // Closest hit traversal. The intersector is called as
+  // intersector(primitiveId, ray) for the primitives of each leaf
+  // hit by the ray; it returns true on a hit and must then set
+  // ray.tMax to the hit distance.
+  template <typename Intersector>
+  bool intersect(Ray&, Intersector&) const;
+
+  // Any hit traversal: stops at the first primitive for which
+  // intersector(primitiveId, ray) returns true. Children are visited
+  // in storage order
+  template <typename Intersector>
+  bool occluded(const Ray&, Intersector&) const;
+
+  // Closest hit traversal of the rays in mask of a packet, W rays per
+  // SIMD box test, so that the rays share the node fetches. The
+  // intersector is called as intersector(primitiveId, packet, mask)
+  // for the primitives of each leaf hit by the rays in mask; it
+  // returns the mask of the rays that hit the primitive and must set
+  // their tMax to the hit distances. Subtrees hit by fewer than
+  // RAY_PACKET_MIN_RAYS rays are traversed ray by ray. Return the
+  // mask of the rays hit
+  template <int W, typename Intersector>
+  int intersect(RayPacket&, int mask, Intersector&) const;
+
+  // Any hit traversal of the rays in mask of a packet: a ray stops at
+  // the first primitive for which intersector(primitiveId, packet,
+  // mask) returns a mask with its bit set. Return the mask of the
+  // rays that hit any primitive
+  template <int W, typename Intersector>
+  int occluded(const RayPacket&, int mask, Intersector&) const;
+
+protected:
+  Node* nodes;
+  int numberOfNodes;
+  int* primitiveIds;
+  int numberOfPrimitives;
+  int numberOfPrimitiveIds;
+  double buildTime;
+  REAL cost;
+  REAL buildCost;
+
+private:
+  template <typename BoundsFunction>
+  REAL refitNode(int, const BoundsFunction&, int);
+
+  template <typename Intersector>
+  int intersectRay(int, RayPacket&, int, Intersector&) const;
+  template <typename Intersector>
+  bool occludedRay(int, const RayPacket&, int, Intersector&) const;
+
+  BVH(const BVH&);
+  BVH& operator =(const BVH&);
+
+  friend class BVHBuilder;
+
+}; // BVH
+
+
+//////////////////////////////////////////////////////////
+//
+// BVH inline implementation
+// ===
+template <typename Intersector>
+bool
+BVH::intersect(Ray& ray, Intersector& intersector) const
+{
+  if (numberOfNodes == 0)
+    return false;
+
+  vec3 invD = ray.direction.inverse();
+  bool dirIsNeg[3] = {invD.x < 0, invD.y < 0, invD.z < 0};
+  int stack[BVH_MAX_DEPTH];
+  int top = 0;
+  int current = 0;
+  bool hit = false;
+
+  for (;;)
+  {
+    const Node& node = nodes[current];
+
+    if (intersectBounds3(node.bounds, ray, invD))
+    {
+      if (!node.isLeaf())
+      {
+        // Visit the nearest child first
+        if (dirIsNeg[node.axis])
+        {
+          stack[top++] = current + 1;
+          current = node.index;
+        }
+        else
+        {
+          stack[top++] = node.index;
+          current++;
+        }
+        continue;
+      }
+      for (int i = node.index, e = i + node.count; i < e; i++)
+        if (intersector(primitiveIds[i], ray))
+          hit = true;
+    }
+    if (top == 0)
+      break;
+    current = stack[--top];
+  }
+  return hit;
+}
+
+template <typename Intersector>
+bool
+BVH::occluded(const Ray& ray, Intersector& intersector) const
+{
+  if (numberOfNodes == 0)
+    return false;
+
+  vec3 invD = ray.direction.inverse();
+  int stack[BVH_MAX_DEPTH];
+  int top = 0;
+  int current = 0;
+
+  for (;;)
+  {
+    const Node& node = nodes[current];
+
+    if (intersectBounds3(node.bounds, ray, invD))
+    {
+      if (!node.isLeaf())
+      {
+        stack[top++] = node.index;
+        current++;
+        continue;
+      }
+      for (int i = node.index, e = i + node.count; i < e; i++)
+        if (intersector(primitiveIds[i], ray))
+          return true;
+    }
+    if (top == 0)
+      return false;
+    current = stack[--top];
+  }
+}
+
+template <int W, typename Intersector>
+int
+BVH::intersect(RayPacket& packet, int mask, Intersector& intersector) const
+{
+  if (numberOfNodes == 0)
+    return 0;
+
+  int stack[BVH_MAX_DEPTH];
+  int stackMask[BVH_MAX_DEPTH];
+  int top = 0;
+  int current = 0;
+  int hits = 0;
+
+  for (;;)
+  {
+    const Node& node = nodes[current];
+    int m = packetBoundsHits<W>(node.bounds, packet, mask);
+
+    if (bitCount(m) >= RAY_PACKET_MIN_RAYS)
+    {
+      if (!node.isLeaf())
+      {
+        // Visit first the nearest child for the first ray
+        int i = lowestBit(m);
+
+        stackMask[top] = mask = m;
+        if (packet.direction[node.axis][i] < 0)
+        {
+          stack[top++] = current + 1;
+          current = node.index;
+        }
+        else
+        {
+          stack[top++] = node.index;
+          current++;
+        }
+        continue;
+      }
+      for (int i = node.index, e = i + node.count; i < e; i++)
+        hits |= intersector(primitiveIds[i], packet, m);
+    }
+    else
+      // The packet diverged
+      for (; m != 0; m &= m - 1)
+        hits |= intersectRay(current, packet, lowestBit(m), intersector);
+    if (top == 0)
+      break;
+    current = stack[--top];
+    mask = stackMask[top];
+  }
+  return hits;
+}
+
+template <int W, typename Intersector>
+int
+BVH::occluded(const RayPacket& packet, int mask, Intersector& intersector)
+  const
+{
+  if (numberOfNodes == 0)
+    return 0;
+
+  int stack[BVH_MAX_DEPTH];
+  int stackMask[BVH_MAX_DEPTH];
+  int top = 0;
+  int current = 0;
+  int hits = 0;
+
+  for (;;)
+  {
+    const Node& node = nodes[current];
+    int m = packetBoundsHits<W>(node.bounds, packet, mask & ~hits);
+
+    if (bitCount(m) >= RAY_PACKET_MIN_RAYS)
+    {
+      if (!node.isLeaf())
+      {
+        stackMask[top] = mask = m;
+        stack[top++] = node.index;
+        current++;
+        continue;
+      }
+      for (int i = node.index, e = i + node.count; i < e; i++)
+      {
+        if ((m &= ~hits) == 0)
+          break;
+        hits |= intersector(primitiveIds[i], packet, m);
+      }
+    }
+    else
+      // The packet diverged
+      for (; m != 0; m &= m - 1)
+      {
+        int i = lowestBit(m);
+
+        if (occludedRay(current, packet, i, intersector))
+          hits |= 1 << i;
+      }
+    if (top == 0)
+      break;
+    current = stack[--top];
+    mask = stackMask[top];
+  }
+  return hits;
+}
+
+template <typename Intersector>
+int
+BVH::intersectRay(int root,
+  RayPacket& packet,
+  int i,
+  Intersector& intersector) const
+{
+  Ray ray = packet.getRay(i);
+  vec3 invD(packet.invD[0][i], packet.invD[1][i], packet.invD[2][i]);
+  bool dirIsNeg[3] = {invD.x < 0, invD.y < 0, invD.z < 0};
+  int stack[BVH_MAX_DEPTH];
+  int top = 0;
+  int current = root;
+  int hit = 0;
+
+  for (;;)
+  {
+    const Node& node = nodes[current];
+
+    if (intersectBounds3(node.bounds, ray, invD))
+    {
+      if (!node.isLeaf())
+      {
+        if (dirIsNeg[node.axis])
+        {
+          stack[top++] = current + 1;
+          current = node.index;
+        }
+        else
+        {
+          stack[top++] = node.index;
+          current++;
+        }
+        continue;
+      }
+      for (int k = node.index, e = k + node.count; k < e; k++)
+        if (intersector(primitiveIds[k], packet, 1 << i) != 0)
+        {
+          hit = 1 << i;
+          ray.tMax = packet.tMax[i];
+        }
+    }
+    if (top == 0)
+      return hit;
+    current = stack[--top];
+  }
+}
+
+template <typename Intersector>
+bool
+BVH::occludedRay(int root,
+  const RayPacket& packet,
+  int i,
+  Intersector& intersector) const
+{
+  Ray ray = packet.getRay(i);
+  vec3 invD(packet.invD[0][i], packet.invD[1][i], packet.invD[2][i]);
+  int stack[BVH_MAX_DEPTH];
+  int top = 0;
+  int current = root;
+
+  for (;;)
+  {
+    const Node& node = nodes[current];
+
+    if (intersectBounds3(node.bounds, ray, invD))
+    {
+      if (!node.isLeaf())
+      {
+        stack[top++] = node.index;
+        current++;
+        continue;
+      }
+      for (int k = node.index, e = k + node.count; k < e; k++)
+        if (intersector(primitiveIds[k], packet, 1 << i) != 0)
+          return true;
+    }
+    if (top == 0)
+      return false;
+    current = stack[--top];
+  }
+}
+
+template <typename BoundsFunction>
+void
+BVH::refit(const BoundsFunction& boundsOf)
+{
+  if (numberOfNodes == 0)
+    return;
+
+  std::chrono::high_resolution_clock::time_point start =
+    std::chrono::high_resolution_clock::now();
+  int taskDepth = 0;
+
+  // Spawn about four tasks per thread for large trees
+  if (numberOfNodes >= BVH_MIN_PARALLEL_REFIT)
+    for (int n = ThreadPool::getDefault().size() * 4; n > 1; n >>= 1)
+      taskDepth++;
+
+  REAL c = refitNode(0, boundsOf, taskDepth);
+  REAL area = nodes[0].bounds.area();
+
+  cost = area > 0 ? c / area : 0;
+
+  std::chrono::duration<double> elapsed =
+    std::chrono::high_resolution_clock::now() - start;
+
+  buildTime = elapsed.count();
+}
+
+template <typename BoundsFunction>
+REAL
+BVH::refitNode(int i, const BoundsFunction& boundsOf, int taskDepth)
+{
+  Node& node = nodes[i];
+
+  if (node.isLeaf())
+  {
+    node.bounds.setEmpty();
+    for (int k = node.index, e = k + node.count; k < e; k++)
+      node.bounds.inflate(boundsOf(primitiveIds[k]));
+    return SAH_INTERSECTION_COST * node.count * node.bounds.area();
+  }
+
+  REAL c1;
+  REAL c2;
+
+  if (taskDepth == 0)
+  {
+    c1 = refitNode(i + 1, boundsOf, 0);
+    c2 = refitNode(node.index, boundsOf, 0);
+  }
+  else
+  {
+    TaskGroup group;
+
+    group.run([this, i, &boundsOf, taskDepth, &c1]()
+    {
+      c1 = refitNode(i + 1, boundsOf, taskDepth - 1);
+    });
+    c2 = refitNode(node.index, boundsOf, taskDepth - 1);
+    group.wait();
+  }
+  node.bounds = nodes[i + 1].bounds;
+  node.bounds.inflate(nodes[node.index].bounds);
+  return c1 + c2 + SAH_TRAVERSAL_COST * node.bounds.area();
+}
+
+
+//////////////////////////////////////////////////////////
+//
+// BVHBuilder: generic BVH builder class
+// ==========
+class BVHBuilder
+{
+public:
+  // Primitive reference
+  struct Reference
+  {
+    Bounds3 bounds;
+    vec3 centroid;
+    int index;
+
+  }; // Reference
+
+  int maxPrimitivesInNode;
+
+  // Destructor
+  virtual ~BVHBuilder()
+  {
+    // do nothing
+  }
+
+  // Build bvh from references (which may be reordered)
+  void build(BVH& bvh, Reference* refs, int n)
+  {
+    std::chrono::high_resolution_clock::time_point start =
+      std::chrono::high_resolution_clock::now();
+
+    bvh.numberOfNodes = 0;
+    delete []bvh.nodes;
+    delete []bvh.primitiveIds;
+    bvh.nodes = 0;
+    bvh.primitiveIds = 0;
+    bvh.numberOfPrimitives = bvh.numberOfPrimitiveIds = n;
+    if (n > 0)
+      execute(bvh, refs, n);
+    bvh.cost = bvh.buildCost = bvh.computeCost();
+
+    std::chrono::duration<double> elapsed =
+      std::chrono::high_resolution_clock::now() - start;
+
+    bvh.buildTime = elapsed.count();
+  }
+
+  // Add the settings that affect the built tree to a hash (used
+  // as part of the key of cached trees)
+  virtual void hashSettings(Hash& hash) const
+  {
+    hash.add(maxPrimitivesInNode);
+  }
+
+protected:
+  // Protected constructor
+  BVHBuilder(int maxPrimitives):
+    maxPrimitivesInNode(maxPrimitives)
+  {
+    // do nothing
+  }
+
+  virtual void execute(BVH&, Reference*, int) = 0;
+
+  static BVH::Node*& nodesOf(BVH& bvh)
+  {
+    return bvh.nodes;
+  }
+
+  static int& numberOfNodesOf(BVH& bvh)
+  {
+    return bvh.numberOfNodes;
+  }
+
+  static int*& primitiveIdsOf(BVH& bvh)
+  {
+    return bvh.primitiveIds;
+  }
+
+  static int& numberOfPrimitiveIdsOf(BVH& bvh)
+  {
+    return bvh.numberOfPrimitiveIds;
+  }
+
+  // Copy the subtree rooted at src[i] in depth-first order into dst
+  static int compact(BVH::Node* dst, const BVH::Node* src, int i, int& count);
+
+}; // BVHBuilder
+
+
+//////////////////////////////////////////////////////////
+//
+// SAHBuilder: full sweep SAH BVH builder class
+// ==========
+class SAHBuilder: public BVHBuilder
+{
+public:
+  // Constructor
+  SAHBuilder(int maxPrimitives = 4):
+    BVHBuilder(maxPrimitives)
+  {
+    // do nothing
+  }
+
+  void hashSettings(Hash& hash) const
+  {
+    BVHBuilder::hashSettings(hash.add("SAH"));
+  }
+
+protected:
+  void execute(BVH&, Reference*, int);
+
+private:
+  BVH::Node* nodes;
+  int numberOfNodes;
+  int* primitiveIds;
+  Reference* refs;
+  REAL* areas;
+
+  int buildNode(int, int, int);
+  int makeLeaf(const Bounds3&, int, int);
+
+}; // SAHBuilder
+
+} // end namespace Graphics
+
+#endif // __BVH_h
@@ -0,0 +1,94 @@
+#ifndef __BVHCache_h
+#define __BVHCache_h
+
+//[]------------------------------------------------------------------------[]
+//|                                                                          |
+//|                          GVSG Graphics Library                           |
+//|                               Version 1.0                                |
+//|                                                                          |
+//|              Copyright 2007-2014, Paulo Aristarco Pagliosa              |
+//|              All Rights Reserved.                                        |
+//|                                                                          |
+//[]------------------------------------------------------------------------[]
+//
+//  OVERVIEW: BVHCache.h
+//  ========
+//  Class definition for on-disk triangle mesh BVH cache.
+
+#include <string>
+#include "BVH.h"
+#include "TriangleMesh.h"
+
+namespace Graphics
+{ // begin namespace Graphics
+
+#define BVH_CACHE_VERSION 1
+
+
+//////////////////////////////////////////////////////////
+//
+// BVHCache: on-disk triangle mesh BVH cache class
+// ========
+//
+// BVH builder that loads the tree of a mesh from a cache file, if
+// any, or builds it with another builder and saves it to the cache.
+// The cache files (one per tree) are named after a hash of the mesh
+// vertices and triangles, the settings of the builder and the file
+// format version, and hold the nodes and primitive ids of the tree;
+// invalid or stale files are ignored (and overwritten).
+//
+// Only the binary tree is cached: a TriangleMeshBVH still collapses
+// it into its wide BVH and triangle blocks on every load, which is
+// much cheaper than a build but not free.
+class BVHCache: public BVHBuilder
+{
+public:
+  // Constructor
+  BVHCache(BVHBuilder& aBuilder,
+    const TriangleMesh::Arrays& aData,
+    const std::string& aDirectory):
+    BVHBuilder(aBuilder.maxPrimitivesInNode),
+    builder(aBuilder),
+    data(aData),
+    directory(aDirectory),
+    hit(false)
+  {
+    // do nothing
+  }
+
+  // Get the key of the cache file of the mesh
+  unsigned long long getKey() const;
+
+  // Get the path of the cache file of the mesh
+  std::string getFileName() const;
+
+  // Check if the last build was loaded from the cache
+  bool isHit() const
+  {
+    return hit;
+  }
+
+  void hashSettings(Hash& hash) const
+  {
+    builder.hashSettings(hash);
+  }
+
+protected:
+  void execute(BVH&, Reference*, int);
+
+private:
+  BVHBuilder& builder;
+  const TriangleMesh::Arrays& data;
+  std::string directory;
+  bool hit;
+
+  bool load(BVH&, int, unsigned long long, const std::string&) const;
+  bool save(const BVH&, unsigned long long, const std::string&) const;
+
+  BVHCache& operator =(const BVHCache&);
+
+}; // BVHCache
+
+} // end namespace Graphics
+
+#endif // __BVHCache_h
@@ -0,0 +1,92 @@
+#ifndef __BinnedSAHBuilder_h
+#define __BinnedSAHBuilder_h
+
+//[]------------------------------------------------------------------------[]
+//|                                                                          |
+//|                          GVSG Graphics Library                           |
+//|                               Version 1.0                                |
+//|                                                                          |
+//|              Copyright 2007-2014, Paulo Aristarco Pagliosa              |
+//|              All Rights Reserved.                                        |
+//|                                                                          |
+//[]------------------------------------------------------------------------[]
+//
+//  OVERVIEW: BinnedSAHBuilder.h
+//  ========
+//  Class definition for binned, parallel SAH BVH builder.
+
+#include <atomic>
+#include "BVH.h"
+
+namespace Graphics
+{ // begin namespace Graphics
+
+#define BVH_MAX_BINS 64
+
+
+//////////////////////////////////////////////////////////
+//
+// BinnedSAHBuilder: binned SAH BVH builder class
+// ================
+//
+// The references of a node are binned by their centroids into
+// numberOfBins bins per axis and only the splits between bins are
+// evaluated. Binning of large nodes is split across the threads of
+// the default pool, and subtrees with at least taskThreshold
+// references are built as parallel tasks.
+class BinnedSAHBuilder: public BVHBuilder
+{
+public:
+  int numberOfBins;
+  int taskThreshold;
+
+  // Constructor
+  BinnedSAHBuilder(int maxPrimitives = 4, int bins = 16):
+    BVHBuilder(maxPrimitives),
+    numberOfBins(bins),
+    taskThreshold(4096)
+  {
+    // do nothing
+  }
+
+  void hashSettings(Hash& hash) const
+  {
+    BVHBuilder::hashSettings(hash.add("binned SAH").add(numberOfBins));
+  }
+
+protected:
+  void execute(BVH&, Reference*, int);
+
+private:
+  struct Bin
+  {
+    Bounds3 bounds;
+    Bounds3 centroidBounds;
+    int count;
+
+  }; // Bin
+
+  struct Bins
+  {
+    Bin bins[3][BVH_MAX_BINS];
+
+    void clear(int);
+    void add(const Bins&, int);
+
+  }; // Bins
+
+  BVH::Node* nodes;
+  int* primitiveIds;
+  Reference* refs;
+  int bins;
+  std::atomic<int> numberOfNodes;
+
+  void binReferences(Bins&, int, int, const Bounds3&) const;
+  void buildNode(int, int, int, const Bounds3&, const Bounds3&, int);
+  void makeLeaf(int, const Bounds3&, int, int);
+
+}; // BinnedSAHBuilder
+
+} // end namespace Graphics
+
+#endif // __BinnedSAHBuilder_h
@@ -101,6 +101,50 @@ private:
 
 }; // GLRenderer
 
+
+//////////////////////////////////////////////////////////
+//
+// GLImagePresenter: GL image presenter class
+// ================
+//
+// Draws images rendered on the CPU (e.g., by the ray tracer), given
+// as W x H RGBA pixels (bottom row first), as a texture mapped onto
+// a full-screen triangle. Each image is copied into one of two pixel
+// buffer objects, in turn, from which the texture is updated by an
+// asynchronous transfer; the copy of the next image goes to the other
+// buffer, so it never waits for the transfer of the previous one.
+class GLImagePresenter
+{
+public:
+  // Constructor
+  GLImagePresenter();
+
+  // Destructor
+  ~GLImagePresenter();
+
+  // Draw a float image into the current viewport
+  void draw(const Color*, int, int);
+
+  // Draw an RGBA8 image into the current viewport
+  void draw(const uint8*, int, int);
+
+private:
+  GLSL::Program program;
+  GLuint vao;
+  GLuint texture;
+  GLuint pixelBuffers[2];
+  int pixelBuffer;
+  int width;
+  int height;
+  GLenum pixelType;
+
+  void draw(const void*, int, int, GLenum);
+
+  GLImagePresenter(const GLImagePresenter&);
+  GLImagePresenter& operator =(const GLImagePresenter&);
+
+}; // GLImagePresenter
+
 } // end namespace Graphics
 
 #endif // __GLRenderer_h
@@ -0,0 +1,70 @@
+#ifndef __Hash_h
+#define __Hash_h
+
+//[]------------------------------------------------------------------------[]
+//|                                                                          |
+//|                        GVSG Foundation Classes                           |
+//|                               Version 1.0                                |
+//|                                                                          |
+//|              Copyright 2007-2014, Paulo Aristarco Pagliosa              |
+//|              All Rights Reserved.                                        |
+//|                                                                          |
+//[]------------------------------------------------------------------------[]
+//
+//  OVERVIEW: Hash.h
+//  ========
+//  Class definition for 64-bit hash.
+
+#include <string.h>
+
+namespace System
+{ // begin namespace System
+
+
+//////////////////////////////////////////////////////////
+//
+// Hash: 64-bit FNV-1a hash class
+// ====
+class Hash
+{
+public:
+  // Constructor
+  Hash():
+    value(14695981039346656037ULL)
+  {
+    // do nothing
+  }
+
+  Hash& add(const void* data, size_t size)
+  {
+    const unsigned char* p = (const unsigned char*)data;
+
+    for (size_t i = 0; i < size; i++)
+      value = (value ^ p[i]) * 1099511628211ULL;
+    return *this;
+  }
+
+  Hash& add(const char* s)
+  {
+    return add(s, strlen(s));
+  }
+
+  template <typename T>
+  Hash& add(const T& x)
+  {
+    return add(&x, sizeof(T));
+  }
+
+  unsigned long long getValue() const
+  {
+    return value;
+  }
+
+private:
+  unsigned long long value;
+
+}; // Hash
+
+} // end namespace System
+
+#endif // __Hash_h
@@ -0,0 +1,61 @@
+#ifndef __LBVHBuilder_h
+#define __LBVHBuilder_h
+
+//[]------------------------------------------------------------------------[]
+//|                                                                          |
+//|                          GVSG Graphics Library                           |
+//|                               Version 1.0                                |
+//|                                                                          |
+//|              Copyright 2007-2014, Paulo Aristarco Pagliosa              |
+//|              All Rights Reserved.                                        |
+//|                                                                          |
+//[]------------------------------------------------------------------------[]
+//
+//  OVERVIEW: LBVHBuilder.h
+//  ========
+//  Class definition for linear BVH builder.
+
+#include "BVH.h"
+
+namespace Graphics
+{ // begin namespace Graphics
+
+
+//////////////////////////////////////////////////////////
+//
+// LBVHBuilder: linear (Morton code) BVH builder class
+// ===========
+//
+// The references are sorted by the Morton codes of their centroids
+// (quantized in the centroid bounds) with a parallel radix sort, and
+// the hierarchy is emitted by splitting each range at the highest bit
+// in which its codes differ. Much faster than the SAH builders, at
+// the expense of tree quality; meant for meshes rebuilt every frame.
+class LBVHBuilder: public BVHBuilder
+{
+public:
+  int mortonBits; // 30 (10 bits per axis) or 63 (21 bits per axis)
+  int taskThreshold;
+
+  // Constructor
+  LBVHBuilder(int maxPrimitives = 4, int bits = 30):
+    BVHBuilder(maxPrimitives),
+    mortonBits(bits),
+    taskThreshold(4096)
+  {
+    // do nothing
+  }
+
+  void hashSettings(Hash& hash) const
+  {
+    BVHBuilder::hashSettings(hash.add("LBVH").add(mortonBits));
+  }
+
+protected:
+  void execute(BVH&, Reference*, int);
+
+}; // LBVHBuilder
+
+} // end namespace Graphics
+
+#endif // __LBVHBuilder_h
@@ -49,12 +49,14 @@ public:
   vec3 position;
   Color color;
   Flags flags;
+  REAL radius; // radius of a spherical point light (0 for a point)
 
   // Constructor
   Light(const vec3& p, const Color& c = Color::white):
     position(p),
     color(c),
-    flags(TurnedOn)
+    flags(TurnedOn),
+    radius(0)
   {
     // do nothing
   }
@@ -69,6 +71,12 @@ public:
     flags.enable(Directional, state);
   }
 
+  // Test if the light has no area (a point or directional light)
+  bool isDelta() const
+  {
+    return radius <= 0 || isDirectional();
+  }
+
   bool isTurnedOn() const
   {
     return flags.isSet(TurnedOn);
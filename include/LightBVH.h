@@ -0,0 +1,161 @@
+#ifndef __LightBVH_h
+#define __LightBVH_h
+
+//[]------------------------------------------------------------------------[]
+//|                                                                          |
+//|                          GVSG Graphics Library                           |
+//|                               Version 1.0                                |
+//|                                                                          |
+//|              Copyright 2007-2014, Paulo Aristarco Pagliosa              |
+//|              All Rights Reserved.                                        |
+//|                                                                          |
+//[]------------------------------------------------------------------------[]
+//
+//  OVERVIEW: LightBVH.h
+//  ========
+//  Class definitions for light BVH and light BVH builder.
+
+#include <vector>
+#include "BVH.h"
+#include "Light.h"
+
+namespace Graphics
+{ // begin namespace Graphics
+
+#define LIGHT_BVH_MAX_COST_DEPTH 32
+
+
+//////////////////////////////////////////////////////////
+//
+// LightBVH: light bounding volume hierarchy class
+// ========
+//
+// BVH over the point lights of a scene, with one light per leaf, for
+// sampling a light with probability roughly proportional to its
+// contribution to a shading point in O(log n) time. Each node keeps
+// the power of its lights, per kind of falloff, and the importance of
+// a node to a point P with normal N is its power attenuated from the
+// center of its bounds, times the cosine of the smallest angle between
+// N and its bounding sphere seen from P. A light is sampled by going
+// down from the root, choosing each child with probability
+// proportional to its importance. Directional lights are kept apart
+// and each one is sampled with the same probability as the whole tree.
+class LightBVH: public BVH
+{
+public:
+  // Constructor
+  LightBVH()
+  {
+    // do nothing
+  }
+
+  // Build the hierarchy of the given lights
+  void build(const std::vector<Light*>&);
+
+  int getNumberOfLights() const
+  {
+    return int(lights.size());
+  }
+
+  Light* getLight(int i) const
+  {
+    return lights[i];
+  }
+
+  // Sample a light for the point P with unit normal N with the uniform
+  // random number u. Return the index of the light (or -1 if no light
+  // can reach P) and set pmf to the probability with which it was
+  // sampled
+  int sample(const vec3& P, const vec3& N, REAL u, REAL& pmf) const;
+
+  // Get the probability with which sample() returns light i
+  REAL pmf(const vec3& P, const vec3& N, int i) const;
+
+  // Call f(i) for each light i whose bounds are hit by the ray
+  template <typename Function>
+  void forEachLightHit(const Ray&, const Function& f) const;
+
+private:
+  struct Power
+  {
+    float p[3]; // power of the lights with no, linear and squared falloff
+
+  }; // Power
+
+  std::vector<Light*> lights;
+  std::vector<int> infiniteLights;
+  std::vector<Power> powers; // per node
+  // Path from the root to the leaf of each light: bit k is set if the
+  // second child is taken at depth k
+  std::vector<unsigned long long> trails;
+
+  REAL importance(int, const vec3&, const vec3&) const;
+  REAL infiniteProbability() const;
+  void computePowers(int, int, unsigned long long);
+
+  LightBVH(const LightBVH&);
+  LightBVH& operator =(const LightBVH&);
+
+}; // LightBVH
+
+
+//////////////////////////////////////////////////////////
+//
+// LightBVH inline implementation
+// ========
+template <typename Function>
+void
+LightBVH::forEachLightHit(const Ray& ray, const Function& f) const
+{
+  // The traversal visits all the leaves hit, since no light occludes
+  auto visit = [&f](int i, const Ray&) -> bool
+  {
+    f(i);
+    return false;
+  };
+
+  occluded(ray, visit);
+}
+
+
+//////////////////////////////////////////////////////////
+//
+// LightBVHBuilder: light BVH builder class
+// ===============
+//
+// The references of a node are sorted by their centroids along each
+// axis and split where the sum of the powers of the children times
+// the diagonals of their bounds is minimal, so that the lights are
+// clustered by both position and power. From depth
+// LIGHT_BVH_MAX_COST_DEPTH on, nodes are split at the median.
+class LightBVHBuilder: public BVHBuilder
+{
+public:
+  // Constructor. The power of the primitive i is w[i]
+  LightBVHBuilder(const float* w):
+    BVHBuilder(1),
+    weights(w)
+  {
+    // do nothing
+  }
+
+protected:
+  void execute(BVH&, Reference*, int);
+
+private:
+  const float* weights;
+  BVH::Node* nodes;
+  int numberOfNodes;
+  int* primitiveIds;
+  Reference* refs;
+  std::vector<float> costs;
+
+  int buildNode(int, int, int);
+
+  LightBVHBuilder& operator =(const LightBVHBuilder&);
+
+}; // LightBVHBuilder
+
+} // end namespace Graphics
+
+#endif // __LightBVH_h
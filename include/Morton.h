@@ -0,0 +1,126 @@
+#ifndef __Morton_h
+#define __Morton_h
+
+//[]------------------------------------------------------------------------[]
+//|                                                                          |
+//|                          GVSG Graphics Library                           |
+//|                               Version 1.0                                |
+//|                                                                          |
+//|              Copyright 2007-2014, Paulo Aristarco Pagliosa              |
+//|              All Rights Reserved.                                        |
+//|                                                                          |
+//[]------------------------------------------------------------------------[]
+//
+//  OVERVIEW: Morton.h
+//  ========
+//  Morton code and radix sort functions.
+
+#include <memory.h>
+#include "Core/Global.h"
+#include "ThreadPool.h"
+
+namespace Graphics
+{ // begin namespace Graphics
+
+#define RADIX_SORT_BITS 8
+#define RADIX_SORT_SIZE (1 << RADIX_SORT_BITS)
+
+// uint64 is a long, which is 32 bits wide in Windows
+typedef unsigned long long MortonCode64;
+
+//
+// Spread the 10 lower bits of x, with two zeros between each bit
+//
+inline uint32
+spreadBits(uint32 x)
+{
+  // 10 bits -> 30 bits
+  x &= 0x3ff;
+  x = (x | (x << 16)) & 0x030000ff;
+  x = (x | (x << 8)) & 0x0300f00f;
+  x = (x | (x << 4)) & 0x030c30c3;
+  x = (x | (x << 2)) & 0x09249249;
+  return x;
+}
+
+//
+// Spread the 21 lower bits of x, with two zeros between each bit
+//
+inline MortonCode64
+spreadBits(MortonCode64 x)
+{
+  // 21 bits -> 63 bits
+  x &= 0x1fffff;
+  x = (x | (x << 32)) & 0x001f00000000ffffULL;
+  x = (x | (x << 16)) & 0x001f0000ff0000ffULL;
+  x = (x | (x << 8)) & 0x100f00f00f00f00fULL;
+  x = (x | (x << 4)) & 0x10c30c30c30c30c3ULL;
+  x = (x | (x << 2)) & 0x1249249249249249ULL;
+  return x;
+}
+
+//
+// Sort the n elements of data by the bits [firstBit, lastBit) of their
+// keys, given by key(element), with a least significant digit radix
+// sort. The elements are split into chunks, run in parallel by the
+// default thread pool: each chunk counts its digits, the counts are
+// scanned in (digit, chunk) order and each chunk scatters its elements,
+// which keeps every pass stable. temp must hold n elements. Return the
+// array (data or temp) holding the sorted elements
+//
+template <typename T, typename Key>
+T*
+radixSort(T* data,
+  T* temp,
+  int n,
+  int firstBit,
+  int lastBit,
+  int chunks,
+  const Key& key)
+{
+  if (chunks < 1)
+    chunks = 1;
+
+  int* offsets = new int[chunks * RADIX_SORT_SIZE];
+
+  for (int shift = firstBit; shift < lastBit; shift += RADIX_SORT_BITS)
+  {
+    T* src = data;
+    T* dst = temp;
+
+    memset(offsets, 0, chunks * RADIX_SORT_SIZE * sizeof(int));
+    System::parallelFor(n, chunks,
+      [src, offsets, shift, &key](int c, int begin, int end)
+    {
+      int* count = offsets + c * RADIX_SORT_SIZE;
+
+      for (int i = begin; i < end; i++)
+        count[(key(src[i]) >> shift) & (RADIX_SORT_SIZE - 1)]++;
+    });
+    for (int d = 0, sum = 0; d < RADIX_SORT_SIZE; d++)
+      for (int c = 0; c < chunks; c++)
+      {
+        int count = offsets[c * RADIX_SORT_SIZE + d];
+
+        offsets[c * RADIX_SORT_SIZE + d] = sum;
+        sum += count;
+      }
+    System::parallelFor(n, chunks,
+      [src, dst, offsets, shift, &key](int c, int begin, int end)
+    {
+      int* offset = offsets + c * RADIX_SORT_SIZE;
+
+      for (int i = begin; i < end; i++)
+        dst[offset[(key(src[i]) >> shift) & (RADIX_SORT_SIZE - 1)]++] =
+          src[i];
+    });
+    data = dst;
+    temp = src;
+  }
+  delete []offsets;
+  return data;
+}
+
+} // end namespace Graphics
+
+#endif // __Morton_h
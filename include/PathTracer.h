@@ -0,0 +1,133 @@
+#ifndef __PathTracer_h
+#define __PathTracer_h
+
+//[]------------------------------------------------------------------------[]
+//|                                                                          |
+//|                          GVSG Graphics Library                           |
+//|                               Version 1.0                                |
+//|                                                                          |
+//|              Copyright 2007-2014, Paulo Aristarco Pagliosa              |
+//|              All Rights Reserved.                                        |
+//|                                                                          |
+//[]------------------------------------------------------------------------[]
+//
+//  OVERVIEW: PathTracer.h
+//  ========
+//  Class definition for unidirectional path tracer.
+
+#include <vector>
+#include "PhongBSDF.h"
+#include "LightBVH.h"
+#include "RayTracer.h"
+#include "Sampler.h"
+
+namespace Graphics
+{ // begin namespace Graphics
+
+
+//////////////////////////////////////////////////////////
+//
+// PathTracer: unidirectional path tracer class
+// ==========
+//
+// Each render traces samplesPerPixel paths per pixel (in progressive
+// mode, the average of the paths is accumulated as one pass), whose
+// random numbers are taken from a sampler (by default, an
+// Owen-scrambled Sobol sampler), in aligned pairs of dimensions: one
+// pair for the position in the pixel and four pairs (eight
+// dimensions) for each bounce, the last dimension of which is padding
+// that keeps the pairs aligned. The surface of a material is taken
+// as a Lambertian lobe (diffuse), a normalized Phong lobe (spot and
+// shine), a perfect mirror (specular) and a perfect refractor
+// (transparency and IOR). At each vertex of a path, one of the lights
+// turned on is sampled from a light BVH (see LightBVH), with
+// probability roughly proportional to its contribution, and its
+// direct light is estimated with a shadow ray (next-event
+// estimation); then the path goes on in a direction sampled from one
+// of the lobes, picked according to their reflectances, for at most
+// maxRecursionLevel bounces. From the rouletteDepth-th bounce on,
+// paths are terminated by Russian roulette with a probability that
+// decreases with their throughput.
+//
+// Lights are point or directional lights whose scaled color is taken
+// as the irradiance they produce on a surface facing them, over PI,
+// so that the direct light on a diffuse surface is the same as in the
+// Whitted model of RayTracer. A point light with a radius is a sphere
+// whose radiance makes it as bright as the point light at its center;
+// its direct light is estimated both with a direction sampled in the
+// cone it subtends and with the scattered ray, if the latter hits it,
+// and the two estimates are combined by multiple importance sampling
+// with the power heuristic, which keeps small lights on glossy
+// surfaces free of fireflies. The camera does not see the lights. The
+// primary rays that miss the scene see the background color; the
+// other ones see the ambient light of the scene as a uniform
+// environment.
+//
+// If adaptive is set and progressive is not, a render spends the same
+// budget of samplesPerPixel paths per pixel, but in rounds: after a
+// first round of MIN_ADAPTIVE_SAMPLES paths per pixel, each round
+// gives the tiles that are not converged a number of paths per pixel
+// proportional to their errors (at most doubling the paths of a tile
+// in a round), until the budget is spent or all the tiles converge.
+class PathTracer: public RayTracer
+{
+public:
+  int samplesPerPixel;
+  int rouletteDepth;
+
+  // Constructor
+  PathTracer(Scene&, Camera* = 0);
+
+  Sampler* getSampler() const
+  {
+    return sampler;
+  }
+
+  void setSampler(Sampler* s)
+  {
+    sampler = s;
+    resetAccumulation();
+  }
+
+  // Get the number of paths traced in the last render (in adaptive
+  // mode, possibly less than samplesPerPixel per pixel)
+  long long getNumberOfSamples() const
+  {
+    return numberOfSamples;
+  }
+
+  // Get the time spent tracing paths in the last render (in seconds)
+  double getSampleTime() const
+  {
+    return sampleTime;
+  }
+
+  // Get the number of paths traced per second in the last render
+  double getSamplesPerSecond() const
+  {
+    return sampleTime > 0 ? numberOfSamples / sampleTime : 0;
+  }
+
+protected:
+  ObjectPtr<Sampler> sampler;
+  LightBVH lightBVH;
+  long long numberOfSamples;
+  double sampleTime;
+  std::vector<int> tileSamples; // paths per pixel of each tile in a round
+
+  void scan();
+  void renderTile(int, int, int, int);
+
+  void adaptiveScan();
+  int tileArea(int) const;
+
+  virtual Color tracePath(const Ray&, PixelSampler&);
+  virtual Color directLight(const vec3&, const vec3&, const PhongBSDF&,
+    REAL, REAL, REAL);
+  virtual Color emittedLight(const Ray&, const vec3&, REAL, REAL);
+
+}; // PathTracer
+
+} // end namespace Graphics
+
+#endif // __PathTracer_h
@@ -0,0 +1,95 @@
+#ifndef __PhongBSDF_h
+#define __PhongBSDF_h
+
+//[]------------------------------------------------------------------------[]
+//|                                                                          |
+//|                          GVSG Graphics Library                           |
+//|                               Version 1.0                                |
+//|                                                                          |
+//|              Copyright 2007-2014, Paulo Aristarco Pagliosa              |
+//|              All Rights Reserved.                                        |
+//|                                                                          |
+//[]------------------------------------------------------------------------[]
+//
+//  OVERVIEW: PhongBSDF.h
+//  ========
+//  Class definition for Phong BSDF.
+
+#include "Material.h"
+#include "Math/Vector3.h"
+
+namespace Graphics
+{ // begin namespace Graphics
+
+//
+// BSDF sample
+//
+struct BSDFSample
+{
+  vec3 direction; // unit direction of the scattered ray
+  Color weight;   // BSDF times cosine over pdf
+  bool delta;     // sampled from a mirror or refraction lobe
+
+}; // BSDFSample
+
+
+//////////////////////////////////////////////////////////
+//
+// PhongBSDF: Phong BSDF class
+// =========
+//
+// Scattering of a material surface at a point, as the sum of a
+// Lambertian lobe (diffuse), a normalized Phong lobe around the
+// mirror direction of the viewer (spot and shine), a perfect mirror
+// (specular) and a perfect refractor (transparency). A scattered
+// direction is sampled from one lobe, picked with probability
+// proportional to its reflectance. If the reflectances add up to more
+// than one, all the lobes are scaled down to conserve energy.
+class PhongBSDF
+{
+public:
+  // Constructor. N is the unit normal facing the viewer, V the unit
+  // direction of the incident ray and eta the ratio of the indices of
+  // refraction of the incident and transmitted sides
+  PhongBSDF(const Material::Surface&, const vec3& N, const vec3& V,
+    REAL eta);
+
+  // Test if the BSDF has a diffuse or glossy lobe (if not, lights
+  // do not need to be sampled)
+  bool hasSmoothLobes() const
+  {
+    return pDiffuse + pGlossy > 0;
+  }
+
+  // Evaluate the smooth lobes for the unit direction L
+  Color eval(const vec3& L) const;
+
+  // Get the solid angle density with which sample() returns the unit
+  // direction L from the smooth lobes (mirror and refraction lobes
+  // are not included)
+  REAL pdf(const vec3& L) const;
+
+  // Sample a scattered direction with the uniform random numbers
+  // u0 (lobe), u1 and u2. Return false if the sample was absorbed
+  bool sample(REAL u0, REAL u1, REAL u2, BSDFSample&) const;
+
+private:
+  const Material::Surface& surface;
+  vec3 N;
+  vec3 V;
+  vec3 R; // mirror direction of V
+  REAL eta;
+  float scale; // energy conservation factor
+  // Lobe probabilities
+  REAL pDiffuse;
+  REAL pGlossy;
+  REAL pMirror;
+  REAL pRefraction;
+
+  PhongBSDF& operator =(const PhongBSDF&);
+
+}; // PhongBSDF
+
+} // end namespace Graphics
+
+#endif // __PhongBSDF_h
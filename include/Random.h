@@ -0,0 +1,86 @@
+#ifndef __Random_h
+#define __Random_h
+
+//[]------------------------------------------------------------------------[]
+//|                                                                          |
+//|                        GVSG Foundation Classes                           |
+//|                               Version 1.0                                |
+//|                                                                          |
+//|              Copyright 2007-2014, Paulo Aristarco Pagliosa              |
+//|              All Rights Reserved.                                        |
+//|                                                                          |
+//[]------------------------------------------------------------------------[]
+//
+//  OVERVIEW: Random.h
+//  ========
+//  Class definition for pseudorandom number generator.
+
+#include "Core/Global.h"
+
+namespace System
+{ // begin namespace System
+
+//
+// Integer hash (Wellons' lowbias32)
+//
+inline uint32
+hashInt(uint32 x)
+{
+  x ^= x >> 16;
+  x *= 0x7feb352d;
+  x ^= x >> 15;
+  x *= 0x846ca68b;
+  x ^= x >> 16;
+  return x;
+}
+
+
+//////////////////////////////////////////////////////////
+//
+// Random: PCG32 pseudorandom number generator class
+// ======
+//
+// Small (16 bytes of state: the state and the stream increment) and
+// fast enough to be made per pixel sample; seeds made of a hash of
+// the pixel and sample indices give independent streams.
+class Random
+{
+public:
+  // Constructor
+  Random(unsigned long long seed = 0, unsigned long long sequence = 0):
+    state(0),
+    increment((sequence << 1) | 1)
+  {
+    nextInt();
+    state += seed;
+    nextInt();
+  }
+
+  // Get a random integer in [0, 2^32)
+  uint32 nextInt()
+  {
+    unsigned long long s = state;
+
+    state = s * 6364136223846793005ULL + increment;
+
+    uint32 x = uint32(((s >> 18) ^ s) >> 27);
+    uint32 r = uint32(s >> 59);
+
+    return (x >> r) | (x << ((32 - r) & 31));
+  }
+
+  // Get a random float in [0, 1)
+  float nextFloat()
+  {
+    return (nextInt() >> 8) * (1.0f / 16777216);
+  }
+
+private:
+  unsigned long long state;
+  unsigned long long increment;
+
+}; // Random
+
+} // end namespace System
+
+#endif // __Random_h
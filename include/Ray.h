@@ -0,0 +1,241 @@
+#ifndef __Ray_h
+#define __Ray_h
+
+//[]------------------------------------------------------------------------[]
+//|                                                                          |
+//|                          GVSG Graphics Library                           |
+//|                               Version 1.0                                |
+//|                                                                          |
+//|              Copyright 2007-2014, Paulo Aristarco Pagliosa              |
+//|              All Rights Reserved.                                        |
+//|                                                                          |
+//[]------------------------------------------------------------------------[]
+//
+//  OVERVIEW: Ray.h
+//  ========
+//  Class definitions for ray and ray/object intersection.
+
+#include "Math/Matrix4x4.h"
+
+using namespace Ds;
+
+namespace Graphics
+{ // begin namespace Graphics
+
+//
+// Forward definition
+//
+class Actor;
+
+
+//////////////////////////////////////////////////////////
+//
+// Ray: ray class
+// ===
+struct Ray
+{
+  vec3 origin;
+  vec3 direction;
+  REAL tMin;
+  REAL tMax;
+
+  // Constructors
+  __host__ __device__
+  Ray()
+  {
+    // do nothing
+  }
+
+  __host__ __device__
+  Ray(const vec3& o, const vec3& d,
+    REAL t1 = 0,
+    REAL t2 = FloatInfo<REAL>::inf()):
+    origin(o),
+    direction(d),
+    tMin(t1),
+    tMax(t2)
+  {
+    // do nothing
+  }
+
+  __host__ __device__
+  vec3 operator ()(REAL t) const
+  {
+    return origin + direction * t;
+  }
+
+  // Make a copy of this ray transformed by m
+  __host__ __device__
+  Ray transform(const mat4& m) const
+  {
+    return Ray(m.transform3x4(origin), m.transformVector(direction),
+      tMin,
+      tMax);
+  }
+
+}; // Ray
+
+
+//////////////////////////////////////////////////////////
+//
+// Intersection: ray/object intersection class
+// ============
+struct Intersection
+{
+  REAL distance;     // ray parameter of the hit
+  Actor* actor;      // actor hit
+  int triangleIndex; // index of the triangle hit
+  vec3 p;            // barycentric coordinates of the hit (hit point
+                     // in shape coordinates if triangleIndex < 0)
+  vec3 normal;       // unit normal at the hit (world coordinates)
+
+  // Constructor
+  __host__ __device__
+  Intersection():
+    distance(FloatInfo<REAL>::inf()),
+    actor(0),
+    triangleIndex(-1)
+  {
+    // do nothing
+  }
+
+}; // Intersection
+
+//
+// Auxiliary functions
+//
+__host__ __device__ inline vec3
+transformNormal(const mat4& inverseMatrix, const vec3& N)
+{
+  vec3 n(vec3(inverseMatrix[0]).dot(N),
+    vec3(inverseMatrix[1]).dot(N),
+    vec3(inverseMatrix[2]).dot(N));
+
+  return n.versor();
+}
+
+// Moller-Trumbore ray/triangle intersection
+__host__ __device__ inline bool
+intersectTriangle(
+  const Ray& ray,
+  const vec3& v0,
+  const vec3& v1,
+  const vec3& v2,
+  REAL& t,
+  REAL& b1,
+  REAL& b2)
+{
+  vec3 e1 = v1 - v0;
+  vec3 e2 = v2 - v0;
+  vec3 s1 = ray.direction.cross(e2);
+  REAL d = s1.dot(e1);
+
+  if (Math::isZero<REAL>(d, REAL(1e-12)))
+    return false;
+
+  REAL invD = Math::inverse<REAL>(d);
+  vec3 s = ray.origin - v0;
+
+  if ((b1 = s.dot(s1) * invD) < 0 || b1 > 1)
+    return false;
+
+  vec3 s2 = s.cross(e1);
+
+  if ((b2 = ray.direction.dot(s2) * invD) < 0 || b1 + b2 > 1)
+    return false;
+  t = e2.dot(s2) * invD;
+  return t > ray.tMin && t < ray.tMax;
+}
+
+//
+// Ray shear for watertight ray/triangle intersection: the triangle is
+// translated to the ray origin, its axes are permuted so that z is the
+// dominant axis of the ray direction and it is sheared so that the ray
+// goes along +z
+//
+struct RayShear
+{
+  int kx;
+  int ky;
+  int kz;
+  REAL sx;
+  REAL sy;
+  REAL sz;
+
+  // Constructor
+  __host__ __device__
+  RayShear(const vec3& d)
+  {
+    REAL ax = d.x < 0 ? -d.x : d.x;
+    REAL ay = d.y < 0 ? -d.y : d.y;
+    REAL az = d.z < 0 ? -d.z : d.z;
+
+    kz = ax > ay ? (ax > az ? 0 : 2) : (ay > az ? 1 : 2);
+    kx = kz == 2 ? 0 : kz + 1;
+    ky = kx == 2 ? 0 : kx + 1;
+    // Keep the winding of the triangles
+    if (d[kz] < 0)
+      dSwap<int>(kx, ky);
+    sz = Math::inverse<REAL>(d[kz]);
+    sx = d[kx] * sz;
+    sy = d[ky] * sz;
+  }
+
+}; // RayShear
+
+// Watertight ray/triangle intersection (Woop, Benthin and Wald): rays
+// cannot slip through the edges shared by two triangles
+__host__ __device__ inline bool
+intersectTriangle(
+  const Ray& ray,
+  const RayShear& shear,
+  const vec3& v0,
+  const vec3& v1,
+  const vec3& v2,
+  REAL& t,
+  REAL& b1,
+  REAL& b2)
+{
+  vec3 a = v0 - ray.origin;
+  vec3 b = v1 - ray.origin;
+  vec3 c = v2 - ray.origin;
+  REAL ax = a[shear.kx] - shear.sx * a[shear.kz];
+  REAL ay = a[shear.ky] - shear.sy * a[shear.kz];
+  REAL bx = b[shear.kx] - shear.sx * b[shear.kz];
+  REAL by = b[shear.ky] - shear.sy * b[shear.kz];
+  REAL cx = c[shear.kx] - shear.sx * c[shear.kz];
+  REAL cy = c[shear.ky] - shear.sy * c[shear.kz];
+  // Scaled barycentric coordinates (edge functions)
+  REAL u = cx * by - cy * bx;
+  REAL v = ax * cy - ay * cx;
+  REAL w = bx * ay - by * ax;
+
+  if (u == 0 || v == 0 || w == 0)
+  {
+    // Fall back to double precision on the edges
+    u = REAL((double)cx * by - (double)cy * bx);
+    v = REAL((double)ax * cy - (double)ay * cx);
+    w = REAL((double)bx * ay - (double)by * ax);
+  }
+  if ((u < 0 || v < 0 || w < 0) && (u > 0 || v > 0 || w > 0))
+    return false;
+
+  REAL det = u + v + w;
+
+  if (det == 0)
+    return false;
+
+  REAL invDet = Math::inverse<REAL>(det);
+
+  t = (u * a[shear.kz] + v * b[shear.kz] + w * c[shear.kz]) * shear.sz *
+    invDet;
+  if (!(t > ray.tMin && t < ray.tMax))
+    return false;
+  b1 = v * invDet;
+  b2 = w * invDet;
+  return true;
+}
+
+} // end namespace Graphics
+
+#endif // __Ray_h
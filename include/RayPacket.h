@@ -0,0 +1,422 @@
+#ifndef __RayPacket_h
+#define __RayPacket_h
+
+//[]------------------------------------------------------------------------[]
+//|                                                                          |
+//|                          GVSG Graphics Library                           |
+//|                               Version 1.0                                |
+//|                                                                          |
+//|              Copyright 2007-2014, Paulo Aristarco Pagliosa              |
+//|              All Rights Reserved.                                        |
+//|                                                                          |
+//[]------------------------------------------------------------------------[]
+//
+//  OVERVIEW: RayPacket.h
+//  ========
+//  Class definition for SoA ray packet.
+
+#include "Geometry/Bounds3.h"
+#include "TriangleBlock.h"
+
+namespace Graphics
+{ // begin namespace Graphics
+
+#define RAY_PACKET_SIZE 16
+#define RAY_PACKET_MIN_RAYS 2
+
+//
+// Auxiliary functions
+//
+inline int
+bitCount(int mask)
+{
+  int n = 0;
+
+  for (; mask != 0; mask &= mask - 1)
+    n++;
+  return n;
+}
+
+// Index of the lowest set bit of mask, which must not be 0
+inline int
+lowestBit(int mask)
+{
+  int i = 0;
+
+  for (; (mask & 1) == 0; mask >>= 1)
+    i++;
+  return i;
+}
+
+
+//////////////////////////////////////////////////////////
+//
+// RayPacket: SoA ray packet class
+// =========
+//
+// Up to RAY_PACKET_SIZE rays stored as one float array per coordinate,
+// so that W rays (W = 4 for SSE, 8 for AVX) are tested at once against
+// a box or a triangle. Sets of rays of a packet are given as bit masks.
+struct RayPacket
+{
+  float origin[3][RAY_PACKET_SIZE];
+  float direction[3][RAY_PACKET_SIZE];
+  float invD[3][RAY_PACKET_SIZE];
+  float tMin[RAY_PACKET_SIZE];
+  float tMax[RAY_PACKET_SIZE];
+  int size;
+
+  // Constructor
+  RayPacket():
+    size(0)
+  {
+    // do nothing
+  }
+
+  // Get the mask of all the rays of the packet
+  int getMask() const
+  {
+    return (1 << size) - 1;
+  }
+
+  void set(int i, const Ray& ray)
+  {
+    vec3 d = ray.direction.inverse();
+
+    for (int a = 0; a < 3; a++)
+    {
+      origin[a][i] = ray.origin[a];
+      direction[a][i] = ray.direction[a];
+      invD[a][i] = d[a];
+    }
+    tMin[i] = ray.tMin;
+    tMax[i] = ray.tMax;
+  }
+
+  // Add a ray and return its index in the packet
+  int add(const Ray& ray)
+  {
+    set(size, ray);
+    return size++;
+  }
+
+  Ray getRay(int i) const
+  {
+    return Ray(vec3(origin[0][i], origin[1][i], origin[2][i]),
+      vec3(direction[0][i], direction[1][i], direction[2][i]),
+      tMin[i],
+      tMax[i]);
+  }
+
+  // Set the packet to the rays of p transformed by m
+  void transform(const RayPacket& p, const mat4& m)
+  {
+    for (int i = 0; i < p.size; i++)
+      set(i, p.getRay(i).transform(m));
+    size = p.size;
+  }
+
+}; // RayPacket
+
+//
+// Intersect the rays in mask of a packet with a box. Return the mask
+// of the rays hit with distance in [tMin, tMax]
+//
+template <int W>
+inline int
+packetBoundsHits(const Geometry::Bounds3& b, const RayPacket& p, int mask)
+{
+  const vec3& p1 = b.getMin();
+  const vec3& p2 = b.getMax();
+  int hits = 0;
+
+  for (int i = 0; i < p.size; i++)
+    if (mask >> i & 1)
+    {
+      float t1 = p.tMin[i];
+      float t2 = p.tMax[i];
+
+      for (int a = 0; a < 3; a++)
+      {
+        float tn = (p1[a] - p.origin[a][i]) * p.invD[a][i];
+        float tf = (p2[a] - p.origin[a][i]) * p.invD[a][i];
+
+        if (tn > tf)
+          dSwap<float>(tn, tf);
+        if (tn > t1)
+          t1 = tn;
+        if (tf < t2)
+          t2 = tf;
+      }
+      if (t1 <= t2)
+        hits |= 1 << i;
+    }
+  return hits;
+}
+
+//
+// Moller-Trumbore intersection of the rays in mask of a packet with
+// a triangle. Return the mask of the rays hit with distance in
+// (tMin, tMax), with their distances and barycentric coordinates in
+// t, u and v
+//
+template <int W>
+inline int
+packetTriangleHits(const vec3& v0,
+  const vec3& v1,
+  const vec3& v2,
+  const RayPacket& p,
+  int mask,
+  float* t,
+  float* u,
+  float* v)
+{
+  vec3 e1 = v1 - v0;
+  vec3 e2 = v2 - v0;
+  int hits = 0;
+
+  for (int i = 0; i < p.size; i++)
+    if (mask >> i & 1)
+    {
+      vec3 d(p.direction[0][i], p.direction[1][i], p.direction[2][i]);
+      vec3 s1 = d.cross(e2);
+      REAL det = s1.dot(e1);
+
+      if (Math::isZero<REAL>(det, REAL(TRIANGLE_BLOCK_EPS)))
+        continue;
+
+      REAL invDet = Math::inverse<REAL>(det);
+      vec3 s = vec3(p.origin[0][i], p.origin[1][i], p.origin[2][i]) - v0;
+
+      if ((u[i] = s.dot(s1) * invDet) < 0 || u[i] > 1)
+        continue;
+
+      vec3 s2 = s.cross(e1);
+
+      if ((v[i] = d.dot(s2) * invDet) < 0 || u[i] + v[i] > 1)
+        continue;
+      t[i] = e2.dot(s2) * invDet;
+      if (t[i] > p.tMin[i] && t[i] < p.tMax[i])
+        hits |= 1 << i;
+    }
+  return hits;
+}
+
+#ifdef SIMD_X86
+
+template <>
+inline int
+packetBoundsHits<4>(const Geometry::Bounds3& b, const RayPacket& p, int mask)
+{
+  const vec3& p1 = b.getMin();
+  const vec3& p2 = b.getMax();
+  int hits = 0;
+
+  for (int g = 0; g < p.size; g += 4)
+  {
+    if ((mask >> g & 15) == 0)
+      continue;
+
+    __m128 t1 = _mm_loadu_ps(p.tMin + g);
+    __m128 t2 = _mm_loadu_ps(p.tMax + g);
+
+    for (int a = 0; a < 3; a++)
+    {
+      __m128 o = _mm_loadu_ps(p.origin[a] + g);
+      __m128 invD = _mm_loadu_ps(p.invD[a] + g);
+      __m128 tn = _mm_mul_ps(_mm_sub_ps(_mm_set1_ps(p1[a]), o), invD);
+      __m128 tf = _mm_mul_ps(_mm_sub_ps(_mm_set1_ps(p2[a]), o), invD);
+
+      // A NaN (0 * inf) in tn or tf keeps t1 and t2, as in the scalar
+      // test (the min/max intrinsics return their second operand if
+      // any of them is NaN)
+      t1 = _mm_max_ps(_mm_min_ps(tf, tn), t1);
+      t2 = _mm_min_ps(_mm_max_ps(tn, tf), t2);
+    }
+    hits |= _mm_movemask_ps(_mm_cmple_ps(t1, t2)) << g;
+  }
+  return hits & mask;
+}
+
+template <>
+SIMD_AVX inline int
+packetBoundsHits<8>(const Geometry::Bounds3& b, const RayPacket& p, int mask)
+{
+  const vec3& p1 = b.getMin();
+  const vec3& p2 = b.getMax();
+  int hits = 0;
+
+  for (int g = 0; g < p.size; g += 8)
+  {
+    if ((mask >> g & 255) == 0)
+      continue;
+
+    __m256 t1 = _mm256_loadu_ps(p.tMin + g);
+    __m256 t2 = _mm256_loadu_ps(p.tMax + g);
+
+    for (int a = 0; a < 3; a++)
+    {
+      __m256 o = _mm256_loadu_ps(p.origin[a] + g);
+      __m256 invD = _mm256_loadu_ps(p.invD[a] + g);
+      __m256 tn = _mm256_mul_ps(_mm256_sub_ps(_mm256_set1_ps(p1[a]), o), invD);
+      __m256 tf = _mm256_mul_ps(_mm256_sub_ps(_mm256_set1_ps(p2[a]), o), invD);
+
+      // NaNs are handled as in packetBoundsHits<4>
+      t1 = _mm256_max_ps(_mm256_min_ps(tf, tn), t1);
+      t2 = _mm256_min_ps(_mm256_max_ps(tn, tf), t2);
+    }
+    hits |= _mm256_movemask_ps(_mm256_cmp_ps(t1, t2, _CMP_LE_OQ)) << g;
+  }
+  return hits & mask;
+}
+
+template <>
+inline int
+packetTriangleHits<4>(const vec3& v0,
+  const vec3& v1,
+  const vec3& v2,
+  const RayPacket& p,
+  int mask,
+  float* t,
+  float* u,
+  float* v)
+{
+  __m128 e1x = _mm_set1_ps(v1.x - v0.x);
+  __m128 e1y = _mm_set1_ps(v1.y - v0.y);
+  __m128 e1z = _mm_set1_ps(v1.z - v0.z);
+  __m128 e2x = _mm_set1_ps(v2.x - v0.x);
+  __m128 e2y = _mm_set1_ps(v2.y - v0.y);
+  __m128 e2z = _mm_set1_ps(v2.z - v0.z);
+  __m128 zero = _mm_setzero_ps();
+  __m128 one = _mm_set1_ps(1);
+  int hits = 0;
+
+  for (int g = 0; g < p.size; g += 4)
+  {
+    if ((mask >> g & 15) == 0)
+      continue;
+
+    __m128 dx = _mm_loadu_ps(p.direction[0] + g);
+    __m128 dy = _mm_loadu_ps(p.direction[1] + g);
+    __m128 dz = _mm_loadu_ps(p.direction[2] + g);
+    // s1 = d x e2
+    __m128 s1x = _mm_sub_ps(_mm_mul_ps(dy, e2z), _mm_mul_ps(dz, e2y));
+    __m128 s1y = _mm_sub_ps(_mm_mul_ps(dz, e2x), _mm_mul_ps(dx, e2z));
+    __m128 s1z = _mm_sub_ps(_mm_mul_ps(dx, e2y), _mm_mul_ps(dy, e2x));
+    __m128 det = _mm_add_ps(_mm_add_ps(_mm_mul_ps(s1x, e1x),
+      _mm_mul_ps(s1y, e1y)), _mm_mul_ps(s1z, e1z));
+    __m128 invDet = _mm_div_ps(one, det);
+    // s = o - v0
+    __m128 sx = _mm_sub_ps(_mm_loadu_ps(p.origin[0] + g), _mm_set1_ps(v0.x));
+    __m128 sy = _mm_sub_ps(_mm_loadu_ps(p.origin[1] + g), _mm_set1_ps(v0.y));
+    __m128 sz = _mm_sub_ps(_mm_loadu_ps(p.origin[2] + g), _mm_set1_ps(v0.z));
+    __m128 b1 = _mm_mul_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(sx, s1x),
+      _mm_mul_ps(sy, s1y)), _mm_mul_ps(sz, s1z)), invDet);
+    // s2 = s x e1
+    __m128 s2x = _mm_sub_ps(_mm_mul_ps(sy, e1z), _mm_mul_ps(sz, e1y));
+    __m128 s2y = _mm_sub_ps(_mm_mul_ps(sz, e1x), _mm_mul_ps(sx, e1z));
+    __m128 s2z = _mm_sub_ps(_mm_mul_ps(sx, e1y), _mm_mul_ps(sy, e1x));
+    __m128 b2 = _mm_mul_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(dx, s2x),
+      _mm_mul_ps(dy, s2y)), _mm_mul_ps(dz, s2z)), invDet);
+    __m128 d = _mm_mul_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(e2x, s2x),
+      _mm_mul_ps(e2y, s2y)), _mm_mul_ps(e2z, s2z)), invDet);
+    __m128 absDet = _mm_andnot_ps(_mm_set1_ps(-0.0f), det);
+    __m128 m = _mm_cmpgt_ps(absDet, _mm_set1_ps(TRIANGLE_BLOCK_EPS));
+
+    m = _mm_and_ps(m, _mm_cmpge_ps(b1, zero));
+    m = _mm_and_ps(m, _mm_cmple_ps(b1, one));
+    m = _mm_and_ps(m, _mm_cmpge_ps(b2, zero));
+    m = _mm_and_ps(m, _mm_cmple_ps(_mm_add_ps(b1, b2), one));
+    m = _mm_and_ps(m, _mm_cmpgt_ps(d, _mm_loadu_ps(p.tMin + g)));
+    m = _mm_and_ps(m, _mm_cmplt_ps(d, _mm_loadu_ps(p.tMax + g)));
+    _mm_storeu_ps(t + g, d);
+    _mm_storeu_ps(u + g, b1);
+    _mm_storeu_ps(v + g, b2);
+    hits |= _mm_movemask_ps(m) << g;
+  }
+  return hits & mask;
+}
+
+template <>
+SIMD_AVX inline int
+packetTriangleHits<8>(const vec3& v0,
+  const vec3& v1,
+  const vec3& v2,
+  const RayPacket& p,
+  int mask,
+  float* t,
+  float* u,
+  float* v)
+{
+  __m256 e1x = _mm256_set1_ps(v1.x - v0.x);
+  __m256 e1y = _mm256_set1_ps(v1.y - v0.y);
+  __m256 e1z = _mm256_set1_ps(v1.z - v0.z);
+  __m256 e2x = _mm256_set1_ps(v2.x - v0.x);
+  __m256 e2y = _mm256_set1_ps(v2.y - v0.y);
+  __m256 e2z = _mm256_set1_ps(v2.z - v0.z);
+  __m256 zero = _mm256_setzero_ps();
+  __m256 one = _mm256_set1_ps(1);
+  int hits = 0;
+
+  for (int g = 0; g < p.size; g += 8)
+  {
+    if ((mask >> g & 255) == 0)
+      continue;
+
+    __m256 dx = _mm256_loadu_ps(p.direction[0] + g);
+    __m256 dy = _mm256_loadu_ps(p.direction[1] + g);
+    __m256 dz = _mm256_loadu_ps(p.direction[2] + g);
+    // s1 = d x e2
+    __m256 s1x = _mm256_sub_ps(_mm256_mul_ps(dy, e2z), _mm256_mul_ps(dz, e2y));
+    __m256 s1y = _mm256_sub_ps(_mm256_mul_ps(dz, e2x), _mm256_mul_ps(dx, e2z));
+    __m256 s1z = _mm256_sub_ps(_mm256_mul_ps(dx, e2y), _mm256_mul_ps(dy, e2x));
+    __m256 det = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(s1x, e1x),
+      _mm256_mul_ps(s1y, e1y)), _mm256_mul_ps(s1z, e1z));
+    __m256 invDet = _mm256_div_ps(one, det);
+    // s = o - v0
+    __m256 sx = _mm256_sub_ps(_mm256_loadu_ps(p.origin[0] + g),
+      _mm256_set1_ps(v0.x));
+    __m256 sy = _mm256_sub_ps(_mm256_loadu_ps(p.origin[1] + g),
+      _mm256_set1_ps(v0.y));
+    __m256 sz = _mm256_sub_ps(_mm256_loadu_ps(p.origin[2] + g),
+      _mm256_set1_ps(v0.z));
+    __m256 b1 = _mm256_mul_ps(_mm256_add_ps(_mm256_add_ps(
+      _mm256_mul_ps(sx, s1x), _mm256_mul_ps(sy, s1y)),
+      _mm256_mul_ps(sz, s1z)), invDet);
+    // s2 = s x e1
+    __m256 s2x = _mm256_sub_ps(_mm256_mul_ps(sy, e1z), _mm256_mul_ps(sz, e1y));
+    __m256 s2y = _mm256_sub_ps(_mm256_mul_ps(sz, e1x), _mm256_mul_ps(sx, e1z));
+    __m256 s2z = _mm256_sub_ps(_mm256_mul_ps(sx, e1y), _mm256_mul_ps(sy, e1x));
+    __m256 b2 = _mm256_mul_ps(_mm256_add_ps(_mm256_add_ps(
+      _mm256_mul_ps(dx, s2x), _mm256_mul_ps(dy, s2y)),
+      _mm256_mul_ps(dz, s2z)), invDet);
+    __m256 d = _mm256_mul_ps(_mm256_add_ps(_mm256_add_ps(
+      _mm256_mul_ps(e2x, s2x), _mm256_mul_ps(e2y, s2y)),
+      _mm256_mul_ps(e2z, s2z)), invDet);
+    __m256 absDet = _mm256_andnot_ps(_mm256_set1_ps(-0.0f), det);
+    __m256 m = _mm256_cmp_ps(absDet,
+      _mm256_set1_ps(TRIANGLE_BLOCK_EPS),
+      _CMP_GT_OQ);
+
+    m = _mm256_and_ps(m, _mm256_cmp_ps(b1, zero, _CMP_GE_OQ));
+    m = _mm256_and_ps(m, _mm256_cmp_ps(b1, one, _CMP_LE_OQ));
+    m = _mm256_and_ps(m, _mm256_cmp_ps(b2, zero, _CMP_GE_OQ));
+    m = _mm256_and_ps(m,
+      _mm256_cmp_ps(_mm256_add_ps(b1, b2), one, _CMP_LE_OQ));
+    m = _mm256_and_ps(m,
+      _mm256_cmp_ps(d, _mm256_loadu_ps(p.tMin + g), _CMP_GT_OQ));
+    m = _mm256_and_ps(m,
+      _mm256_cmp_ps(d, _mm256_loadu_ps(p.tMax + g), _CMP_LT_OQ));
+    _mm256_storeu_ps(t + g, d);
+    _mm256_storeu_ps(u + g, b1);
+    _mm256_storeu_ps(v + g, b2);
+    hits |= _mm256_movemask_ps(m) << g;
+  }
+  return hits & mask;
+}
+
+#endif // SIMD_X86
+
+} // end namespace Graphics
+
+#endif // __RayPacket_h
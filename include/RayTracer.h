@@ -0,0 +1,216 @@
+#ifndef __RayTracer_h
+#define __RayTracer_h
+
+//[]------------------------------------------------------------------------[]
+//|                                                                          |
+//|                          GVSG Graphics Library                           |
+//|                               Version 1.0                                |
+//|                                                                          |
+//|              Copyright 2007-2014, Paulo Aristarco Pagliosa              |
+//|              All Rights Reserved.                                        |
+//|                                                                          |
+//[]------------------------------------------------------------------------[]
+//
+//  OVERVIEW: RayTracer.h
+//  ========
+//  Class definition for multithreaded CPU ray tracer.
+
+#include <vector>
+#include "Random.h"
+#include "Ray.h"
+#include "Renderer.h"
+#include "SceneBVH.h"
+#include "ThreadPool.h"
+#include "TileScheduler.h"
+
+namespace Graphics
+{ // begin namespace Graphics
+
+#define MIN_ADAPTIVE_SAMPLES 8
+#define PACKET_BLOCK_SIZE 4
+
+//////////////////////////////////////////////////////////
+//
+// RayTracer: simple ray tracer class
+// =========
+//
+// In progressive mode, each render traces one sample per pixel, at a
+// jittered position within the pixel (the first one at its center),
+// adds it to an accumulation buffer and stores the running average in
+// the frame buffer. The accumulation restarts whenever the camera or
+// scene stamps (see Camera::getTimestamp() and Scene::getTimestamp())
+// move, the image size changes or an actor moves.
+//
+// If adaptive is set, the mean and the variance of the luminance of
+// the samples of each pixel are tracked, and the error of a tile is
+// the RMS over its pixels of the standard error of the mean luminance
+// over the square root of the mean (noise is more visible in darker
+// pixels). A tile with at least MIN_ADAPTIVE_SAMPLES samples per pixel
+// and error below errorThreshold is converged: in progressive mode it
+// is no longer sampled, so each pass only traces the noisy tiles (see
+// also PathTracer, which redistributes its sample budget).
+//
+// If packets is set (and watertight is not), the primary rays of each
+// block of PACKET_BLOCK_SIZE x PACKET_BLOCK_SIZE pixels are traced as a
+// ray packet (see RayPacket), and so are the shadow rays of the block
+// toward each light. Reflected and refracted rays are traced one by
+// one, since they are seldom coherent.
+class RayTracer: public Renderer
+{
+public:
+  int maxRecursionLevel;
+  REAL minWeight;
+  int tileSize;
+  TileScheduler::TileOrder tileOrder;
+  bool watertight; // use the watertight ray/triangle test
+  bool spatialSplits; // build mesh BVHs with spatial splits
+  bool optimizeTreelets; // optimize the treelets of mesh BVHs
+  string bvhCacheDirectory; // mesh BVH cache directory (empty: no cache)
+  bool progressive; // accumulate one sample per pixel per render
+  bool adaptive; // stop sampling converged tiles
+  float errorThreshold; // error under which a tile is converged
+  bool packets; // trace primary and shadow rays in packets
+
+  // Constructor
+  RayTracer(Scene&, Camera* = 0);
+
+  // Destructor
+  ~RayTracer();
+
+  // Get the frame buffer (W x H colors, bottom row first)
+  const Color* getFrameBuffer() const
+  {
+    return frameBuffer;
+  }
+
+  // Get the time spent in the last render (in seconds)
+  double getRenderTime() const
+  {
+    return renderTime;
+  }
+
+  // Get the time spent building the acceleration structures
+  // in the last update (in seconds)
+  double getBuildTime() const
+  {
+    return buildTime;
+  }
+
+  // Get the tile scheduler (with the thread stats of the last render)
+  const TileScheduler& getTileScheduler() const
+  {
+    return scheduler;
+  }
+
+  // Get the number of samples per pixel accumulated in progressive mode
+  int getNumberOfPasses() const
+  {
+    return numberOfPasses;
+  }
+
+  // Restart the accumulation (e.g., after changing a setting of the
+  // ray tracer)
+  void resetAccumulation()
+  {
+    numberOfPasses = 0;
+  }
+
+  // Get the number of tiles converged in adaptive mode
+  int getNumberOfConvergedTiles() const;
+
+  // Save a heatmap of the number of samples of each pixel (blue: the
+  // least, red: the most) as a binary PPM file
+  bool saveHeatmap(const char*) const;
+
+  void update();
+  void render();
+
+  // Save the frame buffer as a binary PPM file
+  bool saveImage(const char*) const;
+
+protected:
+  struct Tile
+  {
+    float error;
+    int numberOfSamples; // minimum number of samples of its pixels
+
+  }; // Tile
+
+  struct ShadingPoint
+  {
+    const Material::Surface* surface;
+    vec3 P;
+    vec3 V; // unit ray direction
+    vec3 N; // unit normal facing V
+    bool entering;
+
+  }; // ShadingPoint
+
+  Color* frameBuffer;
+  Color* accumulationBuffer;
+  float* squaredSumBuffer; // sums of the squared luminances of samples
+  int* sampleCountBuffer;
+  std::vector<Tile> tiles;
+  int tilesX; // number of tile columns
+  int bufferW;
+  int bufferH;
+  ObjectPtr<SceneBVH> bvh;
+  double renderTime;
+  double buildTime;
+  int numberOfPasses;
+  uint cameraTimestamp;
+  uint sceneTimestamp;
+  TileScheduler scheduler;
+  // Viewing parameters
+  vec3 VRP;
+  vec3 VPN;
+  vec3 u;
+  vec3 v;
+  REAL Ih;
+  REAL Iw;
+  bool parallel;
+
+  virtual void scan();
+  virtual void renderTile(int, int, int, int);
+  virtual Color trace(const Ray&, int, REAL);
+  virtual Color shade(const Ray&, Intersection&, int, REAL);
+  virtual Color background() const;
+  virtual bool intersect(const Ray&, Intersection&);
+  virtual bool shadow(const Ray&);
+  virtual int intersect(const RayPacket&, Intersection*);
+  virtual int shadow(const RayPacket&);
+
+  void tracePacket(const RayPacket&, Color*);
+  void setShadingPoint(const Ray&, const Intersection&, ShadingPoint&) const;
+  Color lightColor(const ShadingPoint&, Light*, const vec3&, REAL) const;
+  bool reflectedRay(const ShadingPoint&, REAL, Ray&, REAL&) const;
+  bool refractedRay(const ShadingPoint&, REAL, Ray&, REAL&) const;
+  void traceSecondaryRays(const ShadingPoint&, int, REAL, Color&);
+
+  Ray makeRay(REAL, REAL) const;
+  Ray makePixelRay(int, int) const;
+  void storeSample(int, int, const Color&);
+  void storeSamples(int, int, const Color&, float, int);
+
+  // Get the number of samples accumulated in pixel (x, y)
+  int getSampleCount(int x, int y) const
+  {
+    return progressive || adaptive ? sampleCountBuffer[y * W + x] : 0;
+  }
+
+  int tileIndex(int x, int y) const
+  {
+    return y / tileSize * tilesX + x / tileSize;
+  }
+
+  void updateTiles();
+  bool isConverged(int) const;
+
+private:
+  void updateFrameBuffer();
+
+}; // RayTracer
+
+} // end namespace Graphics
+
+#endif // __RayTracer_h
@@ -0,0 +1,128 @@
+#ifndef __SBVHBuilder_h
+#define __SBVHBuilder_h
+
+//[]------------------------------------------------------------------------[]
+//|                                                                          |
+//|                          GVSG Graphics Library                           |
+//|                               Version 1.0                                |
+//|                                                                          |
+//|              Copyright 2007-2014, Paulo Aristarco Pagliosa              |
+//|              All Rights Reserved.                                        |
+//|                                                                          |
+//[]------------------------------------------------------------------------[]
+//
+//  OVERVIEW: SBVHBuilder.h
+//  ========
+//  Class definition for spatial split BVH builder.
+
+#include <vector>
+#include "BinnedSAHBuilder.h"
+#include "TriangleMesh.h"
+
+namespace Graphics
+{ // begin namespace Graphics
+
+#define DFL_SBVH_DUPLICATION_BUDGET (REAL)0.3
+#define DFL_SBVH_SPLIT_THRESHOLD (REAL)1e-5
+
+
+//////////////////////////////////////////////////////////
+//
+// SBVHBuilder: spatial split BVH builder class
+// ===========
+//
+// Triangle mesh BVH builder that, besides binned object splits,
+// evaluates spatial splits: a plane cuts the triangles straddling
+// it, which are then referenced by both children with bounds
+// clipped to each side. This reduces the overlap of the children
+// of nodes enclosing long, thin triangles, at the cost of more
+// references. Spatial splits are only tried when the overlap of
+// the best object split is greater than splitThreshold times the
+// area of the root, and the number of extra references is capped
+// at duplicationBudget times the number of triangles.
+class SBVHBuilder: public BVHBuilder
+{
+public:
+  int numberOfBins;
+  REAL duplicationBudget;
+  REAL splitThreshold;
+
+  // Constructor
+  SBVHBuilder(const TriangleMesh::Arrays& aData,
+    int maxPrimitives = 4,
+    REAL budget = DFL_SBVH_DUPLICATION_BUDGET):
+    BVHBuilder(maxPrimitives),
+    numberOfBins(32),
+    duplicationBudget(budget),
+    splitThreshold(DFL_SBVH_SPLIT_THRESHOLD),
+    data(aData)
+  {
+    // do nothing
+  }
+
+  // Get the number of duplicated references of the last build
+  int getNumberOfDuplicates() const
+  {
+    return numberOfDuplicates;
+  }
+
+  void hashSettings(Hash& hash) const
+  {
+    hash.add("SBVH").add(numberOfBins);
+    hash.add(duplicationBudget).add(splitThreshold);
+    BVHBuilder::hashSettings(hash);
+  }
+
+protected:
+  void execute(BVH&, Reference*, int);
+
+private:
+  typedef std::vector<Reference> References;
+
+  struct Split
+  {
+    REAL cost;
+    int axis;
+    int bin;
+    REAL position;
+    Bounds3 left;
+    Bounds3 right;
+    int leftCount;
+    int rightCount;
+
+  }; // Split
+
+  const TriangleMesh::Arrays& data;
+  std::vector<BVH::Node> nodes;
+  std::vector<int> primitiveIds;
+  int bins;
+  REAL minOverlap;
+  int maxDuplicates;
+  int numberOfDuplicates;
+
+  int buildNode(References&, int);
+  int makeLeaf(const References&, const Bounds3&);
+  void findObjectSplit(const References&, const Bounds3&, Split&) const;
+  void findSpatialSplit(const References&, const Bounds3&, Split&) const;
+  void splitReference(const Reference&,
+    int,
+    REAL,
+    Reference&,
+    Reference&) const;
+  void objectPartition(References&,
+    const Bounds3&,
+    const Split&,
+    References&,
+    References&) const;
+  void spatialPartition(References&,
+    Split&,
+    References&,
+    References&);
+
+  SBVHBuilder& operator =(const SBVHBuilder&);
+
+}; // SBVHBuilder
+
+} // end namespace Graphics
+
+#endif // __SBVHBuilder_h
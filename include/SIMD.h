@@ -0,0 +1,95 @@
+#ifndef __SIMD_h
+#define __SIMD_h
+
+//[]------------------------------------------------------------------------[]
+//|                                                                          |
+//|                        GVSG Foundation Classes                           |
+//|                               Version 1.0                                |
+//|                                                                          |
+//|              Copyright 2007-2014, Paulo Aristarco Pagliosa              |
+//|              All Rights Reserved.                                        |
+//|                                                                          |
+//[]------------------------------------------------------------------------[]
+//
+//  OVERVIEW: SIMD.h
+//  ========
+//  Definitions for SIMD support, runtime CPU feature check and aligned
+//  memory allocation.
+
+#include <stddef.h>
+
+#if defined(_M_IX86) || defined(_M_X64) || defined(__i386__) || \
+  defined(__x86_64__)
+#define SIMD_X86
+#include <immintrin.h>
+#endif
+
+//
+// Functions using AVX intrinsics must be marked with SIMD_AVX (GCC
+// and Clang only emit AVX code for functions targeting AVX) and be
+// called only if simdWidth() == 8
+//
+#if defined(SIMD_X86) && !defined(_MSC_VER)
+#define SIMD_AVX __attribute__((target("avx")))
+#else
+#define SIMD_AVX
+#endif
+
+#define CACHE_LINE_SIZE 64
+
+namespace System
+{ // begin namespace System
+
+//
+// Get the number of floats of the widest SIMD register supported by
+// both the CPU and the OS: 8 (AVX), 4 (SSE) or 1 (no SIMD support)
+//
+extern int simdWidth();
+
+//
+// Limit the SIMD width returned by simdWidth() (e.g., for benchmarks)
+//
+extern void setMaxSIMDWidth(int);
+
+//
+// Allocate/free a block of memory aligned to a power of two boundary
+//
+extern void* alignedMalloc(size_t, size_t alignment);
+extern void alignedFree(void*);
+
+
+//////////////////////////////////////////////////////////
+//
+// CacheAligned: cache-line-aligned allocation class
+// ============
+//
+// Base class whose derived objects (and arrays of them) allocated
+// by new are aligned to cache lines. Derived record types whose size
+// divides (or is a multiple of) CACHE_LINE_SIZE never straddle lines.
+struct CacheAligned
+{
+  static void* operator new(size_t size)
+  {
+    return alignedMalloc(size, CACHE_LINE_SIZE);
+  }
+
+  static void* operator new[](size_t size)
+  {
+    return alignedMalloc(size, CACHE_LINE_SIZE);
+  }
+
+  static void operator delete(void* p)
+  {
+    alignedFree(p);
+  }
+
+  static void operator delete[](void* p)
+  {
+    alignedFree(p);
+  }
+
+}; // CacheAligned
+
+} // end namespace System
+
+#endif // __SIMD_h
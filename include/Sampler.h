@@ -0,0 +1,253 @@
+#ifndef __Sampler_h
+#define __Sampler_h
+
+//[]------------------------------------------------------------------------[]
+//|                                                                          |
+//|                          GVSG Graphics Library                           |
+//|                               Version 1.0                                |
+//|                                                                          |
+//|              Copyright 2007-2014, Paulo Aristarco Pagliosa              |
+//|              All Rights Reserved.                                        |
+//|                                                                          |
+//[]------------------------------------------------------------------------[]
+//
+//  OVERVIEW: Sampler.h
+//  ========
+//  Class definitions for pixel samplers.
+
+#include "Core/Global.h"
+#include "Object.h"
+
+namespace Graphics
+{ // begin namespace Graphics
+
+#define BLUE_NOISE_TILE_SIZE 64
+
+
+//////////////////////////////////////////////////////////
+//
+// Sampler: generic pixel sampler class
+// =======
+//
+// A sampler defines, for each pixel, a sequence of samples in [0,1)^d
+// of unbounded dimension d. Samplers are stateless (the value of a
+// dimension of a sample depends only on the pixel, the sample index
+// and the dimension), so a single sampler can be shared by threads.
+class Sampler: public System::Object
+{
+public:
+  // Get the value of dimension dim of sample index of pixel (x, y)
+  virtual float sample(int x, int y, uint32 index, int dim) const = 0;
+
+  // Get the values of dimension dim of the n samples first, ...,
+  // first + n - 1 of pixel (x, y)
+  virtual void generate(int x, int y,
+    uint32 first,
+    int n,
+    int dim,
+    float* values) const;
+
+  virtual const char* getName() const = 0;
+
+}; // Sampler
+
+
+//////////////////////////////////////////////////////////
+//
+// IndependentSampler: independent random sampler class
+// ==================
+class IndependentSampler: public Sampler
+{
+public:
+  float sample(int, int, uint32, int) const;
+
+  const char* getName() const
+  {
+    return "independent";
+  }
+
+}; // IndependentSampler
+
+
+//////////////////////////////////////////////////////////
+//
+// SobolSampler: Owen-scrambled Sobol sampler class
+// ============
+//
+// The dimensions are taken in pairs from the first two dimensions of
+// the Sobol sequence, whose values are Owen-scrambled (nested uniform
+// scrambling with the hash-based permutation of Laine and Karras).
+// Each pair of each pixel uses a shuffled (Owen-scrambled) order of
+// the sample indices, which decorrelates the pairs of a sample and
+// the pixels of the image (Burley, 2020). The batch generator handles
+// four samples at a time with SSE2.
+class SobolSampler: public Sampler
+{
+public:
+  uint32 seed;
+
+  // Constructor
+  SobolSampler(uint32 aSeed = 0):
+    seed(aSeed)
+  {
+    // do nothing
+  }
+
+  float sample(int, int, uint32, int) const;
+  void generate(int, int, uint32, int, int, float*) const;
+
+  const char* getName() const
+  {
+    return "sobol";
+  }
+
+}; // SobolSampler
+
+
+//////////////////////////////////////////////////////////
+//
+// HaltonSampler: Halton sampler class
+// =============
+//
+// Dimension d is the radical inverse of the sample index in the d-th
+// prime base, toroidally shifted by a per-pixel random offset
+// (Cranley-Patterson rotation); the digits are also scrambled by a
+// random permutation per base.
+class HaltonSampler: public Sampler
+{
+public:
+  // Constructor
+  HaltonSampler(uint32 seed = 0);
+
+  // Destructor
+  ~HaltonSampler();
+
+  float sample(int, int, uint32, int) const;
+
+  const char* getName() const
+  {
+    return "halton";
+  }
+
+private:
+  uint16* permutations; // digit permutations of each base
+  int* offsets; // offset of the permutation of each base
+  uint32 seed;
+
+  HaltonSampler(const HaltonSampler&);
+  HaltonSampler& operator =(const HaltonSampler&);
+
+}; // HaltonSampler
+
+
+//////////////////////////////////////////////////////////
+//
+// BlueNoiseSampler: blue-noise dithered sampler class
+// ================
+//
+// All the pixels share the same sequence of Sobol points (shuffled
+// per pair of dimensions) and offset it toroidally by the value of
+// a tileable blue-noise mask (made by the void-and-cluster method),
+// with a different shift of the tile for each dimension. The error of
+// neighbor pixels is then negatively correlated, which shows as high
+// frequency noise at low sample counts (Heitz and Belcour, 2019).
+class BlueNoiseSampler: public Sampler
+{
+public:
+  // Constructor
+  BlueNoiseSampler(uint32 seed = 0);
+
+  float sample(int, int, uint32, int) const;
+  void generate(int, int, uint32, int, int, float*) const;
+
+  const char* getName() const
+  {
+    return "blue noise";
+  }
+
+  // Get the blue-noise mask (values in [0, 1))
+  const float* getMask() const
+  {
+    return mask;
+  }
+
+private:
+  float mask[BLUE_NOISE_TILE_SIZE * BLUE_NOISE_TILE_SIZE];
+  uint32 seed;
+
+  float maskValue(int, int, int) const;
+
+}; // BlueNoiseSampler
+
+
+//////////////////////////////////////////////////////////
+//
+// PixelSampler: pixel sample table class
+// ============
+//
+// Per-thread cursor over the samples of a pixel. The first dimensions
+// of all the samples of the pixel are generated in batches, one
+// dimension at a time, when the first sample needs it; the other ones
+// are computed one by one.
+class PixelSampler
+{
+public:
+  // Constructor
+  PixelSampler(const Sampler&, int numberOfTableDimensions = 32);
+
+  // Destructor
+  ~PixelSampler();
+
+  // Start the samples [first, first + n) of pixel (x, y)
+  void startPixel(int x, int y, uint32 first, int n);
+
+  // Start the i-th sample of the pixel (0 <= i < n)
+  void startSample(int i)
+  {
+    current = i;
+    dimension = 0;
+  }
+
+  // Get the next dimension of the current sample
+  float next()
+  {
+    int d = dimension++;
+
+    if (d < numberOfRows)
+      return table[d * numberOfSamples + current];
+    return generateRows(d);
+  }
+
+  // Get the next pair of dimensions of the current sample. The pair
+  // starts at an even dimension (skipping one if needed), so that it
+  // is a 2D point of the samplers that take the dimensions in pairs
+  void next2D(float& u, float& v)
+  {
+    dimension += dimension & 1;
+    u = next();
+    v = next();
+  }
+
+private:
+  const Sampler& sampler;
+  int tableDimensions;
+  float* table;
+  int capacity;
+  int x;
+  int y;
+  uint32 first;
+  int numberOfSamples;
+  int numberOfRows; // dimensions generated
+  int current;
+  int dimension;
+
+  float generateRows(int);
+
+  PixelSampler(const PixelSampler&);
+  PixelSampler& operator =(const PixelSampler&);
+
+}; // PixelSampler
+
+} // end namespace Graphics
+
+#endif // __Sampler_h
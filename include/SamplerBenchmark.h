@@ -0,0 +1,41 @@
+#ifndef __SamplerBenchmark_h
+#define __SamplerBenchmark_h
+
+//[]------------------------------------------------------------------------[]
+//|                                                                          |
+//|                          GVSG Graphics Library                           |
+//|                               Version 1.0                                |
+//|                                                                          |
+//|              Copyright 2007-2014, Paulo Aristarco Pagliosa              |
+//|              All Rights Reserved.                                        |
+//|                                                                          |
+//[]------------------------------------------------------------------------[]
+//
+//  OVERVIEW: SamplerBenchmark.h
+//  ========
+//  Function definition for sampler benchmark.
+
+#include <stdio.h>
+#include "Camera.h"
+#include "Scene.h"
+
+namespace Graphics
+{ // begin namespace Graphics
+
+//
+// Path trace a W x H view of a scene with each sampler (independent,
+// Sobol, Halton and blue noise) at 1, 2, 4, ..., maxSamples samples
+// per pixel and print a table with the RMSE of each image against a
+// reference image traced with referenceSamples samples per pixel
+//
+extern void benchmarkSamplers(Scene&,
+  Camera*,
+  int W,
+  int H,
+  int maxSamples = 64,
+  int referenceSamples = 1024,
+  FILE* = stdout);
+
+} // end namespace Graphics
+
+#endif // __SamplerBenchmark_h
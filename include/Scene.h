@@ -39,7 +39,8 @@ public:
     NameableObject(name),
     backgroundColor(Color::black),
     ambientLight(Color::gray),
-    IOR(1)
+    IOR(1),
+    timestamp(0)
   {
     modifiedBounds = false;
   }
@@ -94,10 +95,25 @@ public:
 
   const Bounds3& boundingBox();
 
+  // Get the scene change stamp, bumped whenever an actor or light is
+  // added or deleted, or by touch()
+  uint getTimestamp() const
+  {
+    return timestamp;
+  }
+
+  // Notify a change not tracked by the scene (e.g., in a material,
+  // light or actor transform)
+  void touch()
+  {
+    timestamp++;
+  }
+
 protected:
   bool modifiedBounds;
   Bounds3 bounds;
   REAL IOR;
+  uint timestamp;
   // Scene components
   Actors actors;
   Lights lights;
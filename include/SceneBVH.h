@@ -0,0 +1,129 @@
+#ifndef __SceneBVH_h
+#define __SceneBVH_h
+
+//[]------------------------------------------------------------------------[]
+//|                                                                          |
+//|                          GVSG Graphics Library                           |
+//|                               Version 1.0                                |
+//|                                                                          |
+//|              Copyright 2007-2014, Paulo Aristarco Pagliosa              |
+//|              All Rights Reserved.                                        |
+//|                                                                          |
+//[]------------------------------------------------------------------------[]
+//
+//  OVERVIEW: SceneBVH.h
+//  ========
+//  Class definition for two-level scene BVH.
+
+#include <vector>
+#include "AnalyticShape.h"
+#include "Scene.h"
+#include "TriangleMeshBVH.h"
+
+namespace Graphics
+{ // begin namespace Graphics
+
+
+//////////////////////////////////////////////////////////
+//
+// SceneBVH: two-level scene BVH class
+// ========
+//
+// The top level is a BVH over the visible actors of a scene; each
+// leaf is an instance of the bottom level BVH of the actor's mesh,
+// which is shared by all the actors using the same mesh. Rays are
+// transformed into the mesh space by the inverse of the actor's
+// model matrix. An actor whose model is an analytic shape (see
+// AnalyticShape) is a leaf intersected by the shape itself, so
+// analytic shapes and meshes share the top level.
+//
+// The meshes of dynamic actors (see Actor::Dynamic) are assumed to
+// change every frame: their BVHs are refitted in every update, and
+// rebuilt by a linear BVH builder when the refitted tree degrades.
+// These BVHs are cached in the meshes, like the other ones, unless
+// ownDynamicBVHs is set: then the scene BVH builds and refits BVHs of
+// its own for them, which are not changed by the updates of the other
+// scene BVHs of the scene.
+// The BVHs of the other meshes are built by a binned SAH builder or,
+// if spatialSplits is set, by a spatial split BVH builder, and their
+// treelets are optimized if optimizeTreelets is set. If cacheDirectory
+// is not empty, these BVHs are cached on disk (see BVHCache).
+class SceneBVH: public BVH
+{
+public:
+  bool spatialSplits;
+  bool optimizeTreelets;
+  bool ownDynamicBVHs;
+  string cacheDirectory;
+
+  struct Instance
+  {
+    Actor* actor;
+    const TriangleMeshBVH* bvh;
+    const AnalyticShape* shape; // if not null, bvh is null
+    mat4 matrix;
+    mat4 inverseMatrix;
+
+  }; // Instance
+
+  // Constructor
+  SceneBVH(Scene&);
+
+  // Destructor
+  ~SceneBVH();
+
+  Scene* getScene() const
+  {
+    return scene;
+  }
+
+  int getNumberOfInstances() const
+  {
+    return numberOfInstances;
+  }
+
+  const Instance* getInstances() const
+  {
+    return instances;
+  }
+
+  // Update the instances and, if any actor was added, removed or
+  // moved, or if there are dynamic actors, rebuild the top level.
+  // Return true if rebuilt
+  bool update();
+
+  // Closest intersection (ray in world coordinates), using the fast
+  // or the watertight ray/triangle test
+  bool intersect(const Ray&, Intersection&, bool watertight = false) const;
+
+  // Test if there is any intersection with distance in (ray.tMin, tMax)
+  // (ray in world coordinates); meant for shadow rays. The traversal
+  // stops at the first hit and no hit data is computed
+  bool occluded(const Ray&, REAL tMax, bool watertight = false) const;
+
+  // Closest intersections of the rays of a packet (rays in world
+  // coordinates), using the fast ray/triangle test. The hits of the
+  // rays hit are set in the array of intersections, indexed by their
+  // lanes. Return the mask of the rays hit
+  int intersect(const RayPacket&, Intersection*) const;
+
+  // Get the mask of the rays of a packet (rays in world coordinates)
+  // with any intersection in (tMin, tMax); meant for shadow rays
+  int occluded(const RayPacket&) const;
+
+private:
+  Scene* scene;
+  Instance* instances;
+  int numberOfInstances;
+  std::vector<ObjectPtr<TriangleMeshBVH>> ownedBVHs;
+
+  bool isUpToDate() const;
+  void rebuild();
+  double updateOwnedBVHs(BVHBuilder&);
+  TriangleMeshBVH* ownedBVH(const TriangleMesh*) const;
+
+}; // SceneBVH
+
+} // end namespace Graphics
+
+#endif // __SceneBVH_h
@@ -0,0 +1,116 @@
+#ifndef __SceneQuery_h
+#define __SceneQuery_h
+
+//[]------------------------------------------------------------------------[]
+//|                                                                          |
+//|                          GVSG Graphics Library                           |
+//|                               Version 1.0                                |
+//|                                                                          |
+//|              Copyright 2007-2014, Paulo Aristarco Pagliosa              |
+//|              All Rights Reserved.                                        |
+//|                                                                          |
+//[]------------------------------------------------------------------------[]
+//
+//  OVERVIEW: SceneQuery.h
+//  ========
+//  Class definition for batch scene ray queries.
+
+#include "SceneBVH.h"
+
+namespace Graphics
+{ // begin namespace Graphics
+
+#define RAY_QUERY_CHUNK_SIZE 1024
+
+
+//////////////////////////////////////////////////////////
+//
+// RayBatch: SoA batch of rays class
+// ========
+//
+// The arrays are owned by the client. Distances are given in units of
+// the ray directions, which need not be unit vectors.
+struct RayBatch
+{
+  const REAL* origin[3];    // x, y and z arrays of the ray origins
+  const REAL* direction[3]; // x, y and z arrays of the ray directions
+  const REAL* tMax;         // maximum distances (null: infinity)
+  int size;
+
+}; // RayBatch
+
+
+//////////////////////////////////////////////////////////
+//
+// HitBatch: SoA batch of ray hits class
+// ========
+//
+// The arrays are owned by the client and indexed as the rays of the
+// batch. Null arrays are not written. For a ray missing the scene,
+// distance is infinity, actor is null and triangleIndex is -1.
+struct HitBatch
+{
+  REAL* distance;
+  Actor** actor;
+  int* triangleIndex; // -1 for analytic shapes (see AnalyticShape)
+  REAL* u;            // barycentric coordinates of the hit in the
+  REAL* v;            // triangle (0 for analytic shapes)
+
+}; // HitBatch
+
+
+//////////////////////////////////////////////////////////
+//
+// SceneQuery: batch scene ray query class
+// ==========
+//
+// Ray queries against a scene for clients other than renderers (e.g.,
+// line of sight or sensor rays in a simulation). The queries run on
+// a two-level SceneBVH. The BVHs of the static meshes are cached in
+// the meshes, so they are shared with the ray tracers rendering the
+// same scene, and do not change once built; the BVHs of the meshes
+// of dynamic actors are owned by the query (see SceneBVH), since the
+// ray tracers refit theirs in place.
+//
+// update() must be called after the scene changes, and not while a
+// query runs nor while another scene BVH of the scene (e.g., of a
+// ray tracer) is updated, since both may cache new BVHs in the
+// meshes. The scene (actors, transforms and mesh vertices) must not
+// change while a query runs; the ray tracers of the scene, however,
+// may update and render. The queries are const and may be called
+// concurrently by any number of threads; each batch is split into
+// chunks of RAY_QUERY_CHUNK_SIZE rays traced by the default thread
+// pool.
+class SceneQuery
+{
+public:
+  bool watertight; // use the watertight ray/triangle test
+
+  // Constructor
+  SceneQuery(Scene&);
+
+  Scene* getScene() const
+  {
+    return bvh->getScene();
+  }
+
+  // Update the acceleration structure to the scene. Return true if
+  // rebuilt
+  bool update();
+
+  // Closest hits of a batch of rays with distance in (0, tMax).
+  // Return the number of rays hit
+  int intersect(const RayBatch&, const HitBatch&) const;
+
+  // Test if there is any hit with distance in (0, tMax) for each ray
+  // of a batch (cheaper than intersect). Return the number of rays hit
+  int occluded(const RayBatch&, bool* hits) const;
+
+private:
+  ObjectPtr<SceneBVH> bvh;
+
+}; // SceneQuery
+
+} // end namespace Graphics
+
+#endif // __SceneQuery_h
@@ -0,0 +1,151 @@
+#ifndef __ThreadPool_h
+#define __ThreadPool_h
+
+//[]------------------------------------------------------------------------[]
+//|                                                                          |
+//|                        GVSG Foundation Classes                           |
+//|                               Version 1.0                                |
+//|                                                                          |
+//|              Copyright 2007-2014, Paulo Aristarco Pagliosa              |
+//|              All Rights Reserved.                                        |
+//|                                                                          |
+//[]------------------------------------------------------------------------[]
+//
+//  OVERVIEW: ThreadPool.h
+//  ========
+//  Class definitions for thread pool and task group.
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+
+namespace System
+{ // begin namespace System
+
+typedef std::function<void()> Task;
+
+
+//////////////////////////////////////////////////////////
+//
+// ThreadPool: thread pool class
+// ==========
+class ThreadPool
+{
+public:
+  // Constructor (0 means one thread per hardware core)
+  ThreadPool(int = 0);
+
+  // Destructor
+  ~ThreadPool();
+
+  // Get number of worker threads
+  int size() const
+  {
+    return numberOfThreads;
+  }
+
+  // Enqueue a task
+  void enqueue(const Task&);
+
+  // Run a pending task in the calling thread, if any
+  bool runPendingTask();
+
+  // Get the default (shared) pool, made on the first call
+  static ThreadPool& getDefault();
+
+private:
+  std::thread* threads;
+  int numberOfThreads;
+  std::deque<Task> tasks;
+  std::mutex lock;
+  std::condition_variable wakeUp;
+  bool done;
+
+  bool popTask(Task&);
+  void workerLoop();
+
+  ThreadPool(const ThreadPool&);
+  ThreadPool& operator =(const ThreadPool&);
+
+}; // ThreadPool
+
+
+//////////////////////////////////////////////////////////
+//
+// TaskGroup: task group class
+// =========
+//
+// Tasks run in a group can run other groups; a thread waiting
+// on a group executes pending tasks of the pool meanwhile and,
+// when there are none, blocks until the tasks of the group end.
+class TaskGroup
+{
+public:
+  // Constructor
+  TaskGroup(ThreadPool& aPool = ThreadPool::getDefault()):
+    pool(aPool),
+    pending(0)
+  {
+    // do nothing
+  }
+
+  // Destructor
+  ~TaskGroup()
+  {
+    wait();
+  }
+
+  ThreadPool& getPool() const
+  {
+    return pool;
+  }
+
+  void run(const Task&);
+  void wait();
+
+private:
+  ThreadPool& pool;
+  std::atomic<int> pending;
+  std::mutex lock;
+  std::condition_variable finished;
+
+  TaskGroup(const TaskGroup&);
+  TaskGroup& operator =(const TaskGroup&);
+
+}; // TaskGroup
+
+//
+// Split [0, n) into chunks and call f(chunk, begin, end) for each
+// one of them in parallel
+//
+template <typename F>
+void
+parallelFor(int n, int numberOfChunks, const F& f)
+{
+  if (numberOfChunks <= 1 || n <= 1)
+  {
+    f(0, 0, n);
+    return;
+  }
+
+  TaskGroup group;
+
+  for (int c = 0; c < numberOfChunks; c++)
+  {
+    int b = int((long long)n * c / numberOfChunks);
+    int e = int((long long)n * (c + 1) / numberOfChunks);
+
+    group.run([&f, c, b, e]()
+    {
+      f(c, b, e);
+    });
+  }
+  group.wait();
+}
+
+} // end namespace System
+
+#endif // __ThreadPool_h
@@ -0,0 +1,122 @@
+#ifndef __TileScheduler_h
+#define __TileScheduler_h
+
+//[]------------------------------------------------------------------------[]
+//|                                                                          |
+//|                        GVSG Foundation Classes                           |
+//|                               Version 1.0                                |
+//|                                                                          |
+//|              Copyright 2007-2014, Paulo Aristarco Pagliosa              |
+//|              All Rights Reserved.                                        |
+//|                                                                          |
+//[]------------------------------------------------------------------------[]
+//
+//  OVERVIEW: TileScheduler.h
+//  ========
+//  Class definition for image tile scheduler.
+
+#include <stdio.h>
+#include "ThreadPool.h"
+
+namespace System
+{ // begin namespace System
+
+typedef std::function<void(int, int, int, int)> TileFunction;
+
+
+//////////////////////////////////////////////////////////
+//
+// TileScheduler: image tile scheduler class
+// =============
+//
+// Splits an image into square tiles, sorts them along a space-filling
+// curve and deals runs of consecutive tiles to one deque per worker
+// thread, so that each thread renders a compact region of the image.
+// A worker pops tiles from the front of its deque and, when it is
+// empty, steals tiles from the back of the deques of the others. The
+// busy and idle times of each worker in the last run are kept.
+class TileScheduler
+{
+public:
+  enum TileOrder
+  {
+    RowMajor,
+    Morton,
+    Hilbert
+  };
+
+  struct WorkerStats
+  {
+    int numberOfTiles;
+    int numberOfStolenTiles;
+    double busyTime; // in seconds
+    double idleTime; // in seconds
+
+  }; // WorkerStats
+
+  int tileSize;
+  TileOrder tileOrder;
+
+  // Constructor
+  TileScheduler(int aTileSize = 32, TileOrder order = Hilbert);
+
+  // Destructor
+  ~TileScheduler();
+
+  // Call f(x1, y1, x2, y2) for each tile [x1, x2) x [y1, y2) of a
+  // W x H image, in parallel on the threads of the pool
+  void run(int W,
+    int H,
+    const TileFunction& f,
+    ThreadPool& pool = ThreadPool::getDefault());
+
+  int getNumberOfWorkers() const
+  {
+    return numberOfWorkers;
+  }
+
+  // Get the stats of the workers in the last run
+  const WorkerStats* getWorkerStats() const
+  {
+    return stats;
+  }
+
+  // Get the duration of the last run (in seconds)
+  double getRunTime() const
+  {
+    return runTime;
+  }
+
+  // Print the stats of the workers in the last run
+  void printStats(FILE* = stdout) const;
+
+private:
+  struct Worker;
+
+  Worker* workers;
+  WorkerStats* stats;
+  int numberOfWorkers;
+  double runTime;
+
+  void resize(int);
+  bool nextTile(int, int&, bool&);
+
+  TileScheduler(const TileScheduler&);
+  TileScheduler& operator =(const TileScheduler&);
+
+}; // TileScheduler
+
+//
+// Get the index of the cell (x, y) along a Hilbert curve filling
+// a 2^k x 2^k grid (n = 2^k)
+//
+extern unsigned hilbertIndex(unsigned n, unsigned x, unsigned y);
+
+//
+// Get the index of the cell (x, y) along a Morton (Z-order) curve
+//
+extern unsigned mortonIndex(unsigned x, unsigned y);
+
+} // end namespace System
+
+#endif // __TileScheduler_h
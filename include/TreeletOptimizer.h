@@ -0,0 +1,85 @@
+#ifndef __TreeletOptimizer_h
+#define __TreeletOptimizer_h
+
+//[]------------------------------------------------------------------------[]
+//|                                                                          |
+//|                          GVSG Graphics Library                           |
+//|                               Version 1.0                                |
+//|                                                                          |
+//|              Copyright 2007-2014, Paulo Aristarco Pagliosa              |
+//|              All Rights Reserved.                                        |
+//|                                                                          |
+//[]------------------------------------------------------------------------[]
+//
+//  OVERVIEW: TreeletOptimizer.h
+//  ========
+//  Class definition for BVH treelet optimizer.
+
+#include "BVH.h"
+
+namespace Graphics
+{ // begin namespace Graphics
+
+#define MAX_TREELET_SIZE 8
+
+
+//////////////////////////////////////////////////////////
+//
+// TreeletOptimizer: BVH treelet optimizer class
+// ================
+//
+// BVH builder that builds a tree with another builder and then
+// restructures its treelets to minimize the SAH cost. For each
+// interior node, bottom-up, a treelet of up to treeletSize leaves
+// is formed by repeatedly opening the treelet leaf with the largest
+// surface area, and the optimal binary topology over the treelet
+// leaves is found by dynamic programming over their subsets. The
+// leaves of the tree are kept; the whole process is repeated a few
+// times (see numberOfIterations). A treelet is only restructured if
+// the tree depth stays within BVH_MAX_DEPTH. The nodes of the result
+// are laid out in depth-first order.
+class TreeletOptimizer: public BVHBuilder
+{
+public:
+  int treeletSize;
+  int numberOfIterations;
+
+  // Constructor
+  TreeletOptimizer(BVHBuilder& aBuilder,
+    int aTreeletSize = 7,
+    int iterations = 3):
+    BVHBuilder(aBuilder.maxPrimitivesInNode),
+    treeletSize(aTreeletSize),
+    numberOfIterations(iterations),
+    builder(aBuilder)
+  {
+    // do nothing
+  }
+
+  void hashSettings(Hash& hash) const
+  {
+    builder.hashSettings(hash);
+    hash.add("treelet").add(treeletSize).add(numberOfIterations);
+  }
+
+protected:
+  void execute(BVH&, Reference*, int);
+
+private:
+  BVHBuilder& builder;
+  BVH::Node* nodes;
+  int (*children)[2];
+  REAL* costs;
+  int* heights;
+
+  void optimizeNode(int, int, int);
+  void restructure(int, int);
+  int emit(BVH::Node*, int, int&) const;
+
+  TreeletOptimizer& operator =(const TreeletOptimizer&);
+
+}; // TreeletOptimizer
+
+} // end namespace Graphics
+
+#endif // __TreeletOptimizer_h
@@ -0,0 +1,283 @@
+#ifndef __TriangleBlock_h
+#define __TriangleBlock_h
+
+//[]------------------------------------------------------------------------[]
+//|                                                                          |
+//|                          GVSG Graphics Library                           |
+//|                               Version 1.0                                |
+//|                                                                          |
+//|              Copyright 2007-2014, Paulo Aristarco Pagliosa              |
+//|              All Rights Reserved.                                        |
+//|                                                                          |
+//[]------------------------------------------------------------------------[]
+//
+//  OVERVIEW: TriangleBlock.h
+//  ========
+//  Class definition for SoA triangle block.
+
+#include "Ray.h"
+#include "SIMD.h"
+
+namespace Graphics
+{ // begin namespace Graphics
+
+#define TRIANGLE_BLOCK_EPS 1e-12f
+
+
+//////////////////////////////////////////////////////////
+//
+// TriangleBlock: SoA triangle block class
+// =============
+//
+// N triangles stored as their first vertex and edges (v0, e1 = v1 - v0,
+// e2 = v2 - v0), one float array of N lanes per coordinate. Unused
+// lanes have null edges (and are never hit) and id -1.
+template <int N>
+struct TriangleBlock
+{
+  float v0[3][N];
+  float e1[3][N];
+  float e2[3][N];
+  int id[N];
+
+  void set(int i, int id, const vec3& v0, const vec3& v1, const vec3& v2)
+  {
+    vec3 e1 = v1 - v0;
+    vec3 e2 = v2 - v0;
+
+    for (int a = 0; a < 3; a++)
+    {
+      this->v0[a][i] = v0[a];
+      this->e1[a][i] = e1[a];
+      this->e2[a][i] = e2[a];
+    }
+    this->id[i] = id;
+  }
+
+  void setEmpty(int i)
+  {
+    for (int a = 0; a < 3; a++)
+      v0[a][i] = e1[a][i] = e2[a][i] = 0;
+    id[i] = -1;
+  }
+
+}; // TriangleBlock
+
+//
+// Moller-Trumbore intersection of a ray with the triangles of a block.
+// Return a bit mask of the lanes hit with distance in (tMin, tMax),
+// with their distances and barycentric coordinates in t, u and v
+//
+template <int N>
+inline int
+triangleBlockHits(const TriangleBlock<N>& block,
+  const Ray& ray,
+  float* t,
+  float* u,
+  float* v)
+{
+  const vec3& o = ray.origin;
+  const vec3& d = ray.direction;
+  int mask = 0;
+
+  for (int i = 0; i < N; i++)
+  {
+    vec3 e1(block.e1[0][i], block.e1[1][i], block.e1[2][i]);
+    vec3 e2(block.e2[0][i], block.e2[1][i], block.e2[2][i]);
+    vec3 s1 = d.cross(e2);
+    REAL det = s1.dot(e1);
+
+    if (Math::isZero<REAL>(det, REAL(TRIANGLE_BLOCK_EPS)))
+      continue;
+
+    REAL invDet = Math::inverse<REAL>(det);
+    vec3 s = o - vec3(block.v0[0][i], block.v0[1][i], block.v0[2][i]);
+
+    if ((u[i] = s.dot(s1) * invDet) < 0 || u[i] > 1)
+      continue;
+
+    vec3 s2 = s.cross(e1);
+
+    if ((v[i] = d.dot(s2) * invDet) < 0 || u[i] + v[i] > 1)
+      continue;
+    t[i] = e2.dot(s2) * invDet;
+    if (t[i] > ray.tMin && t[i] < ray.tMax)
+      mask |= 1 << i;
+  }
+  return mask;
+}
+
+#ifdef SIMD_X86
+
+template <>
+inline int
+triangleBlockHits<4>(const TriangleBlock<4>& block,
+  const Ray& ray,
+  float* t,
+  float* u,
+  float* v)
+{
+  __m128 dx = _mm_set1_ps(ray.direction.x);
+  __m128 dy = _mm_set1_ps(ray.direction.y);
+  __m128 dz = _mm_set1_ps(ray.direction.z);
+  __m128 e1x = _mm_loadu_ps(block.e1[0]);
+  __m128 e1y = _mm_loadu_ps(block.e1[1]);
+  __m128 e1z = _mm_loadu_ps(block.e1[2]);
+  __m128 e2x = _mm_loadu_ps(block.e2[0]);
+  __m128 e2y = _mm_loadu_ps(block.e2[1]);
+  __m128 e2z = _mm_loadu_ps(block.e2[2]);
+  // s1 = d x e2
+  __m128 s1x = _mm_sub_ps(_mm_mul_ps(dy, e2z), _mm_mul_ps(dz, e2y));
+  __m128 s1y = _mm_sub_ps(_mm_mul_ps(dz, e2x), _mm_mul_ps(dx, e2z));
+  __m128 s1z = _mm_sub_ps(_mm_mul_ps(dx, e2y), _mm_mul_ps(dy, e2x));
+  __m128 det = _mm_add_ps(_mm_add_ps(_mm_mul_ps(s1x, e1x),
+    _mm_mul_ps(s1y, e1y)), _mm_mul_ps(s1z, e1z));
+  __m128 invDet = _mm_div_ps(_mm_set1_ps(1), det);
+  // s = o - v0
+  __m128 sx = _mm_sub_ps(_mm_set1_ps(ray.origin.x), _mm_loadu_ps(block.v0[0]));
+  __m128 sy = _mm_sub_ps(_mm_set1_ps(ray.origin.y), _mm_loadu_ps(block.v0[1]));
+  __m128 sz = _mm_sub_ps(_mm_set1_ps(ray.origin.z), _mm_loadu_ps(block.v0[2]));
+  __m128 b1 = _mm_mul_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(sx, s1x),
+    _mm_mul_ps(sy, s1y)), _mm_mul_ps(sz, s1z)), invDet);
+  // s2 = s x e1
+  __m128 s2x = _mm_sub_ps(_mm_mul_ps(sy, e1z), _mm_mul_ps(sz, e1y));
+  __m128 s2y = _mm_sub_ps(_mm_mul_ps(sz, e1x), _mm_mul_ps(sx, e1z));
+  __m128 s2z = _mm_sub_ps(_mm_mul_ps(sx, e1y), _mm_mul_ps(sy, e1x));
+  __m128 b2 = _mm_mul_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(dx, s2x),
+    _mm_mul_ps(dy, s2y)), _mm_mul_ps(dz, s2z)), invDet);
+  __m128 d = _mm_mul_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(e2x, s2x),
+    _mm_mul_ps(e2y, s2y)), _mm_mul_ps(e2z, s2z)), invDet);
+  __m128 zero = _mm_setzero_ps();
+  __m128 one = _mm_set1_ps(1);
+  __m128 absDet = _mm_andnot_ps(_mm_set1_ps(-0.0f), det);
+  __m128 mask = _mm_cmpgt_ps(absDet, _mm_set1_ps(TRIANGLE_BLOCK_EPS));
+
+  mask = _mm_and_ps(mask, _mm_cmpge_ps(b1, zero));
+  mask = _mm_and_ps(mask, _mm_cmple_ps(b1, one));
+  mask = _mm_and_ps(mask, _mm_cmpge_ps(b2, zero));
+  mask = _mm_and_ps(mask, _mm_cmple_ps(_mm_add_ps(b1, b2), one));
+  mask = _mm_and_ps(mask, _mm_cmpgt_ps(d, _mm_set1_ps(ray.tMin)));
+  mask = _mm_and_ps(mask, _mm_cmplt_ps(d, _mm_set1_ps(ray.tMax)));
+
+  _mm_storeu_ps(t, d);
+  _mm_storeu_ps(u, b1);
+  _mm_storeu_ps(v, b2);
+  return _mm_movemask_ps(mask);
+}
+
+template <>
+SIMD_AVX inline int
+triangleBlockHits<8>(const TriangleBlock<8>& block,
+  const Ray& ray,
+  float* t,
+  float* u,
+  float* v)
+{
+  __m256 dx = _mm256_set1_ps(ray.direction.x);
+  __m256 dy = _mm256_set1_ps(ray.direction.y);
+  __m256 dz = _mm256_set1_ps(ray.direction.z);
+  __m256 e1x = _mm256_loadu_ps(block.e1[0]);
+  __m256 e1y = _mm256_loadu_ps(block.e1[1]);
+  __m256 e1z = _mm256_loadu_ps(block.e1[2]);
+  __m256 e2x = _mm256_loadu_ps(block.e2[0]);
+  __m256 e2y = _mm256_loadu_ps(block.e2[1]);
+  __m256 e2z = _mm256_loadu_ps(block.e2[2]);
+  // s1 = d x e2
+  __m256 s1x = _mm256_sub_ps(_mm256_mul_ps(dy, e2z), _mm256_mul_ps(dz, e2y));
+  __m256 s1y = _mm256_sub_ps(_mm256_mul_ps(dz, e2x), _mm256_mul_ps(dx, e2z));
+  __m256 s1z = _mm256_sub_ps(_mm256_mul_ps(dx, e2y), _mm256_mul_ps(dy, e2x));
+  __m256 det = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(s1x, e1x),
+    _mm256_mul_ps(s1y, e1y)), _mm256_mul_ps(s1z, e1z));
+  __m256 invDet = _mm256_div_ps(_mm256_set1_ps(1), det);
+  // s = o - v0
+  __m256 sx = _mm256_sub_ps(_mm256_set1_ps(ray.origin.x),
+    _mm256_loadu_ps(block.v0[0]));
+  __m256 sy = _mm256_sub_ps(_mm256_set1_ps(ray.origin.y),
+    _mm256_loadu_ps(block.v0[1]));
+  __m256 sz = _mm256_sub_ps(_mm256_set1_ps(ray.origin.z),
+    _mm256_loadu_ps(block.v0[2]));
+  __m256 b1 = _mm256_mul_ps(_mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(sx, s1x),
+    _mm256_mul_ps(sy, s1y)), _mm256_mul_ps(sz, s1z)), invDet);
+  // s2 = s x e1
+  __m256 s2x = _mm256_sub_ps(_mm256_mul_ps(sy, e1z), _mm256_mul_ps(sz, e1y));
+  __m256 s2y = _mm256_sub_ps(_mm256_mul_ps(sz, e1x), _mm256_mul_ps(sx, e1z));
+  __m256 s2z = _mm256_sub_ps(_mm256_mul_ps(sx, e1y), _mm256_mul_ps(sy, e1x));
+  __m256 b2 = _mm256_mul_ps(_mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(dx, s2x),
+    _mm256_mul_ps(dy, s2y)), _mm256_mul_ps(dz, s2z)), invDet);
+  __m256 d = _mm256_mul_ps(_mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(e2x, s2x),
+    _mm256_mul_ps(e2y, s2y)), _mm256_mul_ps(e2z, s2z)), invDet);
+  __m256 zero = _mm256_setzero_ps();
+  __m256 one = _mm256_set1_ps(1);
+  __m256 absDet = _mm256_andnot_ps(_mm256_set1_ps(-0.0f), det);
+  __m256 mask = _mm256_cmp_ps(absDet,
+    _mm256_set1_ps(TRIANGLE_BLOCK_EPS),
+    _CMP_GT_OQ);
+
+  mask = _mm256_and_ps(mask, _mm256_cmp_ps(b1, zero, _CMP_GE_OQ));
+  mask = _mm256_and_ps(mask, _mm256_cmp_ps(b1, one, _CMP_LE_OQ));
+  mask = _mm256_and_ps(mask, _mm256_cmp_ps(b2, zero, _CMP_GE_OQ));
+  mask = _mm256_and_ps(mask,
+    _mm256_cmp_ps(_mm256_add_ps(b1, b2), one, _CMP_LE_OQ));
+  mask = _mm256_and_ps(mask,
+    _mm256_cmp_ps(d, _mm256_set1_ps(ray.tMin), _CMP_GT_OQ));
+  mask = _mm256_and_ps(mask,
+    _mm256_cmp_ps(d, _mm256_set1_ps(ray.tMax), _CMP_LT_OQ));
+
+  _mm256_storeu_ps(t, d);
+  _mm256_storeu_ps(u, b1);
+  _mm256_storeu_ps(v, b2);
+  return _mm256_movemask_ps(mask);
+}
+
+#endif // SIMD_X86
+
+//
+// Intersect a ray with the triangles of a block. Return the lane of
+// the closest hit with distance in (tMin, tMax), if any, or -1
+//
+template <int N>
+inline int
+intersectTriangleBlock(const TriangleBlock<N>& block,
+  const Ray& ray,
+  REAL& t,
+  REAL& b1,
+  REAL& b2)
+{
+  float tv[N];
+  float uv[N];
+  float vv[N];
+  int mask = triangleBlockHits<N>(block, ray, tv, uv, vv);
+  int hit = -1;
+
+  for (int i = 0; mask != 0; i++, mask >>= 1)
+    if ((mask & 1) && (hit < 0 || tv[i] < t))
+    {
+      t = tv[i];
+      hit = i;
+    }
+  if (hit >= 0)
+  {
+    b1 = uv[hit];
+    b2 = vv[hit];
+  }
+  return hit;
+}
+
+//
+// Test if a ray hits any triangle of a block with distance in
+// (tMin, tMax)
+//
+template <int N>
+inline bool
+occludedTriangleBlock(const TriangleBlock<N>& block, const Ray& ray)
+{
+  float tv[N];
+  float uv[N];
+  float vv[N];
+
+  return triangleBlockHits<N>(block, ray, tv, uv, vv) != 0;
+}
+
+} // end namespace Graphics
+
+#endif // __TriangleBlock_h
@@ -220,6 +220,7 @@ public:
   }; // Arrays
 
   ObjectPtr<Object> userData;
+  ObjectPtr<Object> accelerationData; // ray query data (see meshBVH())
 
   // Constructor
   TriangleMesh(const Arrays& aData):
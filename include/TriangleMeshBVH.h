@@ -0,0 +1,142 @@
+#ifndef __TriangleMeshBVH_h
+#define __TriangleMeshBVH_h
+
+//[]------------------------------------------------------------------------[]
+//|                                                                          |
+//|                          GVSG Graphics Library                           |
+//|                               Version 1.0                                |
+//|                                                                          |
+//|              Copyright 2007-2014, Paulo Aristarco Pagliosa              |
+//|              All Rights Reserved.                                        |
+//|                                                                          |
+//[]------------------------------------------------------------------------[]
+//
+//  OVERVIEW: TriangleMeshBVH.h
+//  ========
+//  Class definition for triangle mesh BVH.
+
+#include "TriangleBlock.h"
+#include "TriangleMesh.h"
+#include "WideBVH.h"
+
+namespace Graphics
+{ // begin namespace Graphics
+
+#define DFL_MAX_SAH_DEGRADATION (REAL)1.5
+
+
+//////////////////////////////////////////////////////////
+//
+// TriangleMeshWideBVH: triangle mesh wide BVH class
+// ===================
+//
+// Wide BVH whose leaves are blocks of N triangles in SoA layout,
+// copied from the mesh, so that traversal does not touch the mesh
+// arrays and each block is intersected by a single SIMD kernel.
+template <int N>
+class TriangleMeshWideBVH: public WideBVH<N>
+{
+public:
+  // Constructor
+  TriangleMeshWideBVH(const BVH&, const TriangleMesh::Arrays&);
+
+  // Destructor
+  ~TriangleMeshWideBVH()
+  {
+    delete []blocks;
+  }
+
+  // Closest ray/triangle intersection (ray in mesh coordinates)
+  bool intersect(const Ray&, Intersection&, bool watertight) const;
+
+  // Test if there is any intersection (ray in mesh coordinates)
+  bool occluded(const Ray&, bool watertight) const;
+
+private:
+  TriangleBlock<N>* blocks;
+  const TriangleMesh::Arrays& data;
+
+  TriangleMeshWideBVH& operator =(const TriangleMeshWideBVH&);
+
+}; // TriangleMeshWideBVH
+
+
+//////////////////////////////////////////////////////////
+//
+// TriangleMeshBVH: triangle mesh BVH class
+// ===============
+//
+// After each build or refit, the binary tree is collapsed into a
+// 4-wide or 8-wide triangle mesh wide BVH, according to the SIMD
+// support of the CPU (see wideBVHWidth()), which is used for the ray
+// queries.
+class TriangleMeshBVH: public BVH
+{
+public:
+  // Constructor
+  TriangleMeshBVH(const TriangleMesh*, BVHBuilder&);
+
+  // Destructor
+  ~TriangleMeshBVH();
+
+  const TriangleMesh* getMesh() const
+  {
+    return mesh;
+  }
+
+  // Rebuild the hierarchy from the current mesh vertices
+  void rebuild(BVHBuilder&);
+
+  // Refit the hierarchy to the current mesh vertices. If the number
+  // of triangles changed or the SAH cost of the refitted tree is more
+  // than maxDegradation times the cost of the last build, rebuild it
+  // instead. Return true if rebuilt
+  bool refit(BVHBuilder&, REAL maxDegradation = DFL_MAX_SAH_DEGRADATION);
+
+  // Closest ray/triangle intersection (ray in mesh coordinates),
+  // using the fast or the watertight ray/triangle test
+  bool intersect(const Ray&, Intersection&, bool watertight = false) const;
+
+  // Test if there is any intersection with distance in (ray.tMin, tMax)
+  // (ray in mesh coordinates). Cheaper than intersect: the traversal
+  // stops at the first hit
+  bool occluded(const Ray&, REAL tMax, bool watertight = false) const;
+
+  // Closest intersections of the rays in mask of a packet (rays in
+  // mesh coordinates), using the fast ray/triangle test. The hits of
+  // the rays hit, indexed by their lanes, and their tMax are set.
+  // Return the mask of the rays hit
+  int intersect(RayPacket&, int mask, Intersection*) const;
+
+  // Get the mask of the rays in mask of a packet (rays in mesh
+  // coordinates) with any intersection in (tMin, tMax)
+  int occluded(const RayPacket&, int mask) const;
+
+private:
+  const TriangleMesh* mesh;
+  TriangleMeshWideBVH<4>* bvh4;
+  TriangleMeshWideBVH<8>* bvh8;
+
+  void collapse();
+
+}; // TriangleMeshBVH
+
+//
+// Get the BVH cached in the mesh acceleration data, if any
+//
+inline TriangleMeshBVH*
+getBVH(const TriangleMesh* mesh)
+{
+  return dynamic_cast<TriangleMeshBVH*>((Object*)mesh->accelerationData);
+}
+
+//
+// Get the BVH of a mesh, building (with the given builder or, by
+// default, a binned SAH builder) and caching it if needed
+//
+extern TriangleMeshBVH* meshBVH(TriangleMesh*, BVHBuilder&);
+extern TriangleMeshBVH* meshBVH(TriangleMesh*);
+
+} // end namespace Graphics
+
+#endif // __TriangleMeshBVH_h
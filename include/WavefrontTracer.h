@@ -0,0 +1,123 @@
+#ifndef __WavefrontTracer_h
+#define __WavefrontTracer_h
+
+//[]------------------------------------------------------------------------[]
+//|                                                                          |
+//|                          GVSG Graphics Library                           |
+//|                               Version 1.0                                |
+//|                                                                          |
+//|              Copyright 2007-2014, Paulo Aristarco Pagliosa              |
+//|              All Rights Reserved.                                        |
+//|                                                                          |
+//[]------------------------------------------------------------------------[]
+//
+//  OVERVIEW: WavefrontTracer.h
+//  ========
+//  Class definition for wavefront ray tracer.
+
+#include <vector>
+#include "RayTracer.h"
+
+namespace Graphics
+{ // begin namespace Graphics
+
+
+//////////////////////////////////////////////////////////
+//
+// WavefrontTracer: wavefront ray tracer class
+// ===============
+//
+// Renders the image in waves of (at most) waveSize pixels. Instead of
+// following each path recursively, every bounce of a wave runs as a
+// sequence of stages over the stream of all its rays: the rays are
+// intersected in parallel; the hits are binned into one queue per
+// material (keyed by Material::getIndex()) and each queue is shaded
+// in chunks, which emit shadow rays, tested as another stream, and
+// the reflected and refracted rays of the next bounce. If sortRays is
+// set, these are sorted by direction octant and then by the Morton
+// code of their origins in the scene bounds before being intersected,
+// so that the rays traced by a thread go through the same region in
+// similar directions and share the nodes and triangles they fetch.
+//
+// Shading follows the Whitted model of RayTracer::shade() (which is
+// not called), so both tracers render the same images.
+class WavefrontTracer: public RayTracer
+{
+public:
+  int waveSize;
+  bool sortRays;
+
+  // Constructor
+  WavefrontTracer(Scene&, Camera* = 0);
+
+  // Get the number of rays, but shadow rays, traced in the last render
+  long long getNumberOfRays() const
+  {
+    return numberOfRays;
+  }
+
+  // Get the number of shadow rays traced in the last render
+  long long getNumberOfShadowRays() const
+  {
+    return numberOfShadowRays;
+  }
+
+protected:
+  struct PathRay
+  {
+    Ray ray;
+    Color weight;    // product of the reflectances along the path
+    REAL importance; // scalar weight compared to minWeight
+    int pixel;       // pixel index in the wave
+
+  }; // PathRay
+
+  struct ShadowRay
+  {
+    Ray ray;
+    Color color; // contribution to the pixel if not occluded
+    int pixel;
+
+  }; // ShadowRay
+
+  struct ShadingTask
+  {
+    int begin; // range of a material queue
+    int end;
+    std::vector<ShadowRay> shadowRays;
+    std::vector<PathRay> rays;
+
+  }; // ShadingTask
+
+  std::vector<PathRay> rays;
+  std::vector<PathRay> nextRays;
+  std::vector<Intersection> hits;
+  std::vector<Color> colors; // local shading of the hit of each ray
+  std::vector<int> keys;
+  std::vector<int> queue;
+  std::vector<int> queueOffsets;
+  std::vector<ShadingTask> tasks;
+  std::vector<ShadowRay> shadowRays;
+  std::vector<char> occluded;
+  std::vector<Color> radiance;
+  std::vector<Light*> lights;
+  std::vector<unsigned long long> codes;
+  std::vector<unsigned long long> sortedCodes;
+  long long numberOfRays;
+  long long numberOfShadowRays;
+
+  void scan();
+
+  void renderWave(int, int);
+  void intersectRays();
+  void binRays();
+  void shadeRays(int);
+  void shadeQueue(ShadingTask&, int);
+  void traceShadowRays();
+  void sortRaysByOctantAndOrigin();
+
+}; // WavefrontTracer
+
+} // end namespace Graphics
+
+#endif // __WavefrontTracer_h
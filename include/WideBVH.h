@@ -0,0 +1,367 @@
+#ifndef __WideBVH_h
+#define __WideBVH_h
+
+//[]------------------------------------------------------------------------[]
+//|                                                                          |
+//|                          GVSG Graphics Library                           |
+//|                               Version 1.0                                |
+//|                                                                          |
+//|              Copyright 2007-2014, Paulo Aristarco Pagliosa              |
+//|              All Rights Reserved.                                        |
+//|                                                                          |
+//[]------------------------------------------------------------------------[]
+//
+//  OVERVIEW: WideBVH.h
+//  ========
+//  Class definition for wide (4/8-ary) BVH.
+
+#include "BVH.h"
+#include "SIMD.h"
+
+namespace Graphics
+{ // begin namespace Graphics
+
+//
+// Wide BVH node (N children, bounds in SoA layout), padded to 32N
+// bytes (two cache lines for N = 4, four for N = 8)
+//
+template <int N>
+struct WideBVHNode: public CacheAligned
+{
+  float bounds[2][3][N]; // [min/max][axis][child]
+  int child[N];          // child node (interior) or first block (leaf)
+  uint16 count[N];       // number of blocks (0 for interior children)
+  int numberOfChildren;
+  uint16 reserved[N - 2];
+
+}; // WideBVHNode
+
+//
+// Ray data for wide BVH traversal
+//
+struct WideBVHRay
+{
+  float origin[3];
+  float invD[3];
+  int sign[3]; // 1 if the near plane along the axis is the max plane
+  float tMin;
+
+  WideBVHRay(const Ray& ray)
+  {
+    vec3 d = ray.direction.inverse();
+
+    for (int i = 0; i < 3; i++)
+    {
+      origin[i] = ray.origin[i];
+      invD[i] = d[i];
+      sign[i] = d[i] < 0;
+    }
+    tMin = ray.tMin;
+  }
+
+}; // WideBVHRay
+
+//
+// Intersect a ray with the children of a node. Return a bit mask of
+// the children hit and their entry distances in tNear
+//
+template <int N>
+inline int
+intersectChildren(const WideBVHNode<N>& node,
+  const WideBVHRay& ray,
+  float tMax,
+  float* tNear)
+{
+  int mask = 0;
+
+  for (int i = 0; i < node.numberOfChildren; i++)
+  {
+    float t1 = ray.tMin;
+    float t2 = tMax;
+
+    for (int a = 0; a < 3; a++)
+    {
+      float tn = (node.bounds[ray.sign[a]][a][i] - ray.origin[a]) *
+        ray.invD[a];
+      float tf = (node.bounds[1 - ray.sign[a]][a][i] - ray.origin[a]) *
+        ray.invD[a];
+
+      if (tn > t1)
+        t1 = tn;
+      if (tf < t2)
+        t2 = tf;
+    }
+    tNear[i] = t1;
+    if (t1 <= t2)
+      mask |= 1 << i;
+  }
+  return mask;
+}
+
+#ifdef SIMD_X86
+
+template <>
+inline int
+intersectChildren<4>(const WideBVHNode<4>& node,
+  const WideBVHRay& ray,
+  float tMax,
+  float* tNear)
+{
+  __m128 t1 = _mm_set1_ps(ray.tMin);
+  __m128 t2 = _mm_set1_ps(tMax);
+
+  for (int a = 0; a < 3; a++)
+  {
+    __m128 o = _mm_set1_ps(ray.origin[a]);
+    __m128 invD = _mm_set1_ps(ray.invD[a]);
+    __m128 tn = _mm_loadu_ps(node.bounds[ray.sign[a]][a]);
+    __m128 tf = _mm_loadu_ps(node.bounds[1 - ray.sign[a]][a]);
+
+    // A NaN (0 * inf) in the second operand keeps t1 or t2, as in the
+    // scalar test
+    t1 = _mm_max_ps(_mm_mul_ps(_mm_sub_ps(tn, o), invD), t1);
+    t2 = _mm_min_ps(_mm_mul_ps(_mm_sub_ps(tf, o), invD), t2);
+  }
+  _mm_storeu_ps(tNear, t1);
+  return _mm_movemask_ps(_mm_cmple_ps(t1, t2)) &
+    ((1 << node.numberOfChildren) - 1);
+}
+
+template <>
+SIMD_AVX inline int
+intersectChildren<8>(const WideBVHNode<8>& node,
+  const WideBVHRay& ray,
+  float tMax,
+  float* tNear)
+{
+  __m256 t1 = _mm256_set1_ps(ray.tMin);
+  __m256 t2 = _mm256_set1_ps(tMax);
+
+  for (int a = 0; a < 3; a++)
+  {
+    __m256 o = _mm256_set1_ps(ray.origin[a]);
+    __m256 invD = _mm256_set1_ps(ray.invD[a]);
+    __m256 tn = _mm256_loadu_ps(node.bounds[ray.sign[a]][a]);
+    __m256 tf = _mm256_loadu_ps(node.bounds[1 - ray.sign[a]][a]);
+
+    t1 = _mm256_max_ps(_mm256_mul_ps(_mm256_sub_ps(tn, o), invD), t1);
+    t2 = _mm256_min_ps(_mm256_mul_ps(_mm256_sub_ps(tf, o), invD), t2);
+  }
+  _mm256_storeu_ps(tNear, t1);
+  return _mm256_movemask_ps(_mm256_cmp_ps(t1, t2, _CMP_LE_OQ)) &
+    ((1 << node.numberOfChildren) - 1);
+}
+
+#endif // SIMD_X86
+
+
+//////////////////////////////////////////////////////////
+//
+// WideBVH: wide BVH class
+// =======
+//
+// N-ary BVH (N = 4 for SSE, 8 for AVX) collapsed from a binary BVH.
+// One ray is tested against all the children of a node at once. Nodes
+// are stored in depth-first order.
+//
+// The primitives of each leaf are grouped in blocks of blockSize
+// primitives (padded with -1 ids), so that the primitives of a block
+// can be intersected together. A binary subtree with at most
+// blockSize primitives becomes a single leaf, so that the blocks are
+// filled even if the binary leaves are smaller than a block.
+template <int N>
+class WideBVH
+{
+public:
+  typedef WideBVHNode<N> Node;
+
+  // Constructor
+  WideBVH(const BVH&, int blockSize = 1);
+
+  // Destructor
+  ~WideBVH()
+  {
+    delete []nodes;
+    delete []blockIds;
+  }
+
+  int getNumberOfNodes() const
+  {
+    return numberOfNodes;
+  }
+
+  const Node* getNodes() const
+  {
+    return nodes;
+  }
+
+  int getBlockSize() const
+  {
+    return blockSize;
+  }
+
+  int getNumberOfBlocks() const
+  {
+    return numberOfBlocks;
+  }
+
+  // Get the primitive ids of the blocks (blockSize ids per block)
+  const int* getBlockIds() const
+  {
+    return blockIds;
+  }
+
+  // Closest hit traversal. The intersector is called as
+  // intersector(block, ray) for the blocks of each leaf hit by the
+  // ray; it returns true on a hit and must then set ray.tMax to the
+  // hit distance
+  template <typename Intersector>
+  bool intersect(Ray&, Intersector&) const;
+
+  // Any hit traversal: stops at the first block for which
+  // intersector(block, ray) returns true. The children hit are not
+  // sorted
+  template <typename Intersector>
+  bool occluded(const Ray&, Intersector&) const;
+
+private:
+  struct StackEntry
+  {
+    int index;
+    int count;
+    float t;
+
+  }; // StackEntry
+
+  Node* nodes;
+  int numberOfNodes;
+  int* blockIds;
+  int numberOfBlocks;
+  int blockSize;
+  const int* primitiveIds;
+
+  int* subtreeCounts; // number of primitives of each binary subtree
+
+  int countPrimitives(const BVH::Node*, int);
+  int gatherPrimitives(const BVH::Node*, int, int*) const;
+  bool isWideLeaf(const BVH::Node*, int) const;
+  int collapse(const BVH::Node*, int);
+  int makeBlocks(const BVH::Node*, int);
+
+  WideBVH(const WideBVH&);
+  WideBVH& operator =(const WideBVH&);
+
+}; // WideBVH
+
+
+//////////////////////////////////////////////////////////
+//
+// WideBVH inline implementation
+// =======
+template <int N>
+template <typename Intersector>
+bool
+WideBVH<N>::intersect(Ray& ray, Intersector& intersector) const
+{
+  if (numberOfNodes == 0)
+    return false;
+
+  WideBVHRay r(ray);
+  StackEntry stack[BVH_MAX_DEPTH * (N - 1) + 1];
+  int top = 0;
+  bool hit = false;
+
+  stack[0].index = 0;
+  stack[0].count = 0;
+  stack[0].t = ray.tMin;
+  top = 1;
+  while (top > 0)
+  {
+    StackEntry e = stack[--top];
+
+    if (e.t > ray.tMax)
+      continue;
+    if (e.count != 0)
+    {
+      for (int i = e.index, end = i + e.count; i < end; i++)
+        if (intersector(i, ray))
+          hit = true;
+      continue;
+    }
+
+    const Node& node = nodes[e.index];
+    float tNear[N];
+    int mask = intersectChildren<N>(node, r, ray.tMax, tNear);
+    int first = top;
+
+    // Push the children hit, the nearest on the top
+    for (int i = 0; mask != 0; i++, mask >>= 1)
+      if (mask & 1)
+      {
+        StackEntry c;
+
+        c.index = node.child[i];
+        c.count = node.count[i];
+        c.t = tNear[i];
+
+        int k = top++;
+
+        for (; k > first && stack[k - 1].t < c.t; k--)
+          stack[k] = stack[k - 1];
+        stack[k] = c;
+      }
+  }
+  return hit;
+}
+
+template <int N>
+template <typename Intersector>
+bool
+WideBVH<N>::occluded(const Ray& ray, Intersector& intersector) const
+{
+  if (numberOfNodes == 0)
+    return false;
+
+  WideBVHRay r(ray);
+  int stack[BVH_MAX_DEPTH * (N - 1) + 1];
+  int top = 0;
+
+  stack[top++] = 0;
+  while (top > 0)
+  {
+    const Node& node = nodes[stack[--top]];
+    float tNear[N];
+    int mask = intersectChildren<N>(node, r, ray.tMax, tNear);
+
+    for (int i = 0; mask != 0; i++, mask >>= 1)
+      if (mask & 1)
+      {
+        if (node.count[i] == 0)
+          stack[top++] = node.child[i];
+        else
+          for (int b = node.child[i], e = b + node.count[i]; b < e; b++)
+            if (intersector(b, ray))
+              return true;
+      }
+  }
+  return false;
+}
+
+//
+// Get the SIMD width of the wide BVHs used for ray tracing (4 or 8),
+// or 0 if the binary BVHs should be used instead
+//
+inline int
+wideBVHWidth()
+{
+#ifdef SIMD_X86
+  int width = simdWidth();
+  return width >= 8 ? 8 : width >= 4 ? 4 : 0;
+#else
+  return 0;
+#endif
+}
+
+} // end namespace Graphics
+
+#endif // __WideBVH_h
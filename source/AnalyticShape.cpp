@@ -0,0 +1,329 @@
+//[]------------------------------------------------------------------------[]
+//|                                                                          |
+//|                          GVSG Graphics Classes                           |
+//|                               Version 1.0                                |
+//|                                                                          |
+//|              Copyright 2010-2014, Paulo Aristarco Pagliosa              |
+//|              All Rights Reserved.                                        |
+//|                                                                          |
+//[]------------------------------------------------------------------------[]
+//
+//  OVERVIEW: AnalyticShape.cpp
+//  ========
+//  Source file for analytic shapes.
+
+#include "AnalyticShape.h"
+#include "MeshSweeper.h"
+
+using namespace Graphics;
+
+//
+// Auxiliary function
+//
+// Get the parameters of the intersections of a ray, given by its
+// origin o and direction d relative to the center of a circle or
+// sphere of radius r, with the circle or sphere. Return false if none
+//
+inline bool
+intersectCircle(const vec3& o, const vec3& d, REAL r, REAL& t1, REAL& t2)
+{
+  REAL a = d.dot(d);
+
+  if (a <= 0)
+    return false;
+
+  // Parameter and distance to the center of the point closest to it
+  REAL b = -o.dot(d) / a;
+  vec3 l = o + d * b;
+  REAL h = r * r - l.dot(l);
+
+  if (h < 0)
+    return false;
+  h = (REAL)sqrt(h / a);
+  t1 = b - h;
+  t2 = b + h;
+  return true;
+}
+
+
+//////////////////////////////////////////////////////////
+//
+// AnalyticShape implementation
+// =============
+Bounds3
+AnalyticShape::boundingBox() const
+//[]---------------------------------------------------[]
+//|  Bounding box                                       |
+//[]---------------------------------------------------[]
+{
+  return Bounds3(bounds, this->matrix);
+}
+
+const TriangleMesh*
+AnalyticShape::triangleMesh() const
+//[]---------------------------------------------------[]
+//|  Triangle mesh                                      |
+//[]---------------------------------------------------[]
+{
+  if (mesh == 0)
+    mesh = tessellate();
+  return mesh;
+}
+
+
+//////////////////////////////////////////////////////////
+//
+// SphereShape implementation
+// ===========
+SphereShape::SphereShape(const vec3& aCenter, REAL aRadius):
+  center(aCenter),
+  radius(aRadius)
+//[]---------------------------------------------------[]
+//|  Constructor                                        |
+//[]---------------------------------------------------[]
+{
+  vec3 r(aRadius, aRadius, aRadius);
+
+  bounds.set(aCenter - r, aCenter + r);
+}
+
+Object*
+SphereShape::clone() const
+//[]---------------------------------------------------[]
+//|  Make copy                                          |
+//[]---------------------------------------------------[]
+{
+  return new SphereShape(center, radius);
+}
+
+bool
+SphereShape::intersect(const Ray& ray, Intersection& hit) const
+//[]---------------------------------------------------[]
+//|  Closest intersection                               |
+//[]---------------------------------------------------[]
+{
+  REAL t1;
+  REAL t2;
+
+  if (!intersectCircle(ray.origin - center, ray.direction, radius, t1, t2))
+    return false;
+  if (t1 <= ray.tMin)
+    t1 = t2;
+  if (t1 <= ray.tMin || t1 >= ray.tMax)
+    return false;
+  hit.distance = t1;
+  hit.p = ray(t1);
+  hit.normal = (hit.p - center) * Math::inverse<REAL>(radius);
+  return true;
+}
+
+TriangleMesh*
+SphereShape::tessellate() const
+//[]---------------------------------------------------[]
+//|  Tessellate                                         |
+//[]---------------------------------------------------[]
+{
+  return MeshSweeper::makeSphere(center, radius);
+}
+
+
+//////////////////////////////////////////////////////////
+//
+// BoxShape implementation
+// ========
+BoxShape::BoxShape(const vec3& center, const vec3& size)
+//[]---------------------------------------------------[]
+//|  Constructor                                        |
+//[]---------------------------------------------------[]
+{
+  vec3 h = size * (REAL)0.5;
+
+  bounds.set(center - h, center + h);
+}
+
+Object*
+BoxShape::clone() const
+//[]---------------------------------------------------[]
+//|  Make copy                                          |
+//[]---------------------------------------------------[]
+{
+  return new BoxShape(bounds.center(), bounds.size());
+}
+
+bool
+BoxShape::intersect(const Ray& ray, Intersection& hit) const
+//[]---------------------------------------------------[]
+//|  Closest intersection                               |
+//|                                                     |
+//|  Slab test, keeping the axes of the entry and exit  |
+//|  faces for the normal.                              |
+//[]---------------------------------------------------[]
+{
+  const vec3& p1 = bounds.getMin();
+  const vec3& p2 = bounds.getMax();
+  const vec3& o = ray.origin;
+  const vec3& d = ray.direction;
+  REAL tNear = -FloatInfo<REAL>::inf();
+  REAL tFar = FloatInfo<REAL>::inf();
+  int nearAxis = 0;
+  int farAxis = 0;
+
+  for (int a = 0; a < 3; a++)
+  {
+    REAL invD = Math::inverse<REAL>(d[a]);
+    REAL t1 = (p1[a] - o[a]) * invD;
+    REAL t2 = (p2[a] - o[a]) * invD;
+
+    if (t1 > t2)
+      dSwap<REAL>(t1, t2);
+    if (t1 > tNear)
+    {
+      tNear = t1;
+      nearAxis = a;
+    }
+    if (t2 < tFar)
+    {
+      tFar = t2;
+      farAxis = a;
+    }
+  }
+  if (tNear > tFar)
+    return false;
+
+  vec3 N(0, 0, 0);
+
+  if (tNear > ray.tMin && tNear < ray.tMax)
+  {
+    hit.distance = tNear;
+    N[nearAxis] = d[nearAxis] < 0 ? 1 : -1;
+  }
+  else if (tFar > ray.tMin && tFar < ray.tMax)
+  {
+    // The ray starts inside the box
+    hit.distance = tFar;
+    N[farAxis] = d[farAxis] < 0 ? -1 : 1;
+  }
+  else
+    return false;
+  hit.p = ray(hit.distance);
+  hit.normal = N;
+  return true;
+}
+
+TriangleMesh*
+BoxShape::tessellate() const
+//[]---------------------------------------------------[]
+//|  Tessellate                                         |
+//[]---------------------------------------------------[]
+{
+  return MeshSweeper::makeBox(bounds.center(),
+    vec3(0, 0, 1),
+    vec3(0, 1, 0),
+    bounds.size());
+}
+
+
+//////////////////////////////////////////////////////////
+//
+// CylinderShape implementation
+// =============
+CylinderShape::CylinderShape(const vec3& aCenter,
+  REAL aRadius,
+  const vec3& normal,
+  REAL aHeight):
+  center(aCenter),
+  radius(aRadius),
+  axis(-normal.versor()),
+  height(aHeight)
+//[]---------------------------------------------------[]
+//|  Constructor                                        |
+//[]---------------------------------------------------[]
+{
+  // Extent of the caps along each axis
+  vec3 e;
+
+  for (int a = 0; a < 3; a++)
+    e[a] = radius * (REAL)sqrt(dMax<REAL>(0, 1 - axis[a] * axis[a]));
+
+  vec3 c = center + axis * height;
+
+  bounds.inflate(center - e);
+  bounds.inflate(center + e);
+  bounds.inflate(c - e);
+  bounds.inflate(c + e);
+}
+
+Object*
+CylinderShape::clone() const
+//[]---------------------------------------------------[]
+//|  Make copy                                          |
+//[]---------------------------------------------------[]
+{
+  return new CylinderShape(center, radius, -axis, height);
+}
+
+bool
+CylinderShape::intersect(const Ray& ray, Intersection& hit) const
+//[]---------------------------------------------------[]
+//|  Closest intersection                               |
+//|                                                     |
+//|  The side is intersected as the circle given by the |
+//|  components of the ray orthogonal to the axis; each |
+//|  cap, as a plane.                                   |
+//[]---------------------------------------------------[]
+{
+  vec3 o = ray.origin - center;
+  const vec3& d = ray.direction;
+  REAL oz = o.dot(axis);
+  REAL dz = d.dot(axis);
+  vec3 op = o - axis * oz;
+  vec3 dp = d - axis * dz;
+  REAL t = ray.tMax;
+  vec3 N;
+  REAL t1;
+  REAL t2;
+
+  if (intersectCircle(op, dp, radius, t1, t2))
+    for (int i = 0; i < 2; i++, t1 = t2)
+    {
+      REAL z = oz + t1 * dz;
+
+      if (t1 > ray.tMin && t1 < t && z >= 0 && z <= height)
+      {
+        t = t1;
+        N = (op + dp * t1) * Math::inverse<REAL>(radius);
+        break;
+      }
+    }
+  if (!Math::isZero<REAL>(dz))
+    for (int i = 0; i < 2; i++)
+    {
+      REAL s = (i * height - oz) / dz;
+
+      if (s > ray.tMin && s < t)
+      {
+        vec3 q = op + dp * s;
+
+        if (q.dot(q) <= radius * radius)
+        {
+          t = s;
+          N = i == 0 ? -axis : axis;
+        }
+      }
+    }
+  if (t >= ray.tMax)
+    return false;
+  hit.distance = t;
+  hit.p = ray(t);
+  hit.normal = N;
+  return true;
+}
+
+TriangleMesh*
+CylinderShape::tessellate() const
+//[]---------------------------------------------------[]
+//|  Tessellate                                         |
+//[]---------------------------------------------------[]
+{
+  return MeshSweeper::makeCylinder(center, radius, -axis, height);
+}
@@ -0,0 +1,228 @@
+//[]------------------------------------------------------------------------[]
+//|                                                                          |
+//|                          GVSG Graphics Library                           |
+//|                               Version 1.0                                |
+//|                                                                          |
+//|              Copyright 2007-2014, Paulo Aristarco Pagliosa              |
+//|              All Rights Reserved.                                        |
+//|                                                                          |
+//[]------------------------------------------------------------------------[]
+//
+//  OVERVIEW: BVH.cpp
+//  ========
+//  Source file for bounding volume hierarchy and BVH builder.
+
+#include <algorithm>
+#include "BVH.h"
+
+using namespace Graphics;
+
+//
+// Auxiliary function
+//
+inline void
+sortReferences(BVHBuilder::Reference* refs, int n, int axis)
+{
+  std::sort(refs, refs + n,
+    [axis](const BVHBuilder::Reference& a, const BVHBuilder::Reference& b)
+    {
+      return a.centroid[axis] < b.centroid[axis];
+    });
+}
+
+
+//////////////////////////////////////////////////////////
+//
+// BVH implementation
+// ===
+BVH::~BVH()
+//[]---------------------------------------------------[]
+//|  Destructor                                         |
+//[]---------------------------------------------------[]
+{
+  delete []nodes;
+  delete []primitiveIds;
+}
+
+REAL
+BVH::computeCost() const
+//[]---------------------------------------------------[]
+//|  SAH cost                                           |
+//[]---------------------------------------------------[]
+{
+  if (numberOfNodes == 0)
+    return 0;
+
+  REAL c = 0;
+
+  for (int i = 0; i < numberOfNodes; i++)
+  {
+    const Node& node = nodes[i];
+    REAL a = node.bounds.area();
+
+    c += node.isLeaf() ? SAH_INTERSECTION_COST * node.count * a :
+      SAH_TRAVERSAL_COST * a;
+  }
+
+  REAL area = nodes[0].bounds.area();
+
+  return area > 0 ? c / area : 0;
+}
+
+
+//////////////////////////////////////////////////////////
+//
+// BVHBuilder implementation
+// ==========
+int
+BVHBuilder::compact(BVH::Node* dst, const BVH::Node* src, int i, int& count)
+//[]---------------------------------------------------[]
+//|  Compact                                            |
+//|                                                     |
+//|  Builders that reserve the 2n - 1 slots following a |
+//|  node for its subtree leave gaps in the node array; |
+//|  the copy has the first child of an interior node   |
+//|  immediately after it.                              |
+//[]---------------------------------------------------[]
+{
+  int j = count++;
+
+  dst[j] = src[i];
+  if (!src[i].isLeaf())
+  {
+    compact(dst, src, i + 1, count);
+    dst[j].index = compact(dst, src, src[i].index, count);
+  }
+  return j;
+}
+
+
+//////////////////////////////////////////////////////////
+//
+// SAHBuilder implementation
+// ==========
+void
+SAHBuilder::execute(BVH& bvh, Reference* refs, int n)
+//[]---------------------------------------------------[]
+//|  Build                                              |
+//[]---------------------------------------------------[]
+{
+  this->nodes = nodesOf(bvh) = new BVH::Node[2 * n - 1];
+  this->primitiveIds = primitiveIdsOf(bvh) = new int[n];
+  this->refs = refs;
+  this->areas = new REAL[n];
+  numberOfNodes = 0;
+  buildNode(0, n, 0);
+  numberOfNodesOf(bvh) = numberOfNodes;
+  delete []areas;
+}
+
+int
+SAHBuilder::makeLeaf(const Bounds3& bounds, int begin, int end)
+//[]---------------------------------------------------[]
+//|  Make leaf                                          |
+//[]---------------------------------------------------[]
+{
+  int i = numberOfNodes++;
+  BVH::Node& node = nodes[i];
+
+  node.bounds = bounds;
+  node.index = begin;
+  node.count = uint16(end - begin);
+  node.axis = 0;
+  for (int k = begin; k < end; k++)
+    primitiveIds[k] = refs[k].index;
+  return i;
+}
+
+int
+SAHBuilder::buildNode(int begin, int end, int depth)
+//[]---------------------------------------------------[]
+//|  Build node for references [begin, end)             |
+//|                                                     |
+//|  For each axis, the references are sorted by their  |
+//|  centroids and all the n - 1 splits are evaluated   |
+//|  with the surface area heuristic.                   |
+//[]---------------------------------------------------[]
+{
+  Bounds3 bounds;
+  Bounds3 cb;
+
+  for (int i = begin; i < end; i++)
+  {
+    bounds.inflate(refs[i].bounds);
+    cb.inflate(refs[i].centroid);
+  }
+
+  int n = end - begin;
+
+  if (n == 1)
+    return makeLeaf(bounds, begin, end);
+
+  REAL bestCost = FloatInfo<REAL>::inf();
+  int bestAxis = -1;
+  int bestSplit = 0;
+  int sortedAxis = -1;
+  vec3 extent = cb.size();
+
+  for (int axis = 0; axis < 3; axis++)
+  {
+    if (extent[axis] <= 0)
+      continue;
+    sortReferences(refs + begin, n, sortedAxis = axis);
+
+    Bounds3 b;
+
+    for (int i = end - 1; i > begin; i--)
+    {
+      b.inflate(refs[i].bounds);
+      areas[i] = b.area();
+    }
+    b.setEmpty();
+    for (int i = begin + 1; i < end; i++)
+    {
+      b.inflate(refs[i - 1].bounds);
+
+      REAL cost = b.area() * (i - begin) + areas[i] * (end - i);
+
+      if (cost < bestCost)
+      {
+        bestCost = cost;
+        bestAxis = axis;
+        bestSplit = i;
+      }
+    }
+  }
+  if (bestAxis < 0)
+  {
+    // All centroids are coincident
+    if (n <= BVH_MAX_LEAF_SIZE)
+      return makeLeaf(bounds, begin, end);
+    bestAxis = 0;
+    bestSplit = begin + n / 2;
+  }
+  else
+  {
+    REAL area = bounds.area();
+    REAL leafCost = SAH_INTERSECTION_COST * n;
+
+    bestCost = area > 0 ?
+      SAH_TRAVERSAL_COST + SAH_INTERSECTION_COST * bestCost / area :
+      SAH_TRAVERSAL_COST + leafCost * (REAL)0.5;
+    if (n <= maxPrimitivesInNode && leafCost <= bestCost)
+      return makeLeaf(bounds, begin, end);
+    if (depth >= BVH_MAX_DEPTH - 1 && n <= BVH_MAX_LEAF_SIZE)
+      return makeLeaf(bounds, begin, end);
+    if (bestAxis != sortedAxis)
+      sortReferences(refs + begin, n, bestAxis);
+  }
+
+  int i = numberOfNodes++;
+
+  nodes[i].bounds = bounds;
+  nodes[i].count = 0;
+  nodes[i].axis = uint16(bestAxis);
+  buildNode(begin, bestSplit, depth + 1);
+  nodes[i].index = buildNode(bestSplit, end, depth + 1);
+  return i;
+}
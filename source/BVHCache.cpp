@@ -0,0 +1,252 @@
+//[]------------------------------------------------------------------------[]
+//|                                                                          |
+//|                          GVSG Graphics Library                           |
+//|                               Version 1.0                                |
+//|                                                                          |
+//|              Copyright 2007-2014, Paulo Aristarco Pagliosa              |
+//|              All Rights Reserved.                                        |
+//|                                                                          |
+//[]------------------------------------------------------------------------[]
+//
+//  OVERVIEW: BVHCache.cpp
+//  ========
+//  Source file for on-disk triangle mesh BVH cache.
+
+#include <stdio.h>
+#include <string.h>
+#include <algorithm>
+#include <vector>
+#include "BVHCache.h"
+
+using namespace Graphics;
+using namespace std;
+
+//
+// Auxiliary struct
+//
+struct BVHCacheHeader
+{
+  char magic[8];
+  uint32 version;
+  uint32 nodeSize;
+  unsigned long long key;
+  int32 numberOfNodes;
+  int32 numberOfPrimitives;
+  int32 numberOfPrimitiveIds;
+  int32 reserved[7]; // pads the header to 64 bytes
+
+}; // BVHCacheHeader
+
+static const char magic[8] = {'G', 'V', 'S', 'G', 'B', 'V', 'H', 0};
+
+//
+// Auxiliary function
+//
+static string
+cacheFileName(const string& directory, unsigned long long key)
+{
+  char name[32];
+
+  sprintf(name, "bvh-%016llx.cache", key);
+  return directory.empty() ? string(name) : directory + "/" + name;
+}
+
+//
+// Auxiliary function
+//
+static bool
+isValidTree(const BVH::Node* nodes, int numberOfNodes, int numberOfIds)
+{
+  // Children always follow their parent, so the tree has no cycles and
+  // the depths can be computed in a single forward pass
+  std::vector<int> depth(numberOfNodes, 0);
+
+  for (int i = 0; i < numberOfNodes; i++)
+  {
+    const BVH::Node& node = nodes[i];
+
+    if (depth[i] >= BVH_MAX_DEPTH)
+      return false;
+    if (node.isLeaf())
+    {
+      if (node.index < 0 || node.index > numberOfIds - node.count)
+        return false;
+      continue;
+    }
+    if (node.axis > 2 || i + 1 >= numberOfNodes ||
+      node.index <= i + 1 || node.index >= numberOfNodes)
+      return false;
+    depth[i + 1] = std::max(depth[i + 1], depth[i] + 1);
+    depth[node.index] = std::max(depth[node.index], depth[i] + 1);
+  }
+  return true;
+}
+
+//////////////////////////////////////////////////////////
+//
+// BVHCache implementation
+// ========
+unsigned long long
+BVHCache::getKey() const
+//[]---------------------------------------------------[]
+//|  Key                                                |
+//[]---------------------------------------------------[]
+{
+  Hash hash;
+
+  hash.add(BVH_CACHE_VERSION);
+  hash.add(data.numberOfVertices).add(data.numberOfTriangles);
+  hash.add(data.vertices, data.numberOfVertices * sizeof(vec3));
+  hash.add(data.triangles,
+    data.numberOfTriangles * sizeof(TriangleMesh::Triangle));
+  builder.hashSettings(hash);
+  return hash.getValue();
+}
+
+string
+BVHCache::getFileName() const
+//[]---------------------------------------------------[]
+//|  File name                                          |
+//[]---------------------------------------------------[]
+{
+  return cacheFileName(directory, getKey());
+}
+
+void
+BVHCache::execute(BVH& bvh, Reference* refs, int n)
+//[]---------------------------------------------------[]
+//|  Build                                              |
+//[]---------------------------------------------------[]
+{
+  unsigned long long key = getKey();
+  string fileName = cacheFileName(directory, key);
+
+  hit = load(bvh, n, key, fileName);
+  if (hit)
+    return;
+  builder.build(bvh, refs, n);
+  save(bvh, key, fileName);
+}
+
+bool
+BVHCache::load(BVH& bvh,
+  int n,
+  unsigned long long key,
+  const string& fileName) const
+//[]---------------------------------------------------[]
+//|  Load tree from the cache                           |
+//[]---------------------------------------------------[]
+{
+  FILE* f = fopen(fileName.c_str(), "rb");
+
+  if (f == 0)
+    return false;
+
+  BVHCacheHeader header;
+  long fileSize = -1;
+
+  if (fseek(f, 0, SEEK_END) == 0)
+    fileSize = ftell(f);
+  rewind(f);
+
+  bool valid = fileSize >= long(sizeof(BVHCacheHeader)) &&
+    fread(&header, sizeof(BVHCacheHeader), 1, f) == 1 &&
+    memcmp(header.magic, magic, sizeof(magic)) == 0 &&
+    header.version == BVH_CACHE_VERSION &&
+    header.nodeSize == sizeof(BVH::Node) &&
+    header.key == key &&
+    header.numberOfPrimitives == n &&
+    header.numberOfNodes > 0 &&
+    header.numberOfPrimitiveIds >= n &&
+    size_t(fileSize) == sizeof(BVHCacheHeader) +
+      header.numberOfNodes * sizeof(BVH::Node) +
+      header.numberOfPrimitiveIds * sizeof(int);
+
+  BVH::Node* nodes = 0;
+  int* ids = 0;
+
+  if (valid)
+  {
+    nodes = new BVH::Node[header.numberOfNodes];
+    ids = new int[header.numberOfPrimitiveIds];
+
+    size_t nodesRead =
+      fread((void*)nodes, sizeof(BVH::Node), header.numberOfNodes, f);
+    size_t idsRead =
+      fread(ids, sizeof(int), header.numberOfPrimitiveIds, f);
+
+    valid = nodesRead == size_t(header.numberOfNodes) &&
+      idsRead == size_t(header.numberOfPrimitiveIds);
+  }
+  fclose(f);
+
+  // Reject files whose indices are out of range
+  valid = valid && isValidTree(nodes,
+    header.numberOfNodes,
+    header.numberOfPrimitiveIds);
+
+  for (int i = 0; valid && i < header.numberOfPrimitiveIds; i++)
+    valid = ids[i] >= 0 && ids[i] < n;
+  if (!valid)
+  {
+    delete []nodes;
+    delete []ids;
+    return false;
+  }
+  nodesOf(bvh) = nodes;
+  numberOfNodesOf(bvh) = header.numberOfNodes;
+  primitiveIdsOf(bvh) = ids;
+  numberOfPrimitiveIdsOf(bvh) = header.numberOfPrimitiveIds;
+  return true;
+}
+
+bool
+BVHCache::save(const BVH& bvh,
+  unsigned long long key,
+  const string& fileName) const
+//[]---------------------------------------------------[]
+//|  Save tree to the cache                             |
+//|                                                     |
+//|  The tree is written to a temporary file, renamed   |
+//|  when complete, so that a cache file is never seen  |
+//|  partially written.                                 |
+//[]---------------------------------------------------[]
+{
+  BVHCacheHeader header;
+
+  memset(&header, 0, sizeof(BVHCacheHeader));
+  memcpy(header.magic, magic, sizeof(magic));
+  header.version = BVH_CACHE_VERSION;
+  header.nodeSize = sizeof(BVH::Node);
+  header.key = key;
+  header.numberOfNodes = bvh.getNumberOfNodes();
+  header.numberOfPrimitives = bvh.getNumberOfPrimitives();
+  header.numberOfPrimitiveIds = bvh.getNumberOfPrimitiveIds();
+
+  string tempName = fileName + ".tmp";
+  FILE* f = fopen(tempName.c_str(), "wb");
+
+  if (f == 0)
+    return false;
+
+  bool ok = fwrite(&header, sizeof(BVHCacheHeader), 1, f) == 1 &&
+    fwrite(bvh.getNodes(),
+      sizeof(BVH::Node),
+      header.numberOfNodes,
+      f) == size_t(header.numberOfNodes) &&
+    fwrite(bvh.getPrimitiveIds(),
+      sizeof(int),
+      header.numberOfPrimitiveIds,
+      f) == size_t(header.numberOfPrimitiveIds);
+
+  ok = fclose(f) == 0 && ok;
+  if (ok)
+  {
+    // rename() does not replace an existing file on Windows
+    remove(fileName.c_str());
+    ok = rename(tempName.c_str(), fileName.c_str()) == 0;
+  }
+  if (!ok)
+    remove(tempName.c_str());
+  return ok;
+}
@@ -0,0 +1,358 @@
+//[]------------------------------------------------------------------------[]
+//|                                                                          |
+//|                          GVSG Graphics Library                           |
+//|                               Version 1.0                                |
+//|                                                                          |
+//|              Copyright 2007-2014, Paulo Aristarco Pagliosa              |
+//|              All Rights Reserved.                                        |
+//|                                                                          |
+//[]------------------------------------------------------------------------[]
+//
+//  OVERVIEW: BinnedSAHBuilder.cpp
+//  ========
+//  Source file for binned, parallel SAH BVH builder.
+
+#include <algorithm>
+#include "BinnedSAHBuilder.h"
+#include "ThreadPool.h"
+
+using namespace Graphics;
+
+#define MIN_PARALLEL_BINNING 16384
+
+//
+// Auxiliary class
+//
+class BinMapping
+{
+public:
+  // Constructor
+  BinMapping(const Bounds3& cb, int aBins):
+    origin(cb.getMin()),
+    bins(aBins)
+  {
+    vec3 s = cb.size();
+
+    for (int i = 0; i < 3; i++)
+      k[i] = s[i] > 0 ? bins * (1 - (REAL)1e-6) / s[i] : 0;
+  }
+
+  int operator ()(const vec3& c, int axis) const
+  {
+    int b = int(k[axis] * (c[axis] - origin[axis]));
+    return b < 0 ? 0 : b >= bins ? bins - 1 : b;
+  }
+
+private:
+  vec3 origin;
+  vec3 k;
+  int bins;
+
+}; // BinMapping
+
+
+//////////////////////////////////////////////////////////
+//
+// BinnedSAHBuilder implementation
+// ================
+void
+BinnedSAHBuilder::Bins::clear(int n)
+{
+  for (int axis = 0; axis < 3; axis++)
+    for (int i = 0; i < n; i++)
+    {
+      bins[axis][i].bounds.setEmpty();
+      bins[axis][i].centroidBounds.setEmpty();
+      bins[axis][i].count = 0;
+    }
+}
+
+void
+BinnedSAHBuilder::Bins::add(const Bins& other, int n)
+{
+  for (int axis = 0; axis < 3; axis++)
+    for (int i = 0; i < n; i++)
+    {
+      Bin& bin = bins[axis][i];
+      const Bin& b = other.bins[axis][i];
+
+      if (b.count == 0)
+        continue;
+      bin.bounds.inflate(b.bounds);
+      bin.centroidBounds.inflate(b.centroidBounds);
+      bin.count += b.count;
+    }
+}
+
+void
+BinnedSAHBuilder::binReferences(Bins& b,
+  int begin,
+  int end,
+  const Bounds3& cb) const
+//[]---------------------------------------------------[]
+//|  Bin references [begin, end)                        |
+//[]---------------------------------------------------[]
+{
+  BinMapping map(cb, bins);
+
+  b.clear(bins);
+  for (int i = begin; i < end; i++)
+  {
+    const Reference& r = refs[i];
+
+    for (int axis = 0; axis < 3; axis++)
+    {
+      Bin& bin = b.bins[axis][map(r.centroid, axis)];
+
+      bin.bounds.inflate(r.bounds);
+      bin.centroidBounds.inflate(r.centroid);
+      bin.count++;
+    }
+  }
+}
+
+void
+BinnedSAHBuilder::execute(BVH& bvh, Reference* refs, int n)
+//[]---------------------------------------------------[]
+//|  Build                                              |
+//|                                                     |
+//|  A node built from n references owns the range of   |
+//|  2n - 1 nodes following it, so subtrees can be      |
+//|  built concurrently; the nodes are compacted in     |
+//|  depth-first order at the end.                      |
+//[]---------------------------------------------------[]
+{
+  this->nodes = new BVH::Node[2 * n - 1];
+  this->primitiveIds = primitiveIdsOf(bvh) = new int[n];
+  this->refs = refs;
+  bins = dMin<int>(dMax<int>(numberOfBins, 2), BVH_MAX_BINS);
+  numberOfNodes = 0;
+
+  int numberOfChunks = n < MIN_PARALLEL_BINNING ? 1 :
+    ThreadPool::getDefault().size();
+  Bounds3* b = new Bounds3[2 * numberOfChunks];
+
+  parallelFor(n, numberOfChunks, [this, b](int c, int begin, int end)
+  {
+    for (int i = begin; i < end; i++)
+    {
+      b[2 * c].inflate(this->refs[i].bounds);
+      b[2 * c + 1].inflate(this->refs[i].centroid);
+    }
+  });
+  for (int c = 1; c < numberOfChunks; c++)
+  {
+    b[0].inflate(b[2 * c]);
+    b[1].inflate(b[2 * c + 1]);
+  }
+  buildNode(0, 0, n, b[0], b[1], 0);
+  delete []b;
+
+  BVH::Node* compacted = nodesOf(bvh) = new BVH::Node[numberOfNodes];
+  int count = 0;
+
+  compact(compacted, nodes, 0, count);
+  numberOfNodesOf(bvh) = count;
+  delete []nodes;
+}
+
+void
+BinnedSAHBuilder::makeLeaf(int i,
+  const Bounds3& bounds,
+  int begin,
+  int end)
+//[]---------------------------------------------------[]
+//|  Make leaf                                          |
+//[]---------------------------------------------------[]
+{
+  BVH::Node& node = nodes[i];
+
+  node.bounds = bounds;
+  node.index = begin;
+  node.count = uint16(end - begin);
+  node.axis = 0;
+  for (int k = begin; k < end; k++)
+    primitiveIds[k] = refs[k].index;
+  numberOfNodes++;
+}
+
+void
+BinnedSAHBuilder::buildNode(int i,
+  int begin,
+  int end,
+  const Bounds3& bounds,
+  const Bounds3& cb,
+  int depth)
+//[]---------------------------------------------------[]
+//|  Build node i for references [begin, end)           |
+//[]---------------------------------------------------[]
+{
+  int n = end - begin;
+
+  if (n == 1)
+  {
+    makeLeaf(i, bounds, begin, end);
+    return;
+  }
+
+  Bins b;
+
+  if (n < MIN_PARALLEL_BINNING)
+    binReferences(b, begin, end, cb);
+  else
+  {
+    int numberOfChunks = ThreadPool::getDefault().size();
+    Bins* chunks = new Bins[numberOfChunks];
+
+    parallelFor(n, numberOfChunks,
+      [this, chunks, begin, &cb](int c, int first, int last)
+    {
+      binReferences(chunks[c], begin + first, begin + last, cb);
+    });
+    b = chunks[0];
+    for (int c = 1; c < numberOfChunks; c++)
+      b.add(chunks[c], bins);
+    delete []chunks;
+  }
+
+  REAL bestCost = FloatInfo<REAL>::inf();
+  int bestAxis = -1;
+  int bestSplit = 0;
+  vec3 extent = cb.size();
+  REAL rightCost[BVH_MAX_BINS];
+
+  for (int axis = 0; axis < 3; axis++)
+  {
+    if (extent[axis] <= 0)
+      continue;
+
+    const Bin* bin = b.bins[axis];
+    Bounds3 box;
+    int count = 0;
+
+    for (int k = bins - 1; k > 0; k--)
+    {
+      if (bin[k].count != 0)
+      {
+        box.inflate(bin[k].bounds);
+        count += bin[k].count;
+      }
+      rightCost[k] = count != 0 ? box.area() * count : 0;
+    }
+    box.setEmpty();
+    count = 0;
+    for (int k = 1; k < bins; k++)
+    {
+      if (bin[k - 1].count == 0)
+        continue;
+      box.inflate(bin[k - 1].bounds);
+      count += bin[k - 1].count;
+      if (count == n)
+        continue;
+
+      REAL cost = box.area() * count + rightCost[k];
+
+      if (cost < bestCost)
+      {
+        bestCost = cost;
+        bestAxis = axis;
+        bestSplit = k;
+      }
+    }
+  }
+
+  REAL area = bounds.area();
+  REAL leafCost = SAH_INTERSECTION_COST * n;
+
+  if (bestAxis >= 0)
+    bestCost = area > 0 ?
+      SAH_TRAVERSAL_COST + SAH_INTERSECTION_COST * bestCost / area :
+      SAH_TRAVERSAL_COST + leafCost * (REAL)0.5;
+  if (n <= BVH_MAX_LEAF_SIZE)
+    if ((n <= maxPrimitivesInNode && leafCost <= bestCost) ||
+      bestAxis < 0 ||
+      depth >= BVH_MAX_DEPTH - 1)
+    {
+      makeLeaf(i, bounds, begin, end);
+      return;
+    }
+
+  Bounds3 lb;
+  Bounds3 lcb;
+  Bounds3 rb;
+  Bounds3 rcb;
+  int mid;
+
+  if (bestAxis >= 0)
+  {
+    BinMapping map(cb, bins);
+    int axis = bestAxis;
+    int split = bestSplit;
+
+    mid = int(std::partition(refs + begin, refs + end,
+      [&map, axis, split](const Reference& r)
+      {
+        return map(r.centroid, axis) < split;
+      }) - refs);
+    for (int k = 0; k < bins; k++)
+    {
+      const Bin& bin = b.bins[axis][k];
+
+      if (bin.count == 0)
+        continue;
+      if (k < split)
+      {
+        lb.inflate(bin.bounds);
+        lcb.inflate(bin.centroidBounds);
+      }
+      else
+      {
+        rb.inflate(bin.bounds);
+        rcb.inflate(bin.centroidBounds);
+      }
+    }
+  }
+  else
+  {
+    // Too many references with coincident centroids
+    bestAxis = 0;
+    mid = begin + n / 2;
+    for (int k = begin; k < end; k++)
+      if (k < mid)
+      {
+        lb.inflate(refs[k].bounds);
+        lcb.inflate(refs[k].centroid);
+      }
+      else
+      {
+        rb.inflate(refs[k].bounds);
+        rcb.inflate(refs[k].centroid);
+      }
+  }
+
+  BVH::Node& node = nodes[i];
+  int left = i + 1;
+  int right = i + 2 * (mid - begin);
+
+  node.bounds = bounds;
+  node.index = right;
+  node.count = 0;
+  node.axis = uint16(bestAxis);
+  numberOfNodes++;
+  if (mid - begin < taskThreshold || end - mid < taskThreshold)
+  {
+    buildNode(left, begin, mid, lb, lcb, depth + 1);
+    buildNode(right, mid, end, rb, rcb, depth + 1);
+  }
+  else
+  {
+    TaskGroup group;
+
+    group.run([=]()
+    {
+      buildNode(left, begin, mid, lb, lcb, depth + 1);
+    });
+    buildNode(right, mid, end, rb, rcb, depth + 1);
+    group.wait();
+  }
+}
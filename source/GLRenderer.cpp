@@ -12,6 +12,7 @@
 //  ========
 //  Source file for GL renderer.
 
+#include <string.h>
 #include "GLRenderer.h"
 
 using namespace Graphics;
@@ -57,6 +58,26 @@ const char* fragmentShader =
   "  fragmentColor = color;\n"
   "}";
 
+// The vertices of the full-screen triangle are generated from their
+// ids: (-1, -1), (3, -1) and (-1, 3), with texture coordinates in
+// [0, 2], which cover the viewport with [0, 1]
+const char* imageVertexShader =
+  "#version 400\n"
+  "out vec2 uv;\n"
+  "void main() {\n"
+  "  uv = vec2((gl_VertexID << 1) & 2, gl_VertexID & 2);\n"
+  "  gl_Position = vec4(uv * 2 - 1, 0, 1);\n"
+  "}";
+
+const char* imageFragmentShader =
+  "#version 400\n"
+  "in vec2 uv;\n"
+  "uniform sampler2D image;\n"
+  "out vec4 fragmentColor;\n"
+  "void main() {\n"
+  "  fragmentColor = vec4(texture(image, uv).rgb, 1);\n"
+  "}";
+
 
 //////////////////////////////////////////////////////////
 //
@@ -164,6 +185,8 @@ void
 GLRenderer::update()
 {
   Renderer::update();
+  // Another program may have been used since the last render
+  program.use();
   vpMatrix = getVpMatrix(camera);
   program.setUniform(vpMatrixLoc, vpMatrix);
   program.setUniform(ambientLightLoc, scene->ambientLight);
@@ -314,3 +337,85 @@ GLRenderer::drawLine(const vec3& p1, const vec3& p2) const
   glVertex3f((float)p2.x, (float)p2.y, (float)p2.z);
   glEnd();
 }
+
+
+//////////////////////////////////////////////////////////
+//
+// GLImagePresenter implementation
+// ================
+GLImagePresenter::GLImagePresenter():
+  program("image presenter program"),
+  pixelBuffer(0),
+  width(0),
+  height(0),
+  pixelType(GL_NONE)
+{
+  program.addShader(GL_VERTEX_SHADER, GLSL::STRING, imageVertexShader);
+  program.addShader(GL_FRAGMENT_SHADER, GLSL::STRING, imageFragmentShader);
+  glGenVertexArrays(1, &vao);
+  glGenTextures(1, &texture);
+  glBindTexture(GL_TEXTURE_2D, texture);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+  glGenBuffers(2, pixelBuffers);
+}
+
+GLImagePresenter::~GLImagePresenter()
+{
+  glDeleteBuffers(2, pixelBuffers);
+  glDeleteTextures(1, &texture);
+  glDeleteVertexArrays(1, &vao);
+}
+
+void
+GLImagePresenter::draw(const Color* pixels, int w, int h)
+{
+  draw(pixels, w, h, GL_FLOAT);
+}
+
+void
+GLImagePresenter::draw(const uint8* pixels, int w, int h)
+{
+  draw(pixels, w, h, GL_UNSIGNED_BYTE);
+}
+
+void
+GLImagePresenter::draw(const void* pixels, int w, int h, GLenum type)
+{
+  if (pixels == 0 || w <= 0 || h <= 0)
+    return;
+  glActiveTexture(GL_TEXTURE0);
+  glBindTexture(GL_TEXTURE_2D, texture);
+  if (w != width || h != height || type != pixelType)
+  {
+    GLint format = type == GL_FLOAT ? GL_RGBA32F : GL_RGBA8;
+
+    glTexImage2D(GL_TEXTURE_2D, 0, format, w, h, 0, GL_RGBA, type, 0);
+    width = w;
+    height = h;
+    pixelType = type;
+  }
+
+  GLsizeiptr size = GLsizeiptr(w) * h * (type == GL_FLOAT ? 16 : 4);
+
+  pixelBuffer ^= 1;
+  glBindBuffer(GL_PIXEL_UNPACK_BUFFER, pixelBuffers[pixelBuffer]);
+  // Orphan the storage of the buffer, so that mapping it does not
+  // wait for a pending transfer
+  glBufferData(GL_PIXEL_UNPACK_BUFFER, size, 0, GL_STREAM_DRAW);
+  if (char* p = mapBuffer<char>(GL_PIXEL_UNPACK_BUFFER, GL_WRITE_ONLY))
+  {
+    memcpy(p, pixels, size);
+    unmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+    glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, w, h, GL_RGBA, type, 0);
+  }
+  glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+  program.use();
+  glDisable(GL_DEPTH_TEST);
+  glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
+  glBindVertexArray(vao);
+  glDrawArrays(GL_TRIANGLES, 0, 3);
+}
@@ -0,0 +1,321 @@
+//[]------------------------------------------------------------------------[]
+//|                                                                          |
+//|                          GVSG Graphics Library                           |
+//|                               Version 1.0                                |
+//|                                                                          |
+//|              Copyright 2007-2014, Paulo Aristarco Pagliosa              |
+//|              All Rights Reserved.                                        |
+//|                                                                          |
+//[]------------------------------------------------------------------------[]
+//
+//  OVERVIEW: LBVHBuilder.cpp
+//  ========
+//  Source file for linear BVH builder.
+
+#include <atomic>
+#include "LBVHBuilder.h"
+#include "Morton.h"
+
+using namespace Graphics;
+
+#define MIN_PARALLEL_SORT 16384
+
+//
+// Auxiliary function
+//
+inline int
+numberOfChunks(int n)
+{
+  return n < MIN_PARALLEL_SORT ? 1 : ThreadPool::getDefault().size();
+}
+
+
+//////////////////////////////////////////////////////////
+//
+// LBVH: linear BVH emitter class
+// ====
+template <typename Code>
+class LBVH
+{
+public:
+  struct MortonReference
+  {
+    Code code;
+    int index; // reference index
+
+  }; // MortonReference
+
+  // Constructor
+  LBVH(const BVHBuilder::Reference* refs,
+    int n,
+    int maxPrimitives,
+    int taskThreshold);
+
+  // Destructor
+  ~LBVH()
+  {
+    delete []sorted;
+  }
+
+  // Emit the nodes of the tree (with gaps; see BVHBuilder::compact)
+  int emit(BVH::Node*, int*);
+
+private:
+  enum
+  {
+    bitsPerAxis = sizeof(Code) == 4 ? 10 : 21,
+    codeBits = 3 * bitsPerAxis
+  };
+
+  const BVHBuilder::Reference* refs;
+  int n;
+  int maxPrimitives;
+  int taskThreshold;
+  MortonReference* sorted;
+  BVH::Node* nodes;
+  int* primitiveIds;
+  std::atomic<int> numberOfNodes;
+
+  void computeCodes();
+  void sort();
+  Bounds3 emitNode(int, int, int, int, int);
+  Bounds3 makeLeaf(int, int, int);
+
+  LBVH(const LBVH&);
+  LBVH& operator =(const LBVH&);
+
+}; // LBVH
+
+
+//////////////////////////////////////////////////////////
+//
+// LBVH implementation
+// ====
+template <typename Code>
+LBVH<Code>::LBVH(const BVHBuilder::Reference* refs,
+  int n,
+  int maxPrimitives,
+  int taskThreshold):
+  refs(refs),
+  n(n),
+  maxPrimitives(maxPrimitives),
+  taskThreshold(taskThreshold),
+  sorted(new MortonReference[n])
+//[]---------------------------------------------------[]
+//|  Constructor                                        |
+//[]---------------------------------------------------[]
+{
+  computeCodes();
+  sort();
+}
+
+template <typename Code>
+void
+LBVH<Code>::computeCodes()
+//[]---------------------------------------------------[]
+//|  Compute Morton codes                               |
+//[]---------------------------------------------------[]
+{
+  int chunks = numberOfChunks(n);
+  Bounds3* cbs = new Bounds3[chunks];
+
+  parallelFor(n, chunks, [this, cbs](int c, int begin, int end)
+  {
+    for (int i = begin; i < end; i++)
+      cbs[c].inflate(refs[i].centroid);
+  });
+  for (int c = 1; c < chunks; c++)
+    cbs[0].inflate(cbs[c]);
+
+  const vec3& origin = cbs[0].getMin();
+  vec3 s = cbs[0].size();
+  vec3 k;
+
+  for (int i = 0; i < 3; i++)
+    k[i] = s[i] > 0 ? ((1 << bitsPerAxis) - 1) / s[i] : 0;
+  parallelFor(n, chunks, [this, &origin, &k](int, int begin, int end)
+  {
+    for (int i = begin; i < end; i++)
+    {
+      vec3 p = refs[i].centroid - origin;
+
+      sorted[i].code = spreadBits(Code(p.x * k.x)) |
+        (spreadBits(Code(p.y * k.y)) << 1) |
+        (spreadBits(Code(p.z * k.z)) << 2);
+      sorted[i].index = i;
+    }
+  });
+  delete []cbs;
+}
+
+template <typename Code>
+void
+LBVH<Code>::sort()
+//[]---------------------------------------------------[]
+//|  Sort references by their codes (see radixSort)     |
+//[]---------------------------------------------------[]
+{
+  MortonReference* temp = new MortonReference[n];
+  MortonReference* result = radixSort(sorted,
+    temp,
+    n,
+    0,
+    codeBits,
+    numberOfChunks(n),
+    [](const MortonReference& r)
+    {
+      return r.code;
+    });
+
+  delete [](result == sorted ? temp : sorted);
+  sorted = result;
+}
+
+template <typename Code>
+int
+LBVH<Code>::emit(BVH::Node* nodes, int* primitiveIds)
+//[]---------------------------------------------------[]
+//|  Emit                                               |
+//[]---------------------------------------------------[]
+{
+  this->nodes = nodes;
+  this->primitiveIds = primitiveIds;
+  numberOfNodes = 0;
+  emitNode(0, 0, n, codeBits - 1, 0);
+  return numberOfNodes;
+}
+
+template <typename Code>
+Bounds3
+LBVH<Code>::makeLeaf(int i, int begin, int end)
+//[]---------------------------------------------------[]
+//|  Make leaf                                          |
+//[]---------------------------------------------------[]
+{
+  BVH::Node& node = nodes[i];
+
+  node.bounds.setEmpty();
+  for (int k = begin; k < end; k++)
+  {
+    const BVHBuilder::Reference& r = refs[sorted[k].index];
+
+    node.bounds.inflate(r.bounds);
+    primitiveIds[k] = r.index;
+  }
+  node.index = begin;
+  node.count = uint16(end - begin);
+  node.axis = 0;
+  numberOfNodes++;
+  return node.bounds;
+}
+
+template <typename Code>
+Bounds3
+LBVH<Code>::emitNode(int i, int begin, int end, int bit, int depth)
+//[]---------------------------------------------------[]
+//|  Emit node i for sorted references [begin, end)     |
+//[]---------------------------------------------------[]
+{
+  int n = end - begin;
+
+  if (n <= maxPrimitives ||
+    (depth >= BVH_MAX_DEPTH - 1 && n <= BVH_MAX_LEAF_SIZE))
+    return makeLeaf(i, begin, end);
+
+  int mid = begin + n / 2;
+  int axis = 0;
+
+  // Skip the bits shared by all codes of the range
+  for (; bit >= 0; bit--)
+  {
+    Code mask = Code(1) << bit;
+
+    if ((sorted[begin].code & mask) == (sorted[end - 1].code & mask))
+      continue;
+
+    // Find the first code with the bit set
+    int lo = begin;
+    int hi = end - 1;
+
+    while (lo + 1 < hi)
+    {
+      int m = (lo + hi) >> 1;
+
+      if (sorted[m].code & mask)
+        hi = m;
+      else
+        lo = m;
+    }
+    mid = hi;
+    axis = bit % 3;
+    bit--;
+    break;
+  }
+  // If no bit differs, the codes are equal: split at the middle
+
+  int left = i + 1;
+  int right = i + 2 * (mid - begin);
+  Bounds3 lb;
+  Bounds3 rb;
+
+  if (mid - begin < taskThreshold || end - mid < taskThreshold)
+  {
+    lb = emitNode(left, begin, mid, bit, depth + 1);
+    rb = emitNode(right, mid, end, bit, depth + 1);
+  }
+  else
+  {
+    TaskGroup group;
+
+    group.run([this, &lb, left, begin, mid, bit, depth]()
+    {
+      lb = emitNode(left, begin, mid, bit, depth + 1);
+    });
+    rb = emitNode(right, mid, end, bit, depth + 1);
+    group.wait();
+  }
+
+  BVH::Node& node = nodes[i];
+
+  node.bounds = lb;
+  node.bounds.inflate(rb);
+  node.index = right;
+  node.count = 0;
+  node.axis = uint16(axis);
+  numberOfNodes++;
+  return node.bounds;
+}
+
+
+//////////////////////////////////////////////////////////
+//
+// LBVHBuilder implementation
+// ===========
+void
+LBVHBuilder::execute(BVH& bvh, Reference* refs, int n)
+//[]---------------------------------------------------[]
+//|  Build                                              |
+//[]---------------------------------------------------[]
+{
+  BVH::Node* nodes = new BVH::Node[2 * n - 1];
+  int* primitiveIds = primitiveIdsOf(bvh) = new int[n];
+  int numberOfNodes;
+
+  if (mortonBits <= 30)
+  {
+    LBVH<uint32> lbvh(refs, n, maxPrimitivesInNode, taskThreshold);
+    numberOfNodes = lbvh.emit(nodes, primitiveIds);
+  }
+  else
+  {
+    LBVH<MortonCode64> lbvh(refs, n, maxPrimitivesInNode, taskThreshold);
+    numberOfNodes = lbvh.emit(nodes, primitiveIds);
+  }
+
+  int count = 0;
+
+  nodesOf(bvh) = new BVH::Node[numberOfNodes];
+  compact(nodesOf(bvh), nodes, 0, count);
+  numberOfNodesOf(bvh) = count;
+  delete []nodes;
+}
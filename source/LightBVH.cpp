@@ -0,0 +1,347 @@
+//[]------------------------------------------------------------------------[]
+//|                                                                          |
+//|                          GVSG Graphics Library                           |
+//|                               Version 1.0                                |
+//|                                                                          |
+//|              Copyright 2007-2014, Paulo Aristarco Pagliosa              |
+//|              All Rights Reserved.                                        |
+//|                                                                          |
+//[]------------------------------------------------------------------------[]
+//
+//  OVERVIEW: LightBVH.cpp
+//  ========
+//  Source file for light BVH and light BVH builder.
+
+#include <algorithm>
+#include "LightBVH.h"
+#include "RayTracerUtil.h"
+
+using namespace Graphics;
+
+//
+// Auxiliary functions
+//
+inline int
+falloffOf(const Light* light)
+{
+  if (light->flags.isSet(Light::Squared))
+    return 2;
+  return light->flags.isSet(Light::Linear) ? 1 : 0;
+}
+
+inline void
+sortReferences(BVHBuilder::Reference* refs, int n, int axis)
+{
+  std::sort(refs, refs + n,
+    [axis](const BVHBuilder::Reference& a, const BVHBuilder::Reference& b)
+    {
+      return a.centroid[axis] < b.centroid[axis];
+    });
+}
+
+
+//////////////////////////////////////////////////////////
+//
+// LightBVH implementation
+// ========
+void
+LightBVH::build(const std::vector<Light*>& sceneLights)
+//[]---------------------------------------------------[]
+//|  Build                                              |
+//[]---------------------------------------------------[]
+{
+  lights = sceneLights;
+  infiniteLights.clear();
+
+  int n = int(lights.size());
+  std::vector<BVHBuilder::Reference> refs;
+  std::vector<float> weights(n);
+
+  refs.reserve(n);
+  for (int i = 0; i < n; i++)
+  {
+    const Light* light = lights[i];
+
+    if (light->isDirectional())
+    {
+      infiniteLights.push_back(i);
+      continue;
+    }
+
+    BVHBuilder::Reference ref;
+    vec3 r(light->radius, light->radius, light->radius);
+
+    ref.bounds.set(light->position - r, light->position + r);
+    ref.centroid = light->position;
+    ref.index = i;
+    refs.push_back(ref);
+    weights[i] = luminance(light->color);
+  }
+
+  LightBVHBuilder builder(weights.data());
+
+  builder.build(*this, refs.data(), int(refs.size()));
+  powers.resize(numberOfNodes);
+  trails.assign(n, 0);
+  if (numberOfNodes != 0)
+    computePowers(0, 0, 0);
+}
+
+void
+LightBVH::computePowers(int i, int depth, unsigned long long trail)
+//[]---------------------------------------------------[]
+//|  Compute the powers of the subtree rooted at node i |
+//|  and the trails of its lights                       |
+//[]---------------------------------------------------[]
+{
+  const Node& node = nodes[i];
+  Power& power = powers[i];
+
+  if (node.isLeaf())
+  {
+    const Light* light = lights[primitiveIds[node.index]];
+
+    power.p[0] = power.p[1] = power.p[2] = 0;
+    power.p[falloffOf(light)] = luminance(light->color);
+    trails[primitiveIds[node.index]] = trail;
+    return;
+  }
+  computePowers(i + 1, depth + 1, trail);
+  computePowers(node.index, depth + 1, trail | 1ULL << depth);
+  for (int k = 0; k < 3; k++)
+    power.p[k] = powers[i + 1].p[k] + powers[node.index].p[k];
+}
+
+REAL
+LightBVH::importance(int i, const vec3& P, const vec3& N) const
+//[]---------------------------------------------------[]
+//|  Importance of node i to point P with normal N      |
+//[]---------------------------------------------------[]
+{
+  const Bounds3& bounds = nodes[i].bounds;
+  const float* p = powers[i].p;
+  vec3 D = bounds.center() - P;
+  REAL d = D.length();
+  REAL r = bounds.diagonalLength() * (REAL)0.5;
+  REAL cosTheta = 1;
+
+  if (d > r)
+  {
+    // Cosine of the angle between N and the bounding sphere
+    REAL c = N.dot(D) / d;
+    REAL sinB = r / d;
+    REAL cosB = (REAL)sqrt(1 - sinB * sinB);
+
+    if (c < cosB)
+    {
+      REAL s = (REAL)sqrt(dMax<REAL>(0, 1 - c * c));
+
+      if ((cosTheta = c * cosB + s * sinB) <= 0)
+        return 0;
+    }
+  }
+  else
+    d = r;
+  if (d <= 0)
+    return cosTheta * (p[0] + p[1] + p[2]);
+  return cosTheta * (p[0] + (p[1] + p[2] / d) / d);
+}
+
+inline REAL
+LightBVH::infiniteProbability() const
+{
+  int n = int(infiniteLights.size());
+
+  return REAL(n) / (n + (numberOfNodes != 0));
+}
+
+int
+LightBVH::sample(const vec3& P, const vec3& N, REAL u, REAL& pmf) const
+//[]---------------------------------------------------[]
+//|  Sample light                                       |
+//[]---------------------------------------------------[]
+{
+  REAL pInfinite = infiniteProbability();
+
+  if (u < pInfinite)
+  {
+    int n = int(infiniteLights.size());
+
+    pmf = pInfinite / n;
+    return infiniteLights[dMin<int>(int(u / pInfinite * n), n - 1)];
+  }
+  pmf = 1 - pInfinite;
+  if (numberOfNodes == 0)
+    return -1;
+  u = (u - pInfinite) / pmf;
+  for (int i = 0;;)
+  {
+    const Node& node = nodes[i];
+
+    if (node.isLeaf())
+      return primitiveIds[node.index];
+
+    REAL i1 = importance(i + 1, P, N);
+    REAL i2 = importance(node.index, P, N);
+
+    if (i1 + i2 <= 0)
+      return -1;
+
+    REAL p1 = i1 / (i1 + i2);
+
+    if (u < p1)
+    {
+      u = dMin<REAL>(u / p1, 1 - FloatInfo<REAL>::eps());
+      pmf *= p1;
+      i++;
+    }
+    else
+    {
+      u = dMin<REAL>((u - p1) / (1 - p1), 1 - FloatInfo<REAL>::eps());
+      pmf *= 1 - p1;
+      i = node.index;
+    }
+  }
+}
+
+REAL
+LightBVH::pmf(const vec3& P, const vec3& N, int light) const
+//[]---------------------------------------------------[]
+//|  Probability of sampling light                      |
+//[]---------------------------------------------------[]
+{
+  REAL pInfinite = infiniteProbability();
+
+  if (lights[light]->isDirectional())
+    return pInfinite / infiniteLights.size();
+
+  REAL p = 1 - pInfinite;
+  unsigned long long trail = trails[light];
+
+  for (int i = 0;; trail >>= 1)
+  {
+    const Node& node = nodes[i];
+
+    if (node.isLeaf())
+      return p;
+
+    REAL i1 = importance(i + 1, P, N);
+    REAL i2 = importance(node.index, P, N);
+
+    if (i1 + i2 <= 0)
+      return 0;
+    if (trail & 1)
+    {
+      p *= i2 / (i1 + i2);
+      i = node.index;
+    }
+    else
+    {
+      p *= i1 / (i1 + i2);
+      i++;
+    }
+  }
+}
+
+
+//////////////////////////////////////////////////////////
+//
+// LightBVHBuilder implementation
+// ===============
+void
+LightBVHBuilder::execute(BVH& bvh, Reference* refs, int n)
+//[]---------------------------------------------------[]
+//|  Build                                              |
+//[]---------------------------------------------------[]
+{
+  this->nodes = nodesOf(bvh) = new BVH::Node[2 * n - 1];
+  this->primitiveIds = primitiveIdsOf(bvh) = new int[n];
+  this->refs = refs;
+  costs.resize(n);
+  numberOfNodes = 0;
+  buildNode(0, n, 0);
+  numberOfNodesOf(bvh) = numberOfNodes;
+}
+
+int
+LightBVHBuilder::buildNode(int begin, int end, int depth)
+//[]---------------------------------------------------[]
+//|  Build node for references [begin, end)             |
+//[]---------------------------------------------------[]
+{
+  int i = numberOfNodes++;
+  BVH::Node& node = nodes[i];
+  Bounds3 cb;
+
+  node.bounds.setEmpty();
+  for (int k = begin; k < end; k++)
+  {
+    node.bounds.inflate(refs[k].bounds);
+    cb.inflate(refs[k].centroid);
+  }
+  if (end - begin == 1)
+  {
+    node.index = begin;
+    node.count = 1;
+    node.axis = 0;
+    primitiveIds[begin] = refs[begin].index;
+    return i;
+  }
+
+  int bestAxis = 0;
+  int bestSplit = (begin + end) / 2;
+  vec3 extent = cb.size();
+
+  if (depth < LIGHT_BVH_MAX_COST_DEPTH)
+  {
+    float bestCost = FloatInfo<float>::inf();
+    int sortedAxis = -1;
+
+    for (int axis = 0; axis < 3; axis++)
+    {
+      if (extent[axis] <= 0)
+        continue;
+      sortReferences(refs + begin, end - begin, sortedAxis = axis);
+
+      Bounds3 b;
+      float w = 0;
+
+      for (int k = end - 1; k > begin; k--)
+      {
+        b.inflate(refs[k].bounds);
+        w += weights[refs[k].index];
+        costs[k] = w * float(b.diagonalLength());
+      }
+      b.setEmpty();
+      w = 0;
+      for (int k = begin + 1; k < end; k++)
+      {
+        b.inflate(refs[k - 1].bounds);
+        w += weights[refs[k - 1].index];
+
+        float cost = w * float(b.diagonalLength()) + costs[k];
+
+        if (cost < bestCost)
+        {
+          bestCost = cost;
+          bestAxis = axis;
+          bestSplit = k;
+        }
+      }
+    }
+    if (bestAxis != sortedAxis)
+      sortReferences(refs + begin, end - begin, bestAxis);
+  }
+  else
+  {
+    bestAxis = extent.y > extent.x ? 1 : 0;
+    if (extent.z > extent[bestAxis])
+      bestAxis = 2;
+    sortReferences(refs + begin, end - begin, bestAxis);
+  }
+  node.count = 0;
+  node.axis = uint16(bestAxis);
+  buildNode(begin, bestSplit, depth + 1);
+  nodes[i].index = buildNode(bestSplit, end, depth + 1);
+  return i;
+}
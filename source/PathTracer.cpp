@@ -0,0 +1,477 @@
+//[]------------------------------------------------------------------------[]
+//|                                                                          |
+//|                          GVSG Graphics Library                           |
+//|                               Version 1.0                                |
+//|                                                                          |
+//|              Copyright 2007-2014, Paulo Aristarco Pagliosa              |
+//|              All Rights Reserved.                                        |
+//|                                                                          |
+//[]------------------------------------------------------------------------[]
+//
+//  OVERVIEW: PathTracer.cpp
+//  ========
+//  Source file for unidirectional path tracer.
+
+#include <chrono>
+#include "PathTracer.h"
+#include "RayTracerUtil.h"
+
+using namespace Graphics;
+
+#define DFL_SAMPLES_PER_PIXEL 16
+#define DFL_MAX_PATH_LENGTH   16
+#define DFL_ROULETTE_DEPTH    3
+#define MAX_SURVIVAL          (REAL)0.95
+
+//
+// Auxiliary functions
+//
+inline REAL
+powerHeuristic(REAL pdf, REAL otherPdf)
+{
+  pdf *= pdf;
+  return pdf / (pdf + otherPdf * otherPdf);
+}
+
+// Solid angle subtended by a spherical light seen from P, given as the
+// unit direction A to its center, the distance d to its center and
+// 1 - cos(theta) of its half angle. Return false if P is inside it
+inline bool
+sphereCone(const Light* light, const vec3& P, vec3& A, REAL& d, REAL& c)
+{
+  A = light->position - P;
+  d = A.length();
+
+  REAL s2 = light->radius * light->radius / (d * d);
+
+  if (s2 >= 1)
+    return false;
+  A *= Math::inverse<REAL>(d);
+  // 1 - sqrt(1 - s2), without cancellation for small lights
+  c = s2 / (1 + (REAL)sqrt(1 - s2));
+  return true;
+}
+
+// Radiance of a spherical light seen from distance d, given its half
+// angle: the light is as bright as a point light at its center would be
+inline Color
+sphereRadiance(const Light* light, REAL d, REAL c)
+{
+  return light->getScaledColor(d) * (float)(1 / (c * (2 - c)));
+}
+
+// Distance along the unit direction D from P (outside the light) to
+// the surface of a spherical light, or infinity if D misses it
+inline REAL
+sphereDistance(const Light* light, const vec3& P, const vec3& D)
+{
+  vec3 C = light->position - P;
+  REAL b = C.dot(D);
+  REAL k = light->radius * light->radius - (C.dot(C) - b * b);
+
+  if (k < 0 || b <= 0)
+    return FloatInfo<REAL>::inf();
+  return b - (REAL)sqrt(k);
+}
+
+
+//////////////////////////////////////////////////////////
+//
+// PathTracer implementation
+// ==========
+PathTracer::PathTracer(Scene& scene, Camera* camera):
+  RayTracer(scene, camera),
+  samplesPerPixel(DFL_SAMPLES_PER_PIXEL),
+  rouletteDepth(DFL_ROULETTE_DEPTH),
+  sampler(new SobolSampler()),
+  numberOfSamples(0),
+  sampleTime(0)
+//[]---------------------------------------------------[]
+//|  Constructor                                        |
+//[]---------------------------------------------------[]
+{
+  maxRecursionLevel = DFL_MAX_PATH_LENGTH;
+}
+
+void
+PathTracer::scan()
+//[]---------------------------------------------------[]
+//|  Scan the image                                     |
+//[]---------------------------------------------------[]
+{
+  std::chrono::high_resolution_clock::time_point start =
+    std::chrono::high_resolution_clock::now();
+
+  std::vector<Light*> lights;
+
+  for (LightIterator lit(scene->getLightIterator()); lit;)
+  {
+    Light* light = lit++;
+
+    if (light->isTurnedOn())
+      lights.push_back(light);
+  }
+  lightBVH.build(lights);
+  if (adaptive && !progressive)
+    adaptiveScan();
+  else
+  {
+    long long count = 0;
+
+    if (adaptive)
+      for (int i = 0, n = W * H; i < n; i++)
+        count -= sampleCountBuffer[i];
+    RayTracer::scan();
+    if (!adaptive)
+      count = (long long)W * H * dMax<int>(samplesPerPixel, 1);
+    else
+      for (int i = 0, n = W * H; i < n; i++)
+        count += sampleCountBuffer[i];
+    numberOfSamples = count;
+  }
+
+  std::chrono::duration<double> elapsed =
+    std::chrono::high_resolution_clock::now() - start;
+
+  sampleTime = elapsed.count();
+}
+
+void
+PathTracer::renderTile(int x1, int y1, int x2, int y2)
+//[]---------------------------------------------------[]
+//|  Render tile [x1, x2) x [y1, y2)                    |
+//|                                                     |
+//|  The samples of a pixel are numbered across the     |
+//|  passes (and the rounds of an adaptive render), so  |
+//|  that each pass traces new paths.                   |
+//[]---------------------------------------------------[]
+{
+  int spp = dMax<int>(samplesPerPixel, 1);
+
+  if (adaptive && !progressive)
+    spp = tileSamples[tileIndex(x1, y1)];
+  if (spp == 0)
+    return;
+
+  PixelSampler ps(*sampler);
+
+  for (int y = y1; y < y2; y++)
+    for (int x = x1; x < x2; x++)
+    {
+      Color sum = Color::black;
+      float squaredSum = 0;
+
+      ps.startPixel(x, y, uint32(getSampleCount(x, y)), spp);
+      for (int s = 0; s < spp; s++)
+      {
+        ps.startSample(s);
+
+        float dx;
+        float dy;
+
+        ps.next2D(dx, dy);
+
+        Color c = tracePath(makeRay(x + dx, y + dy), ps);
+        float l = luminance(c);
+
+        sum += c;
+        squaredSum += l * l;
+      }
+      storeSamples(x, y, sum, squaredSum, spp);
+    }
+}
+
+int
+PathTracer::tileArea(int i) const
+//[]---------------------------------------------------[]
+//|  Number of pixels of tile i                         |
+//[]---------------------------------------------------[]
+{
+  int x1 = i % tilesX * tileSize;
+  int y1 = i / tilesX * tileSize;
+
+  return (dMin<int>(x1 + tileSize, W) - x1) *
+    (dMin<int>(y1 + tileSize, H) - y1);
+}
+
+void
+PathTracer::adaptiveScan()
+//[]---------------------------------------------------[]
+//|  Scan the image adaptively                          |
+//|                                                     |
+//|  The budget of samplesPerPixel paths per pixel is   |
+//|  spent in rounds. The first round traces the same   |
+//|  number of paths for all the pixels; the next ones  |
+//|  give each tile that is not converged a number of   |
+//|  paths per pixel proportional to its error, capped  |
+//|  at the number of paths it already has.             |
+//[]---------------------------------------------------[]
+{
+  int spp = dMax<int>(samplesPerPixel, 1);
+  long long budget = (long long)W * H * spp;
+  int n0 = dMin<int>(spp, MIN_ADAPTIVE_SAMPLES);
+
+  updateTiles();
+  tileSamples.assign(tiles.size(), n0);
+  RayTracer::scan();
+  numberOfSamples = (long long)W * H * n0;
+  for (int numberOfTiles = int(tiles.size());;)
+  {
+    long long remaining = budget - numberOfSamples;
+
+    if (n0 < 2 || remaining <= 0)
+      break;
+    updateTiles();
+
+    // Paths of the round and error of the tiles to be sampled
+    long long round = 0;
+    double error = 0;
+    int worst = -1;
+
+    for (int i = 0; i < numberOfTiles; i++)
+      if (!isConverged(i))
+      {
+        int area = tileArea(i);
+
+        round += (long long)area * tiles[i].numberOfSamples;
+        error += (double)area * tiles[i].error;
+        if (worst < 0 || tiles[i].error > tiles[worst].error)
+          worst = i;
+      }
+    if (worst < 0)
+      break;
+    round = dMin<long long>(round, remaining);
+
+    long long spent = 0;
+
+    for (int i = 0; i < numberOfTiles; i++)
+    {
+      int n = 0;
+
+      if (!isConverged(i))
+      {
+        n = int(round * (tiles[i].error / error));
+        n = dMin<int>(n, tiles[i].numberOfSamples);
+        if (i == worst)
+          n = dMax<int>(n, 1);
+      }
+      tileSamples[i] = n;
+      spent += (long long)tileArea(i) * n;
+    }
+    RayTracer::scan();
+    numberOfSamples += spent;
+  }
+}
+
+Color
+PathTracer::tracePath(const Ray& ray, PixelSampler& ps)
+//[]---------------------------------------------------[]
+//|  Trace path                                         |
+//|                                                     |
+//|  Each bounce takes four pairs of dimensions of the  |
+//|  sample, even if unused, so that the same           |
+//|  dimensions are used for the same decisions in all  |
+//|  the paths, and the 2D decisions (directions) get   |
+//|  the aligned pairs of the sampler.                  |
+//|                                                     |
+//|  The spherical lights hit by a scattered ray are    |
+//|  added with their MIS weights, computed from the    |
+//|  pdf of the direction at the last vertex.           |
+//[]---------------------------------------------------[]
+{
+  Color L = Color::black;
+  Color beta = Color::white; // path throughput
+  Color lightBeta = Color::black; // throughput of the light hit by r
+  REAL lightPdf = 0; // pdf of the direction of r (0 for a delta lobe)
+  vec3 lightN; // normal at the origin of r
+  Ray r = ray;
+
+  for (int depth = 0;; depth++)
+  {
+    Intersection hit;
+    bool missed = !intersect(r, hit);
+
+    if (depth > 0 && !isBlack(lightBeta))
+    {
+      REAL d = missed ? FloatInfo<REAL>::inf() : hit.distance;
+
+      L += lightBeta * emittedLight(r, lightN, d, lightPdf);
+    }
+    if (missed)
+    {
+      L += beta * (depth == 0 ? background() : scene->ambientLight);
+      break;
+    }
+
+    const Material::Surface& s =
+      hit.actor->getModel()->getMaterial()->surface;
+    vec3 P = r(hit.distance);
+    vec3 V = r.direction.versor();
+    vec3 N = hit.normal;
+    bool entering = N.dot(V) < 0;
+
+    if (!entering)
+      N.negate();
+
+    REAL eta = entering ? scene->getIOR() / s.IOR : s.IOR / scene->getIOR();
+    PhongBSDF bsdf(s, N, V, eta);
+    float bsdfU;
+    float bsdfV;
+    float lightU;
+    float lightV;
+    float lobe;
+    float light;
+    float roulette;
+    float unused;
+
+    ps.next2D(bsdfU, bsdfV);
+    ps.next2D(lightU, lightV);
+    ps.next2D(lobe, light);
+    ps.next2D(roulette, unused);
+    if (bsdf.hasSmoothLobes())
+      L += beta * directLight(P, N, bsdf, light, lightU, lightV);
+    if (depth >= maxRecursionLevel)
+      break;
+
+    BSDFSample bs;
+
+    if (!bsdf.sample(lobe, bsdfU, bsdfV, bs))
+      break;
+    if (bs.delta)
+    {
+      lightPdf = 0;
+      lightBeta = beta * bs.weight;
+    }
+    else
+    {
+      // The lights hit are weighted with the pdf of all smooth lobes
+      lightPdf = bsdf.pdf(bs.direction);
+      lightBeta = beta * bsdf.eval(bs.direction) *
+        (float)(N.dot(bs.direction) / lightPdf);
+    }
+    beta *= bs.weight;
+    if (depth + 1 >= rouletteDepth)
+    {
+      REAL q = dMin<REAL>(maxComponent(beta), MAX_SURVIVAL);
+
+      if (roulette >= q)
+        break;
+      beta *= (float)(1 / q);
+      lightBeta *= (float)(1 / q);
+    }
+    r = Ray(P, bs.direction, RT_EPS);
+    lightN = N;
+  }
+  return L;
+}
+
+Color
+PathTracer::directLight(const vec3& P,
+  const vec3& N,
+  const PhongBSDF& bsdf,
+  REAL u0,
+  REAL u1,
+  REAL u2)
+//[]---------------------------------------------------[]
+//|  Direct light (next-event estimation)               |
+//|                                                     |
+//|  A light is sampled from the light BVH with the     |
+//|  random number u0. A direction to a spherical light |
+//|  is sampled uniformly in the cone it subtends, with |
+//|  the random numbers u1 and u2, and weighted against |
+//|  the BSDF pdf with the power heuristic.             |
+//[]---------------------------------------------------[]
+{
+  REAL pmf;
+  int i = lightBVH.sample(P, N, u0, pmf);
+
+  if (i < 0)
+    return Color::black;
+
+  const Light* light = lightBVH.getLight(i);
+  vec3 D;
+  REAL d;
+
+  if (light->isDelta())
+  {
+    light->lightVector(P, D, d);
+
+    REAL cosTheta = N.dot(D);
+
+    if (cosTheta <= 0)
+      return Color::black;
+
+    Color f = bsdf.eval(D);
+
+    if (isBlack(f) || shadow(Ray(P, D, RT_EPS, d)))
+      return Color::black;
+    return light->getScaledColor(d) * f * (float)(M_PI * cosTheta / pmf);
+  }
+
+  vec3 A;
+  REAL c;
+
+  if (!sphereCone(light, P, A, d, c))
+    return Color::black;
+  D = sphericalDirection(A, 1 - u1 * c, 2 * (REAL)M_PI * u2);
+
+  REAL cosTheta = N.dot(D);
+
+  if (cosTheta <= 0)
+    return Color::black;
+
+  Color f = bsdf.eval(D);
+  REAL t = sphereDistance(light, P, D);
+
+  if (isBlack(f) || t == FloatInfo<REAL>::inf() ||
+    shadow(Ray(P, D, RT_EPS, t)))
+    return Color::black;
+
+  REAL pdf = pmf / (2 * (REAL)M_PI * c);
+  REAL w = powerHeuristic(pdf, bsdf.pdf(D));
+
+  return sphereRadiance(light, d, c) * f * (float)(w * cosTheta / pdf);
+}
+
+Color
+PathTracer::emittedLight(const Ray& ray,
+  const vec3& N,
+  REAL distance,
+  REAL bsdfPdf)
+//[]---------------------------------------------------[]
+//|  Light emitted by the spherical lights hit by a     |
+//|  scattered ray before the given distance, weighted  |
+//|  against light sampling with the power heuristic    |
+//|  (or not weighted if the direction of the ray was   |
+//|  sampled from a delta lobe). N is the normal at the |
+//|  origin of the ray                                  |
+//[]---------------------------------------------------[]
+{
+  Color L = Color::black;
+  const vec3& P = ray.origin;
+  const vec3& D = ray.direction;
+
+  lightBVH.forEachLightHit(Ray(P, D, 0, distance), [&](int i)
+  {
+    const Light* light = lightBVH.getLight(i);
+    vec3 A;
+    REAL d;
+    REAL c;
+
+    if (light->isDelta() || !sphereCone(light, P, A, d, c))
+      return;
+    if (sphereDistance(light, P, D) >= distance)
+      return;
+
+    REAL w = 1;
+
+    if (bsdfPdf > 0)
+    {
+      REAL pdf = lightBVH.pmf(P, N, i) / (2 * (REAL)M_PI * c);
+
+      w = powerHeuristic(bsdfPdf, pdf);
+    }
+    L += sphereRadiance(light, d, c) * (float)w;
+  });
+  return L;
+}
@@ -0,0 +1,168 @@
+//[]------------------------------------------------------------------------[]
+//|                                                                          |
+//|                          GVSG Graphics Library                           |
+//|                               Version 1.0                                |
+//|                                                                          |
+//|              Copyright 2007-2014, Paulo Aristarco Pagliosa              |
+//|              All Rights Reserved.                                        |
+//|                                                                          |
+//[]------------------------------------------------------------------------[]
+//
+//  OVERVIEW: PhongBSDF.cpp
+//  ========
+//  Source file for Phong BSDF.
+
+#include "PhongBSDF.h"
+#include "RayTracerUtil.h"
+
+using namespace Graphics;
+
+#define INV_PI (REAL)(1 / M_PI)
+
+
+//////////////////////////////////////////////////////////
+//
+// PhongBSDF implementation
+// =========
+PhongBSDF::PhongBSDF(const Material::Surface& s,
+  const vec3& aN,
+  const vec3& aV,
+  REAL aEta):
+  surface(s),
+  N(aN),
+  V(aV),
+  R(reflect(aV, aN)),
+  eta(aEta)
+//[]---------------------------------------------------[]
+//|  Constructor                                        |
+//[]---------------------------------------------------[]
+{
+  pDiffuse = maxComponent(s.diffuse);
+  pGlossy = s.shine > 0 ? maxComponent(s.spot) : 0;
+  pMirror = maxComponent(s.specular);
+  pRefraction = maxComponent(s.transparency);
+
+  REAL sum = pDiffuse + pGlossy + pMirror + pRefraction;
+
+  // Keep the surface from reflecting more than it receives
+  scale = sum > 1 ? float(1 / sum) : 1.0f;
+  if (sum > 0)
+  {
+    sum = 1 / sum;
+    pDiffuse *= sum;
+    pGlossy *= sum;
+    pMirror *= sum;
+    pRefraction *= sum;
+  }
+}
+
+Color
+PhongBSDF::eval(const vec3& L) const
+//[]---------------------------------------------------[]
+//|  Evaluate                                           |
+//[]---------------------------------------------------[]
+{
+  if (N.dot(L) <= 0)
+    return Color::black;
+
+  Color f = surface.diffuse * (float)INV_PI;
+
+  if (pGlossy > 0)
+  {
+    REAL cosAlpha = R.dot(L);
+
+    if (cosAlpha > 0)
+    {
+      REAL n = surface.shine;
+
+      f += surface.spot * (float)((n + 2) * INV_PI / 2 * pow(cosAlpha, n));
+    }
+  }
+  return f * scale;
+}
+
+REAL
+PhongBSDF::pdf(const vec3& L) const
+//[]---------------------------------------------------[]
+//|  Pdf                                                |
+//|                                                     |
+//|  Density of sampling L from the diffuse or the      |
+//|  glossy lobe, weighted by the lobe probabilities.   |
+//[]---------------------------------------------------[]
+{
+  REAL cosTheta = N.dot(L);
+
+  if (cosTheta <= 0)
+    return 0;
+
+  REAL p = pDiffuse * cosTheta * INV_PI;
+
+  if (pGlossy > 0)
+  {
+    REAL cosAlpha = R.dot(L);
+
+    if (cosAlpha > 0)
+    {
+      REAL n = surface.shine;
+
+      p += pGlossy * (n + 1) * INV_PI / 2 * pow(cosAlpha, n);
+    }
+  }
+  return p;
+}
+
+bool
+PhongBSDF::sample(REAL u0, REAL u1, REAL u2, BSDFSample& s) const
+//[]---------------------------------------------------[]
+//|  Sample                                             |
+//|                                                     |
+//|  The weight of a sample is the value of its lobe    |
+//|  times the cosine over the pdf of the direction in  |
+//|  the lobe and the probability of the lobe, which    |
+//|  gives an unbiased estimate of the whole BSDF.      |
+//[]---------------------------------------------------[]
+{
+  REAL phi = 2 * (REAL)M_PI * u2;
+
+  if ((u0 -= pDiffuse) < 0)
+  {
+    // Cosine-weighted direction: f * cos / pdf = diffuse
+    s.direction = sphericalDirection(N, (REAL)sqrt(u1), phi);
+    s.weight = surface.diffuse * (scale / (float)pDiffuse);
+    s.delta = false;
+    return true;
+  }
+  if ((u0 -= pGlossy) < 0)
+  {
+    // Direction with pdf (n + 1) / 2PI cos^n around R
+    REAL n = surface.shine;
+
+    s.direction = sphericalDirection(R, (REAL)pow(u1, 1 / (n + 1)), phi);
+
+    REAL cosTheta = N.dot(s.direction);
+
+    if (cosTheta <= 0)
+      return false;
+    s.weight = surface.spot *
+      (scale * (float)((n + 2) / (n + 1) * cosTheta / pGlossy));
+    s.delta = false;
+    return true;
+  }
+  if ((u0 -= pMirror) < 0)
+  {
+    s.direction = R;
+    s.weight = surface.specular * (scale / (float)pMirror);
+    s.delta = true;
+    return true;
+  }
+  if (pRefraction > 0)
+  {
+    // Total internal reflection goes along the mirror direction
+    if (!refract(V, N, eta, s.direction))
+      s.direction = R;
+    s.weight = surface.transparency * (scale / (float)pRefraction);
+    s.delta = true;
+    return true;
+  }
+  return false;
+}
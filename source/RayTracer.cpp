@@ -0,0 +1,726 @@
+//[]------------------------------------------------------------------------[]
+//|                                                                          |
+//|                          GVSG Graphics Library                           |
+//|                               Version 1.0                                |
+//|                                                                          |
+//|              Copyright 2007-2014, Paulo Aristarco Pagliosa              |
+//|              All Rights Reserved.                                        |
+//|                                                                          |
+//[]------------------------------------------------------------------------[]
+//
+//  OVERVIEW: RayTracer.cpp
+//  ========
+//  Source file for multithreaded CPU ray tracer.
+
+#include <chrono>
+#include <limits.h>
+#include <stdio.h>
+#include <string.h>
+#include "RayTracer.h"
+#include "RayTracerUtil.h"
+
+using namespace Graphics;
+
+#define MAX_RECURSION_LEVEL 6
+#define MIN_WEIGHT          (REAL)0.01
+#define DFL_TILE_SIZE       32
+#define DFL_ERROR_THRESHOLD 0.005f
+#define MIN_MEAN_LUMINANCE  1e-3f
+
+//
+// Auxiliary functions
+//
+inline uint8
+toByte(float c)
+{
+  return uint8(c <= 0 ? 0 : c >= 1 ? 255 : c * 255 + 0.5f);
+}
+
+// Blue-green-yellow-red color ramp, for t in [0, 1]
+inline Color
+heatColor(float t)
+{
+  float r = dMin<float>(dMax<float>(2 * t - 0.5f, 0), 1);
+  float g = dMin<float>(dMax<float>(2 - fabs(4 * t - 2), 0), 1);
+  float b = dMin<float>(dMax<float>(1 - 2 * t, 0), 1);
+
+  return Color(r, g, b);
+}
+
+// Offset in [0, 1) of the sample of a pixel in a pass along axis dim
+inline REAL
+pixelJitter(int x, int y, int pass, int dim)
+{
+  uint32 h = hashInt(x + hashInt(y + hashInt(2 * pass + dim)));
+
+  return (h >> 8) * (REAL)(1.0 / 16777216);
+}
+
+
+//////////////////////////////////////////////////////////
+//
+// RayTracer implementation
+// =========
+RayTracer::RayTracer(Scene& scene, Camera* camera):
+  Renderer(scene, camera),
+  maxRecursionLevel(MAX_RECURSION_LEVEL),
+  minWeight(MIN_WEIGHT),
+  tileSize(DFL_TILE_SIZE),
+  tileOrder(TileScheduler::Hilbert),
+  watertight(false),
+  spatialSplits(false),
+  optimizeTreelets(false),
+  progressive(false),
+  adaptive(false),
+  errorThreshold(DFL_ERROR_THRESHOLD),
+  packets(true),
+  frameBuffer(0),
+  accumulationBuffer(0),
+  squaredSumBuffer(0),
+  sampleCountBuffer(0),
+  tilesX(0),
+  bufferW(0),
+  bufferH(0),
+  renderTime(0),
+  buildTime(0),
+  numberOfPasses(0),
+  cameraTimestamp(0),
+  sceneTimestamp(0)
+//[]---------------------------------------------------[]
+//|  Constructor                                        |
+//[]---------------------------------------------------[]
+{
+  // do nothing
+}
+
+RayTracer::~RayTracer()
+//[]---------------------------------------------------[]
+//|  Destructor                                         |
+//[]---------------------------------------------------[]
+{
+  delete []frameBuffer;
+  delete []accumulationBuffer;
+  delete []squaredSumBuffer;
+  delete []sampleCountBuffer;
+}
+
+void
+RayTracer::updateFrameBuffer()
+//[]---------------------------------------------------[]
+//|  Update frame buffer                                |
+//[]---------------------------------------------------[]
+{
+  if (bufferW == W && bufferH == H)
+    return;
+  delete []frameBuffer;
+  delete []accumulationBuffer;
+  delete []squaredSumBuffer;
+  delete []sampleCountBuffer;
+  frameBuffer = new Color[W * H];
+  accumulationBuffer = new Color[W * H];
+  squaredSumBuffer = new float[W * H];
+  sampleCountBuffer = new int[W * H];
+  bufferW = W;
+  bufferH = H;
+  numberOfPasses = 0;
+}
+
+void
+RayTracer::update()
+//[]---------------------------------------------------[]
+//|  Update                                             |
+//[]---------------------------------------------------[]
+{
+  Renderer::update();
+  updateFrameBuffer();
+  if (bvh == 0 || bvh->getScene() != scene)
+    bvh = new SceneBVH(*scene);
+  bvh->spatialSplits = spatialSplits;
+  bvh->optimizeTreelets = optimizeTreelets;
+  bvh->cacheDirectory = bvhCacheDirectory;
+
+  bool rebuilt = bvh->update();
+
+  buildTime = rebuilt ? bvh->getBuildTime() : 0;
+  if (!progressive || rebuilt ||
+    camera->getTimestamp() != cameraTimestamp ||
+    scene->getTimestamp() != sceneTimestamp)
+    numberOfPasses = 0;
+  cameraTimestamp = camera->getTimestamp();
+
+  // Viewing reference coordinate system
+  VRP = camera->getPosition();
+  VPN = camera->getDirectionOfProjection();
+  v = camera->getViewUp();
+  u = VPN.cross(v).versor();
+  Ih = camera->windowHeight();
+  Iw = Ih * camera->getAspectRatio();
+  parallel = camera->getProjectionType() == Camera::Parallel;
+  if (!parallel)
+    VPN *= camera->getDistance();
+}
+
+Ray
+RayTracer::makeRay(REAL x, REAL y) const
+//[]---------------------------------------------------[]
+//|  Make ray through the image point (x, y)            |
+//[]---------------------------------------------------[]
+{
+  vec3 p = u * (Iw * (x / W - (REAL)0.5)) + v * (Ih * (y / H - (REAL)0.5));
+
+  if (parallel)
+    return Ray(VRP + p, VPN);
+  return Ray(VRP, VPN + p);
+}
+
+void
+RayTracer::render()
+//[]---------------------------------------------------[]
+//|  Render                                             |
+//[]---------------------------------------------------[]
+{
+  std::chrono::high_resolution_clock::time_point start =
+    std::chrono::high_resolution_clock::now();
+
+  update();
+  if (numberOfPasses == 0 || !progressive)
+    memset(sampleCountBuffer, 0, W * H * sizeof(int));
+  if (scene->getNumberOfLights() != 0)
+    scan();
+  else
+  {
+    Light* light = makeDefaultLight();
+
+    scene->addLight(light);
+    scan();
+    scene->deleteLight(light);
+  }
+  // Changes made by the render itself do not restart the accumulation
+  sceneTimestamp = scene->getTimestamp();
+  if (progressive)
+    numberOfPasses++;
+
+  std::chrono::duration<double> elapsed =
+    std::chrono::high_resolution_clock::now() - start;
+
+  renderTime = elapsed.count();
+}
+
+void
+RayTracer::scan()
+//[]---------------------------------------------------[]
+//|  Scan the image                                     |
+//|                                                     |
+//|  The image is split into tiles, which are rendered  |
+//|  by the worker threads (see TileScheduler).         |
+//[]---------------------------------------------------[]
+{
+  updateTiles();
+  scheduler.tileSize = tileSize;
+  scheduler.tileOrder = tileOrder;
+  scheduler.run(W, H, [this](int x1, int y1, int x2, int y2)
+  {
+    if (!adaptive || !progressive || !isConverged(tileIndex(x1, y1)))
+      renderTile(x1, y1, x2, y2);
+  });
+}
+
+void
+RayTracer::updateTiles()
+//[]---------------------------------------------------[]
+//|  Update the sample counts and errors of the tiles   |
+//|                                                     |
+//|  A tile size less than one is taken as one, as in   |
+//|  TileScheduler.                                     |
+//[]---------------------------------------------------[]
+{
+  tileSize = dMax<int>(tileSize, 1);
+  tilesX = (W + tileSize - 1) / tileSize;
+
+  int tilesY = (H + tileSize - 1) / tileSize;
+
+  tiles.resize(tilesX * tilesY);
+  if (!adaptive)
+    return;
+  parallelFor(tilesY, tilesY, [this](int, int begin, int end)
+  {
+    for (int ty = begin; ty < end; ty++)
+      for (int tx = 0; tx < tilesX; tx++)
+      {
+        Tile& tile = tiles[ty * tilesX + tx];
+        int x1 = tx * tileSize;
+        int y1 = ty * tileSize;
+        int x2 = dMin<int>(x1 + tileSize, W);
+        int y2 = dMin<int>(y1 + tileSize, H);
+        double sum = 0;
+
+        tile.numberOfSamples = INT_MAX;
+        for (int y = y1; y < y2; y++)
+          for (int x = x1; x < x2; x++)
+          {
+            int i = y * W + x;
+            int n = sampleCountBuffer[i];
+
+            tile.numberOfSamples = dMin<int>(tile.numberOfSamples, n);
+            if (n < 2)
+              continue;
+
+            float mean = luminance(accumulationBuffer[i]) / n;
+            float var = (squaredSumBuffer[i] / n - mean * mean) * n / (n - 1);
+
+            // Squared standard error over the mean
+            sum += dMax<float>(var, 0) / n /
+              dMax<float>(mean, MIN_MEAN_LUMINANCE);
+          }
+        tile.error = float(sqrt(sum / ((x2 - x1) * (y2 - y1))));
+      }
+  });
+}
+
+bool
+RayTracer::isConverged(int i) const
+//[]---------------------------------------------------[]
+//|  Test if tile i is converged                        |
+//[]---------------------------------------------------[]
+{
+  const Tile& tile = tiles[i];
+
+  return tile.numberOfSamples >= MIN_ADAPTIVE_SAMPLES &&
+    tile.error <= errorThreshold;
+}
+
+int
+RayTracer::getNumberOfConvergedTiles() const
+//[]---------------------------------------------------[]
+//|  Number of converged tiles                          |
+//[]---------------------------------------------------[]
+{
+  int n = 0;
+
+  if (adaptive)
+    for (int i = 0, e = int(tiles.size()); i < e; i++)
+      n += isConverged(i);
+  return n;
+}
+
+Ray
+RayTracer::makePixelRay(int x, int y) const
+//[]---------------------------------------------------[]
+//|  Make ray through the sample of the current pass    |
+//|  in pixel (x, y)                                    |
+//[]---------------------------------------------------[]
+{
+  int pass = numberOfPasses;
+
+  if (!progressive || pass == 0)
+    return makeRay(x + (REAL)0.5, y + (REAL)0.5);
+  return makeRay(x + pixelJitter(x, y, pass, 0),
+    y + pixelJitter(x, y, pass, 1));
+}
+
+void
+RayTracer::storeSample(int x, int y, const Color& c)
+//[]---------------------------------------------------[]
+//|  Store the color of the sample of the current pass  |
+//|  in pixel (x, y)                                    |
+//[]---------------------------------------------------[]
+{
+  float l = luminance(c);
+
+  storeSamples(x, y, c, l * l, 1);
+}
+
+void
+RayTracer::storeSamples(int x, int y, const Color& c, float c2, int n)
+//[]---------------------------------------------------[]
+//|  Store n samples of pixel (x, y), given the sum c   |
+//|  of their colors and the sum c2 of their squared    |
+//|  luminances                                         |
+//[]---------------------------------------------------[]
+{
+  int i = y * W + x;
+
+  if (!progressive && !adaptive)
+  {
+    frameBuffer[i] = c * (1.0f / n);
+    return;
+  }
+
+  int& count = sampleCountBuffer[i];
+
+  if (count == 0)
+  {
+    accumulationBuffer[i] = c;
+    squaredSumBuffer[i] = c2;
+  }
+  else
+  {
+    accumulationBuffer[i] += c;
+    squaredSumBuffer[i] += c2;
+  }
+  count += n;
+  frameBuffer[i] = accumulationBuffer[i] * (1.0f / count);
+}
+
+void
+RayTracer::renderTile(int x1, int y1, int x2, int y2)
+//[]---------------------------------------------------[]
+//|  Render tile [x1, x2) x [y1, y2)                    |
+//[]---------------------------------------------------[]
+{
+  if (!packets || watertight)
+  {
+    for (int y = y1; y < y2; y++)
+      for (int x = x1; x < x2; x++)
+        storeSample(x, y, trace(makePixelRay(x, y), 0, 1));
+    return;
+  }
+  for (int by = y1; by < y2; by += PACKET_BLOCK_SIZE)
+    for (int bx = x1; bx < x2; bx += PACKET_BLOCK_SIZE)
+    {
+      int ex = dMin<int>(bx + PACKET_BLOCK_SIZE, x2);
+      int ey = dMin<int>(by + PACKET_BLOCK_SIZE, y2);
+      RayPacket packet;
+      Color colors[RAY_PACKET_SIZE];
+
+      for (int y = by; y < ey; y++)
+        for (int x = bx; x < ex; x++)
+          packet.add(makePixelRay(x, y));
+      tracePacket(packet, colors);
+      for (int y = by, i = 0; y < ey; y++)
+        for (int x = bx; x < ex; x++)
+          storeSample(x, y, colors[i++]);
+    }
+}
+
+void
+RayTracer::tracePacket(const RayPacket& packet, Color* colors)
+//[]---------------------------------------------------[]
+//|  Trace packet                                       |
+//|                                                     |
+//|  Shade the primary rays of a packet as shade() does |
+//|  but testing the shadow rays toward each light as a |
+//|  packet.                                            |
+//[]---------------------------------------------------[]
+{
+  Intersection hits[RAY_PACKET_SIZE];
+  ShadingPoint points[RAY_PACKET_SIZE];
+  int mask = intersect(packet, hits);
+
+  for (int i = 0; i < packet.size; i++)
+    if (mask >> i & 1)
+    {
+      setShadingPoint(packet.getRay(i), hits[i], points[i]);
+      colors[i] = scene->ambientLight * points[i].surface->ambient;
+    }
+    else
+      colors[i] = background();
+  if (mask == 0)
+    return;
+  for (LightIterator lit(scene->getLightIterator()); lit;)
+  {
+    Light* light = lit++;
+
+    if (!light->isTurnedOn())
+      continue;
+
+    RayPacket shadowRays;
+    int lanes[RAY_PACKET_SIZE];
+    vec3 L[RAY_PACKET_SIZE];
+    REAL d[RAY_PACKET_SIZE];
+
+    for (int k = mask; k != 0; k &= k - 1)
+    {
+      int i = lowestBit(k);
+      const vec3& P = points[i].P;
+      int j = shadowRays.size;
+
+      light->lightVector(P, L[j], d[j]);
+      if (points[i].N.dot(L[j]) > 0)
+      {
+        lanes[j] = i;
+        shadowRays.add(Ray(P, L[j], RT_EPS, d[j]));
+      }
+    }
+    if (shadowRays.size == 0)
+      continue;
+
+    int occluded = shadow(shadowRays);
+
+    for (int j = 0; j < shadowRays.size; j++)
+      if ((occluded >> j & 1) == 0)
+        colors[lanes[j]] += lightColor(points[lanes[j]], light, L[j], d[j]);
+  }
+  for (int k = mask; k != 0; k &= k - 1)
+  {
+    int i = lowestBit(k);
+
+    traceSecondaryRays(points[i], 0, 1, colors[i]);
+  }
+}
+
+Color
+RayTracer::trace(const Ray& ray, int level, REAL weight)
+//[]---------------------------------------------------[]
+//|  Trace                                              |
+//[]---------------------------------------------------[]
+{
+  Intersection hit;
+
+  if (!intersect(ray, hit))
+    return level == 0 ? background() : Color::black;
+  return shade(ray, hit, level, weight);
+}
+
+Color
+RayTracer::shade(const Ray& ray, Intersection& hit, int level, REAL weight)
+//[]---------------------------------------------------[]
+//|  Shade (Whitted model)                              |
+//[]---------------------------------------------------[]
+{
+  ShadingPoint p;
+
+  setShadingPoint(ray, hit, p);
+
+  Color color = scene->ambientLight * p.surface->ambient;
+
+  for (LightIterator lit(scene->getLightIterator()); lit;)
+  {
+    Light* light = lit++;
+
+    if (!light->isTurnedOn())
+      continue;
+
+    vec3 L;
+    REAL d;
+
+    light->lightVector(p.P, L, d);
+    if (p.N.dot(L) <= 0 || shadow(Ray(p.P, L, RT_EPS, d)))
+      continue;
+    color += lightColor(p, light, L, d);
+  }
+  traceSecondaryRays(p, level, weight, color);
+  return color;
+}
+
+void
+RayTracer::setShadingPoint(const Ray& ray,
+  const Intersection& hit,
+  ShadingPoint& p) const
+//[]---------------------------------------------------[]
+//|  Set shading point                                  |
+//[]---------------------------------------------------[]
+{
+  p.surface = &hit.actor->getModel()->getMaterial()->surface;
+  p.P = ray(hit.distance);
+  p.V = ray.direction.versor();
+  p.N = hit.normal;
+  p.entering = p.N.dot(p.V) < 0;
+  if (!p.entering)
+    p.N.negate();
+}
+
+Color
+RayTracer::lightColor(const ShadingPoint& p,
+  Light* light,
+  const vec3& L,
+  REAL d) const
+//[]---------------------------------------------------[]
+//|  Color reflected from an unoccluded light           |
+//|                                                     |
+//|  L is the unit vector toward the light, at distance |
+//|  d, with N.L > 0.                                   |
+//[]---------------------------------------------------[]
+{
+  const Material::Surface& s = *p.surface;
+  Color I = light->getScaledColor(d);
+  Color color = I * s.diffuse * (float)p.N.dot(L);
+
+  if (s.shine > 0)
+  {
+    REAL cosPhi = -reflect(-L, p.N).dot(p.V);
+
+    if (cosPhi > 0)
+      color += I * s.spot * (float)pow(cosPhi, s.shine);
+  }
+  return color;
+}
+
+void
+RayTracer::traceSecondaryRays(const ShadingPoint& p,
+  int level,
+  REAL weight,
+  Color& color)
+//[]---------------------------------------------------[]
+//|  Add the colors of the reflected and refracted rays |
+//[]---------------------------------------------------[]
+{
+  if (level >= maxRecursionLevel)
+    return;
+
+  Ray r;
+  REAL w;
+
+  if (reflectedRay(p, weight, r, w))
+    color += p.surface->specular * trace(r, level + 1, w);
+  if (refractedRay(p, weight, r, w))
+    color += p.surface->transparency * trace(r, level + 1, w);
+}
+
+bool
+RayTracer::reflectedRay(const ShadingPoint& p,
+  REAL weight,
+  Ray& r,
+  REAL& w) const
+//[]---------------------------------------------------[]
+//|  Reflected ray                                      |
+//|                                                     |
+//|  Set the reflected ray of a shading point reached   |
+//|  with the given weight and the weight w of the ray. |
+//|  Return false if the surface is not reflective or w |
+//|  is not greater than minWeight.                     |
+//[]---------------------------------------------------[]
+{
+  const Material::Surface& s = *p.surface;
+
+  if (isBlack(s.specular))
+    return false;
+  w = weight * maxComponent(s.specular);
+  if (w <= minWeight)
+    return false;
+  r = Ray(p.P, reflect(p.V, p.N), RT_EPS);
+  return true;
+}
+
+bool
+RayTracer::refractedRay(const ShadingPoint& p,
+  REAL weight,
+  Ray& r,
+  REAL& w) const
+//[]---------------------------------------------------[]
+//|  Refracted ray                                      |
+//|                                                     |
+//|  As reflectedRay(), for the transparency of the     |
+//|  surface. Return false also on total internal       |
+//|  reflection.                                        |
+//[]---------------------------------------------------[]
+{
+  const Material::Surface& s = *p.surface;
+
+  if (isBlack(s.transparency))
+    return false;
+  w = weight * maxComponent(s.transparency);
+
+  REAL eta = p.entering ?
+    scene->getIOR() / s.IOR :
+    s.IOR / scene->getIOR();
+  vec3 T;
+
+  if (w <= minWeight || !refract(p.V, p.N, eta, T))
+    return false;
+  r = Ray(p.P, T, RT_EPS);
+  return true;
+}
+
+Color
+RayTracer::background() const
+//[]---------------------------------------------------[]
+//|  Background                                         |
+//[]---------------------------------------------------[]
+{
+  return scene->backgroundColor;
+}
+
+bool
+RayTracer::intersect(const Ray& ray, Intersection& hit)
+//[]---------------------------------------------------[]
+//|  Closest intersection                               |
+//[]---------------------------------------------------[]
+{
+  return bvh->intersect(ray, hit, watertight);
+}
+
+bool
+RayTracer::shadow(const Ray& ray)
+//[]---------------------------------------------------[]
+//|  Test if there is any object along the ray          |
+//[]---------------------------------------------------[]
+{
+  return bvh->occluded(ray, ray.tMax, watertight);
+}
+
+int
+RayTracer::intersect(const RayPacket& packet, Intersection* hits)
+//[]---------------------------------------------------[]
+//|  Closest intersections of a packet                  |
+//[]---------------------------------------------------[]
+{
+  return bvh->intersect(packet, hits);
+}
+
+int
+RayTracer::shadow(const RayPacket& packet)
+//[]---------------------------------------------------[]
+//|  Mask of the rays of a packet with any object along |
+//[]---------------------------------------------------[]
+{
+  return bvh->occluded(packet);
+}
+
+bool
+RayTracer::saveHeatmap(const char* fileName) const
+//[]---------------------------------------------------[]
+//|  Save heatmap                                       |
+//[]---------------------------------------------------[]
+{
+  FILE* f;
+
+  if (sampleCountBuffer == 0 || (f = fopen(fileName, "wb")) == 0)
+    return false;
+
+  int n = bufferW * bufferH;
+  int maxCount = 1;
+  bool counted = progressive || adaptive;
+
+  if (counted)
+    for (int i = 0; i < n; i++)
+      maxCount = dMax<int>(maxCount, sampleCountBuffer[i]);
+  fprintf(f, "P6\n%d %d\n255\n", bufferW, bufferH);
+  for (int y = bufferH - 1; y >= 0; y--)
+    for (int x = 0; x < bufferW; x++)
+    {
+      int count = counted ? sampleCountBuffer[y * bufferW + x] : 0;
+      Color c = heatColor(float(count) / maxCount);
+      uint8 rgb[3] = {toByte(c.r), toByte(c.g), toByte(c.b)};
+
+      fwrite(rgb, 1, 3, f);
+    }
+  fclose(f);
+  return true;
+}
+
+bool
+RayTracer::saveImage(const char* fileName) const
+//[]---------------------------------------------------[]
+//|  Save image                                         |
+//[]---------------------------------------------------[]
+{
+  FILE* f;
+
+  if (frameBuffer == 0 || (f = fopen(fileName, "wb")) == 0)
+    return false;
+  fprintf(f, "P6\n%d %d\n255\n", bufferW, bufferH);
+  for (int y = bufferH - 1; y >= 0; y--)
+  {
+    const Color* pixel = frameBuffer + y * bufferW;
+
+    for (int x = 0; x < bufferW; x++, pixel++)
+    {
+      uint8 rgb[3] = {toByte(pixel->r), toByte(pixel->g), toByte(pixel->b)};
+
+      fwrite(rgb, 1, 3, f);
+    }
+  }
+  fclose(f);
+  return true;
+}
@@ -0,0 +1,90 @@
+#ifndef __RayTracerUtil_h
+#define __RayTracerUtil_h
+
+//[]------------------------------------------------------------------------[]
+//|                                                                          |
+//|                          GVSG Graphics Library                           |
+//|                               Version 1.0                                |
+//|                                                                          |
+//|              Copyright 2007-2014, Paulo Aristarco Pagliosa              |
+//|              All Rights Reserved.                                        |
+//|                                                                          |
+//[]------------------------------------------------------------------------[]
+//
+//  OVERVIEW: RayTracerUtil.h
+//  ========
+//  Auxiliary functions shared by the ray tracers (private header).
+
+#include "Graphics/Color.h"
+#include "Math/Vector3.h"
+
+namespace Graphics
+{ // begin namespace Graphics
+
+#define RT_EPS (REAL)1e-4
+
+//
+// Auxiliary functions
+//
+inline float
+maxComponent(const Color& c)
+{
+  return dMax<float>(c.r, dMax<float>(c.g, c.b));
+}
+
+inline bool
+isBlack(const Color& c)
+{
+  return maxComponent(c) <= 0;
+}
+
+inline float
+luminance(const Color& c)
+{
+  return 0.2126f * c.r + 0.7152f * c.g + 0.0722f * c.b;
+}
+
+inline vec3
+reflect(const vec3& D, const vec3& N)
+{
+  return D - N * (2 * N.dot(D));
+}
+
+inline bool
+refract(const vec3& D, const vec3& N, REAL eta, vec3& T)
+{
+  REAL c1 = -N.dot(D);
+  REAL k = 1 - eta * eta * (1 - c1 * c1);
+
+  if (k < 0)
+    return false;
+  T = D * eta + N * (eta * c1 - (REAL)sqrt(k));
+  return true;
+}
+
+inline void
+makeFrame(const vec3& N, vec3& T, vec3& B)
+{
+  vec3 a = fabs(N.x) > (REAL)0.9 ? vec3(0, 1, 0) : vec3(1, 0, 0);
+
+  T = a.cross(N).versor();
+  B = N.cross(T);
+}
+
+// Direction around the unit axis A with cos(theta) = c
+inline vec3
+sphericalDirection(const vec3& A, REAL c, REAL phi)
+{
+  vec3 T;
+  vec3 B;
+
+  makeFrame(A, T, B);
+
+  REAL s = (REAL)sqrt(dMax<REAL>(0, 1 - c * c));
+
+  return T * (s * (REAL)cos(phi)) + B * (s * (REAL)sin(phi)) + A * c;
+}
+
+} // end namespace Graphics
+
+#endif // __RayTracerUtil_h
@@ -22,7 +22,7 @@
 #define CVVY1 (REAL)-1.0
 #define CVVY2 (REAL)+1.0
 
-#define DFL_IMAGe_W 400
+#define DFL_IMAGE_W 400
 #define DFL_IMAGE_H 400
 
 using namespace Graphics;
@@ -35,7 +35,9 @@ using namespace Graphics;
 Renderer::Renderer(Scene& aScene, Camera* aCamera):
   scene(&aScene),
   camera(aCamera != 0 ? aCamera : new Camera()),
-  defaultLight(0)
+  defaultLight(0),
+  W(DFL_IMAGE_W),
+  H(DFL_IMAGE_H)
 //[]---------------------------------------------------[]
 //|  Constructor                                        |
 //[]---------------------------------------------------[]
@@ -0,0 +1,565 @@
+//[]------------------------------------------------------------------------[]
+//|                                                                          |
+//|                          GVSG Graphics Library                           |
+//|                               Version 1.0                                |
+//|                                                                          |
+//|              Copyright 2007-2014, Paulo Aristarco Pagliosa              |
+//|              All Rights Reserved.                                        |
+//|                                                                          |
+//[]------------------------------------------------------------------------[]
+//
+//  OVERVIEW: SBVHBuilder.cpp
+//  ========
+//  Source file for spatial split BVH builder.
+
+#include <algorithm>
+#include "SBVHBuilder.h"
+
+using namespace Graphics;
+
+//
+// Auxiliary functions
+//
+inline bool
+intersectBounds(const Bounds3& a, const Bounds3& b, Bounds3& c)
+{
+  vec3 p1 = a.getMin();
+  vec3 p2 = a.getMax();
+
+  for (int i = 0; i < 3; i++)
+  {
+    p1[i] = dMax<REAL>(p1[i], b.getMin()[i]);
+    p2[i] = dMin<REAL>(p2[i], b.getMax()[i]);
+    if (p1[i] > p2[i])
+    {
+      c.setEmpty();
+      return false;
+    }
+  }
+  c.set(p1, p2);
+  return true;
+}
+
+inline bool
+isVoid(const Bounds3& b)
+{
+  const vec3& p1 = b.getMin();
+  const vec3& p2 = b.getMax();
+
+  return p1.x > p2.x || p1.y > p2.y || p1.z > p2.z;
+}
+
+//
+// Auxiliary class
+//
+class SplitBinMapping
+{
+public:
+  // Constructor
+  SplitBinMapping(const Bounds3& b, int aBins):
+    origin(b.getMin()),
+    size(b.size()),
+    bins(aBins)
+  {
+    for (int i = 0; i < 3; i++)
+      k[i] = size[i] > 0 ? bins * (1 - (REAL)1e-6) / size[i] : 0;
+  }
+
+  int operator ()(const vec3& p, int axis) const
+  {
+    int b = int(k[axis] * (p[axis] - origin[axis]));
+    return b < 0 ? 0 : b >= bins ? bins - 1 : b;
+  }
+
+  // Position of the plane between bins b - 1 and b
+  REAL position(int b, int axis) const
+  {
+    return origin[axis] + size[axis] * b / bins;
+  }
+
+private:
+  vec3 origin;
+  vec3 size;
+  vec3 k;
+  int bins;
+
+}; // SplitBinMapping
+
+
+//////////////////////////////////////////////////////////
+//
+// SBVHBuilder implementation
+// ===========
+void
+SBVHBuilder::execute(BVH& bvh, Reference* refs, int n)
+//[]---------------------------------------------------[]
+//|  Build                                              |
+//[]---------------------------------------------------[]
+{
+  References r(refs, refs + n);
+  Bounds3 bounds;
+
+  for (int i = 0; i < n; i++)
+    bounds.inflate(refs[i].bounds);
+  bins = dMin<int>(dMax<int>(numberOfBins, 2), BVH_MAX_BINS);
+  minOverlap = splitThreshold * bounds.area();
+  maxDuplicates = int(duplicationBudget * n);
+  numberOfDuplicates = 0;
+  nodes.reserve(2 * n);
+  primitiveIds.reserve(n + maxDuplicates);
+  buildNode(r, 0);
+
+  int numberOfNodes = int(nodes.size());
+  int numberOfPrimitiveIds = int(primitiveIds.size());
+
+  nodesOf(bvh) = new BVH::Node[numberOfNodes];
+  primitiveIdsOf(bvh) = new int[numberOfPrimitiveIds];
+  std::copy(nodes.begin(), nodes.end(), nodesOf(bvh));
+  std::copy(primitiveIds.begin(), primitiveIds.end(), primitiveIdsOf(bvh));
+  numberOfNodesOf(bvh) = numberOfNodes;
+  numberOfPrimitiveIdsOf(bvh) = numberOfPrimitiveIds;
+  std::vector<BVH::Node>().swap(nodes);
+  std::vector<int>().swap(primitiveIds);
+}
+
+void
+SBVHBuilder::splitReference(const Reference& ref,
+  int axis,
+  REAL position,
+  Reference& left,
+  Reference& right) const
+//[]---------------------------------------------------[]
+//|  Split reference                                    |
+//|                                                     |
+//|  Compute the bounds of the parts of the triangle on |
+//|  each side of the plane, clipped to the bounds of   |
+//|  the reference. A part may be void (see isVoid()).  |
+//[]---------------------------------------------------[]
+{
+  const TriangleMesh::Triangle& t = data.triangles[ref.index];
+  Bounds3 lb;
+  Bounds3 rb;
+
+  for (int i = 0; i < 3; i++)
+  {
+    const vec3& v0 = data.vertices[t.v[i]];
+    const vec3& v1 = data.vertices[t.v[(i + 1) % 3]];
+    REAL p0 = v0[axis];
+    REAL p1 = v1[axis];
+
+    if (p0 <= position)
+      lb.inflate(v0);
+    if (p0 >= position)
+      rb.inflate(v0);
+    if ((p0 < position && p1 > position) || (p0 > position && p1 < position))
+    {
+      vec3 p = v0 + (v1 - v0) * ((position - p0) / (p1 - p0));
+
+      p[axis] = position;
+      lb.inflate(p);
+      rb.inflate(p);
+    }
+  }
+
+  vec3 p1 = ref.bounds.getMin();
+  vec3 p2 = ref.bounds.getMax();
+
+  p2[axis] = dMin<REAL>(p2[axis], position);
+  intersectBounds(lb, Bounds3(p1, p2), left.bounds);
+  p1[axis] = ref.bounds.getMin()[axis];
+  p2[axis] = ref.bounds.getMax()[axis];
+  p1[axis] = dMax<REAL>(p1[axis], position);
+  intersectBounds(rb, Bounds3(p1, p2), right.bounds);
+  left.centroid = left.bounds.center();
+  right.centroid = right.bounds.center();
+  left.index = right.index = ref.index;
+}
+
+void
+SBVHBuilder::findObjectSplit(const References& refs,
+  const Bounds3& cb,
+  Split& split) const
+//[]---------------------------------------------------[]
+//|  Find object split                                  |
+//|                                                     |
+//|  Binned SAH over the reference centroids.           |
+//[]---------------------------------------------------[]
+{
+  SplitBinMapping map(cb, bins);
+  vec3 extent = cb.size();
+  int n = int(refs.size());
+
+  split.cost = FloatInfo<REAL>::inf();
+  split.axis = -1;
+  for (int axis = 0; axis < 3; axis++)
+  {
+    if (extent[axis] <= 0)
+      continue;
+
+    Bounds3 bounds[BVH_MAX_BINS];
+    int count[BVH_MAX_BINS] = {0};
+
+    for (int i = 0; i < n; i++)
+    {
+      int b = map(refs[i].centroid, axis);
+
+      bounds[b].inflate(refs[i].bounds);
+      count[b]++;
+    }
+
+    Bounds3 rightBounds[BVH_MAX_BINS];
+    Bounds3 box;
+    int c = 0;
+
+    for (int k = bins - 1; k > 0; k--)
+    {
+      if (count[k] != 0)
+        box.inflate(bounds[k]);
+      rightBounds[k] = box;
+    }
+    box.setEmpty();
+    for (int k = 1; k < bins; k++)
+    {
+      if (count[k - 1] == 0)
+        continue;
+      box.inflate(bounds[k - 1]);
+      c += count[k - 1];
+      if (c == n)
+        break;
+
+      REAL cost = box.area() * c + rightBounds[k].area() * (n - c);
+
+      if (cost < split.cost)
+      {
+        split.cost = cost;
+        split.axis = axis;
+        split.bin = k;
+        split.left = box;
+        split.right = rightBounds[k];
+        split.leftCount = c;
+        split.rightCount = n - c;
+      }
+    }
+  }
+}
+
+void
+SBVHBuilder::findSpatialSplit(const References& refs,
+  const Bounds3& bounds,
+  Split& split) const
+//[]---------------------------------------------------[]
+//|  Find spatial split                                 |
+//|                                                     |
+//|  Each reference is chopped into the bins it spans   |
+//|  and counted as entering its first bin and exiting  |
+//|  its last one. The children of a split between bins |
+//|  k - 1 and k reference the triangles entering the   |
+//|  bins before k and exiting the bins from k on.      |
+//[]---------------------------------------------------[]
+{
+  SplitBinMapping map(bounds, bins);
+  vec3 extent = bounds.size();
+  int n = int(refs.size());
+
+  split.cost = FloatInfo<REAL>::inf();
+  split.axis = -1;
+  for (int axis = 0; axis < 3; axis++)
+  {
+    if (extent[axis] <= 0)
+      continue;
+
+    Bounds3 binBounds[BVH_MAX_BINS];
+    int entries[BVH_MAX_BINS] = {0};
+    int exits[BVH_MAX_BINS] = {0};
+
+    for (int i = 0; i < n; i++)
+    {
+      Reference ref = refs[i];
+      int first = map(ref.bounds.getMin(), axis);
+      int last = map(ref.bounds.getMax(), axis);
+
+      entries[first]++;
+      exits[last]++;
+      for (int k = first; k < last; k++)
+      {
+        Reference left;
+        Reference right;
+
+        splitReference(ref, axis, map.position(k + 1, axis), left, right);
+        if (!isVoid(left.bounds))
+          binBounds[k].inflate(left.bounds);
+        // If void, nothing is left for the next bins
+        ref = right;
+        if (isVoid(right.bounds))
+          break;
+      }
+      if (!isVoid(ref.bounds))
+        binBounds[last].inflate(ref.bounds);
+    }
+
+    Bounds3 rightBounds[BVH_MAX_BINS];
+    int rightCount[BVH_MAX_BINS];
+    Bounds3 box;
+    int c = 0;
+
+    for (int k = bins - 1; k > 0; k--)
+    {
+      if (!isVoid(binBounds[k]))
+        box.inflate(binBounds[k]);
+      c += exits[k];
+      rightBounds[k] = box;
+      rightCount[k] = c;
+    }
+    box.setEmpty();
+    c = 0;
+    for (int k = 1; k < bins; k++)
+    {
+      if (!isVoid(binBounds[k - 1]))
+        box.inflate(binBounds[k - 1]);
+      c += entries[k - 1];
+      if (c == 0 || rightCount[k] == 0)
+        continue;
+      if (isVoid(box) || isVoid(rightBounds[k]))
+        continue;
+
+      REAL cost = box.area() * c + rightBounds[k].area() * rightCount[k];
+
+      if (cost < split.cost)
+      {
+        split.cost = cost;
+        split.axis = axis;
+        split.bin = k;
+        split.position = map.position(k, axis);
+        split.left = box;
+        split.right = rightBounds[k];
+        split.leftCount = c;
+        split.rightCount = rightCount[k];
+      }
+    }
+  }
+}
+
+void
+SBVHBuilder::objectPartition(References& refs,
+  const Bounds3& cb,
+  const Split& split,
+  References& left,
+  References& right) const
+//[]---------------------------------------------------[]
+//|  Object partition                                   |
+//[]---------------------------------------------------[]
+{
+  int n = int(refs.size());
+
+  if (split.axis < 0)
+  {
+    // Too many references with coincident centroids
+    left.assign(refs.begin(), refs.begin() + n / 2);
+    right.assign(refs.begin() + n / 2, refs.end());
+    return;
+  }
+
+  SplitBinMapping map(cb, bins);
+
+  left.reserve(split.leftCount);
+  right.reserve(split.rightCount);
+  for (int i = 0; i < n; i++)
+    if (map(refs[i].centroid, split.axis) < split.bin)
+      left.push_back(refs[i]);
+    else
+      right.push_back(refs[i]);
+}
+
+void
+SBVHBuilder::spatialPartition(References& refs,
+  Split& split,
+  References& left,
+  References& right)
+//[]---------------------------------------------------[]
+//|  Spatial partition                                  |
+//|                                                     |
+//|  A reference straddling the split plane is either   |
+//|  duplicated or, if cheaper (or if the duplication   |
+//|  budget is exhausted), moved as a whole to one of   |
+//|  the sides ("reference unsplitting").               |
+//[]---------------------------------------------------[]
+{
+  int axis = split.axis;
+  REAL position = split.position;
+  int n = int(refs.size());
+  Bounds3& lb = split.left;
+  Bounds3& rb = split.right;
+  int nl = split.leftCount;
+  int nr = split.rightCount;
+
+  for (int i = 0; i < n; i++)
+  {
+    const Reference& ref = refs[i];
+
+    if (ref.bounds.getMax()[axis] <= position)
+    {
+      left.push_back(ref);
+      continue;
+    }
+    if (ref.bounds.getMin()[axis] >= position)
+    {
+      right.push_back(ref);
+      continue;
+    }
+
+    Reference l;
+    Reference r;
+
+    splitReference(ref, axis, position, l, r);
+    if (isVoid(l.bounds))
+    {
+      right.push_back(ref);
+      continue;
+    }
+    if (isVoid(r.bounds))
+    {
+      left.push_back(ref);
+      continue;
+    }
+
+    Bounds3 ub = lb;
+    REAL costSplit = lb.area() * nl + rb.area() * nr;
+
+    ub.inflate(ref.bounds);
+
+    REAL costLeft = ub.area() * nl + rb.area() * (nr - 1);
+
+    ub = rb;
+    ub.inflate(ref.bounds);
+
+    REAL costRight = lb.area() * (nl - 1) + ub.area() * nr;
+
+    if (numberOfDuplicates < maxDuplicates &&
+      costSplit < costLeft && costSplit < costRight)
+    {
+      left.push_back(l);
+      right.push_back(r);
+      numberOfDuplicates++;
+    }
+    else if (costLeft <= costRight)
+    {
+      left.push_back(ref);
+      lb.inflate(ref.bounds);
+      nr--;
+    }
+    else
+    {
+      right.push_back(ref);
+      rb.inflate(ref.bounds);
+      nl--;
+    }
+  }
+}
+
+int
+SBVHBuilder::makeLeaf(const References& refs, const Bounds3& bounds)
+//[]---------------------------------------------------[]
+//|  Make leaf                                          |
+//[]---------------------------------------------------[]
+{
+  int i = int(nodes.size());
+  int n = int(refs.size());
+  BVH::Node node;
+
+  node.bounds = bounds;
+  node.index = int(primitiveIds.size());
+  node.count = uint16(n);
+  node.axis = 0;
+  nodes.push_back(node);
+  for (int k = 0; k < n; k++)
+    primitiveIds.push_back(refs[k].index);
+  return i;
+}
+
+int
+SBVHBuilder::buildNode(References& refs, int depth)
+//[]---------------------------------------------------[]
+//|  Build node                                         |
+//|                                                     |
+//|  The references are released before the children   |
+//|  are built, so only the references of the nodes on  |
+//|  the current path are kept alive.                   |
+//[]---------------------------------------------------[]
+{
+  int n = int(refs.size());
+  Bounds3 bounds;
+  Bounds3 cb;
+
+  for (int i = 0; i < n; i++)
+  {
+    bounds.inflate(refs[i].bounds);
+    cb.inflate(refs[i].centroid);
+  }
+  if (n == 1)
+    return makeLeaf(refs, bounds);
+
+  Split object;
+  Split spatial;
+
+  findObjectSplit(refs, cb, object);
+  spatial.axis = -1;
+  if (object.axis >= 0 && numberOfDuplicates < maxDuplicates)
+  {
+    Bounds3 overlap;
+
+    if (intersectBounds(object.left, object.right, overlap) &&
+      overlap.area() > minOverlap)
+      findSpatialSplit(refs, bounds, spatial);
+  }
+
+  bool useSpatial = spatial.axis >= 0 && spatial.cost < object.cost;
+  const Split& best = useSpatial ? spatial : object;
+  REAL area = bounds.area();
+  REAL leafCost = SAH_INTERSECTION_COST * n;
+  REAL bestCost = FloatInfo<REAL>::inf();
+
+  if (best.axis >= 0)
+    bestCost = area > 0 ?
+      SAH_TRAVERSAL_COST + SAH_INTERSECTION_COST * best.cost / area :
+      SAH_TRAVERSAL_COST + leafCost * (REAL)0.5;
+  if (n <= BVH_MAX_LEAF_SIZE)
+    if ((n <= maxPrimitivesInNode && leafCost <= bestCost) ||
+      best.axis < 0 ||
+      depth >= BVH_MAX_DEPTH - 1)
+      return makeLeaf(refs, bounds);
+
+  References left;
+  References right;
+
+  if (useSpatial)
+  {
+    int duplicates = numberOfDuplicates;
+
+    spatialPartition(refs, spatial, left, right);
+    if (left.empty() || right.empty())
+    {
+      numberOfDuplicates = duplicates;
+      left.clear();
+      right.clear();
+      useSpatial = false;
+    }
+  }
+  if (!useSpatial)
+    objectPartition(refs, cb, object, left, right);
+  References().swap(refs);
+
+  int i = int(nodes.size());
+  BVH::Node node;
+
+  node.bounds = bounds;
+  node.index = 0;
+  node.count = 0;
+  node.axis = uint16(useSpatial ? spatial.axis : dMax<int>(object.axis, 0));
+  nodes.push_back(node);
+  buildNode(left, depth + 1);
+
+  int r = buildNode(right, depth + 1);
+
+  nodes[i].index = r;
+  return i;
+}
@@ -0,0 +1,121 @@
+//[]------------------------------------------------------------------------[]
+//|                                                                          |
+//|                        GVSG Foundation Classes                           |
+//|                               Version 1.0                                |
+//|                                                                          |
+//|              Copyright 2007-2014, Paulo Aristarco Pagliosa              |
+//|              All Rights Reserved.                                        |
+//|                                                                          |
+//[]------------------------------------------------------------------------[]
+//
+//  OVERVIEW: SIMD.cpp
+//  ========
+//  Source file for runtime CPU feature check and aligned memory
+//  allocation.
+
+#include <mutex>
+#include <new>
+#include <stdlib.h>
+#include "SIMD.h"
+
+#ifdef _MSC_VER
+#include <malloc.h>
+#endif
+
+#ifdef SIMD_X86
+#ifdef _MSC_VER
+#include <intrin.h>
+#else
+#include <cpuid.h>
+#endif
+#endif
+
+using namespace System;
+
+static int maxSIMDWidth = 8;
+static int detectedSIMDWidth;
+static std::once_flag detectFlag;
+
+//
+// Auxiliary function
+//
+static int
+detectSIMDWidth()
+{
+#ifdef SIMD_X86
+  int info[4];
+
+#ifdef _MSC_VER
+  __cpuid(info, 1);
+#else
+  __cpuid(1, info[0], info[1], info[2], info[3]);
+#endif
+
+  // AVX needs the OS to save the YMM registers (OSXSAVE and XCR0)
+  if ((info[2] & (1 << 27)) != 0 && (info[2] & (1 << 28)) != 0)
+  {
+#ifdef _MSC_VER
+    unsigned long long xcr0 = _xgetbv(0);
+#else
+    unsigned int eax;
+    unsigned int edx;
+
+    __asm__ __volatile__("xgetbv" : "=a"(eax), "=d"(edx) : "c"(0));
+
+    unsigned long long xcr0 = eax | ((unsigned long long)edx << 32);
+#endif
+
+    if ((xcr0 & 6) == 6)
+      return 8;
+  }
+  return (info[3] & (1 << 26)) != 0 ? 4 : 1;
+#else
+  return 1;
+#endif
+}
+
+int
+System::simdWidth()
+{
+  // Render threads may make the first call concurrently
+  std::call_once(detectFlag, []()
+  {
+    detectedSIMDWidth = detectSIMDWidth();
+  });
+
+  int width = detectedSIMDWidth;
+
+  return width < maxSIMDWidth ? width : maxSIMDWidth;
+}
+
+void
+System::setMaxSIMDWidth(int width)
+{
+  maxSIMDWidth = width < 1 ? 1 : width;
+}
+
+void*
+System::alignedMalloc(size_t size, size_t alignment)
+{
+  void* p;
+
+#ifdef _MSC_VER
+  p = _aligned_malloc(size, alignment);
+#else
+  if (posix_memalign(&p, alignment, size) != 0)
+    p = 0;
+#endif
+  if (p == 0)
+    throw std::bad_alloc();
+  return p;
+}
+
+void
+System::alignedFree(void* p)
+{
+#ifdef _MSC_VER
+  _aligned_free(p);
+#else
+  free(p);
+#endif
+}
@@ -0,0 +1,615 @@
+//[]------------------------------------------------------------------------[]
+//|                                                                          |
+//|                          GVSG Graphics Library                           |
+//|                               Version 1.0                                |
+//|                                                                          |
+//|              Copyright 2007-2014, Paulo Aristarco Pagliosa              |
+//|              All Rights Reserved.                                        |
+//|                                                                          |
+//[]------------------------------------------------------------------------[]
+//
+//  OVERVIEW: Sampler.cpp
+//  ========
+//  Source file for pixel samplers.
+
+#include <math.h>
+#include <vector>
+#include "Random.h"
+#include "Sampler.h"
+#include "SIMD.h"
+
+using namespace Ds;
+using namespace Graphics;
+using namespace System;
+
+#define NUMBER_OF_PRIMES 64
+#define BLUE_NOISE_SIGMA 1.9
+#define ONE_MINUS_EPS    0.99999994f
+
+//
+// Auxiliary functions
+//
+inline uint32
+hashCombine(uint32 seed, uint32 v)
+{
+  return seed ^ (v + (seed << 6) + (seed >> 2));
+}
+
+inline uint32
+pixelHash(int x, int y, uint32 seed)
+{
+  return hashInt(uint32(x) + hashInt(uint32(y) + hashInt(seed)));
+}
+
+inline float
+toFloat(uint32 x)
+{
+  return (x >> 8) * (1.0f / 16777216);
+}
+
+inline uint32
+reverseBits(uint32 x)
+{
+  x = (x << 16) | (x >> 16);
+  x = ((x & 0x00ff00ff) << 8) | ((x & 0xff00ff00) >> 8);
+  x = ((x & 0x0f0f0f0f) << 4) | ((x & 0xf0f0f0f0) >> 4);
+  x = ((x & 0x33333333) << 2) | ((x & 0xcccccccc) >> 2);
+  x = ((x & 0x55555555) << 1) | ((x & 0xaaaaaaaa) >> 1);
+  return x;
+}
+
+// Laine-Karras permutation: the higher bits depend only on the lower
+// ones, as a nested uniform scrambling of the reversed bits
+inline uint32
+laineKarrasPermutation(uint32 x, uint32 seed)
+{
+  x += seed;
+  x ^= x * 0x6c50b47c;
+  x ^= x * 0xb82f1e52;
+  x ^= x * 0xc7afe638;
+  x ^= x * 0x8d22f6e6;
+  return x;
+}
+
+inline uint32
+nestedUniformScramble(uint32 x, uint32 seed)
+{
+  return reverseBits(laineKarrasPermutation(reverseBits(x), seed));
+}
+
+// Generator matrix of the second dimension of Sobol sequence (the
+// first one is the bit reversal), as the products of each byte of an
+// index by the corresponding 8 columns of the matrix
+class SobolMatrix
+{
+public:
+  uint32 products[4][256];
+
+  // Constructor
+  SobolMatrix()
+  {
+    uint32 v[32];
+
+    v[0] = 1u << 31;
+    for (int i = 1; i < 32; i++)
+      v[i] = v[i - 1] ^ (v[i - 1] >> 1);
+    for (int b = 0; b < 4; b++)
+      for (int i = 0; i < 256; i++)
+      {
+        uint32 x = 0;
+
+        for (int k = 0; k < 8; k++)
+          if (i & (1 << k))
+            x ^= v[8 * b + k];
+        products[b][i] = x;
+      }
+  }
+
+}; // SobolMatrix
+
+static const SobolMatrix sobolMatrix;
+
+inline uint32
+sobol(uint32 index, int dim)
+{
+  if (dim == 0)
+    return reverseBits(index);
+  return sobolMatrix.products[0][index & 0xff] ^
+    sobolMatrix.products[1][(index >> 8) & 0xff] ^
+    sobolMatrix.products[2][(index >> 16) & 0xff] ^
+    sobolMatrix.products[3][index >> 24];
+}
+
+// Shuffled, scrambled Sobol value: dimension dim & 1 of the sample
+// index of a pixel (pixelSeed) in the pair of dimensions dim >> 1
+inline uint32
+owenSobol(uint32 index, int dim, uint32 pixelSeed, bool scrambleValue)
+{
+  uint32 pairSeed = hashCombine(pixelSeed, hashInt(uint32(dim >> 1)));
+  uint32 x = sobol(nestedUniformScramble(index, pairSeed), dim & 1);
+
+  if (scrambleValue)
+    x = nestedUniformScramble(x, hashCombine(pairSeed, (dim & 1) + 1));
+  return x;
+}
+
+#ifdef SIMD_X86
+
+inline __m128i
+mul32(__m128i a, __m128i b)
+{
+  // Low 32 bits of the products (SSE2 lacks _mm_mullo_epi32)
+  __m128i p02 = _mm_mul_epu32(a, b);
+  __m128i p13 = _mm_mul_epu32(_mm_srli_si128(a, 4), _mm_srli_si128(b, 4));
+
+  return _mm_unpacklo_epi32(_mm_shuffle_epi32(p02, _MM_SHUFFLE(0, 0, 2, 0)),
+    _mm_shuffle_epi32(p13, _MM_SHUFFLE(0, 0, 2, 0)));
+}
+
+inline __m128i
+swapBits(__m128i x, uint32 mask, int shift)
+{
+  __m128i m = _mm_set1_epi32(int(mask));
+
+  return _mm_or_si128(_mm_slli_epi32(_mm_and_si128(x, m), shift),
+    _mm_and_si128(_mm_srli_epi32(x, shift), m));
+}
+
+inline __m128i
+reverseBits(__m128i x)
+{
+  x = _mm_or_si128(_mm_slli_epi32(x, 16), _mm_srli_epi32(x, 16));
+  x = swapBits(x, 0x00ff00ff, 8);
+  x = swapBits(x, 0x0f0f0f0f, 4);
+  x = swapBits(x, 0x33333333, 2);
+  return swapBits(x, 0x55555555, 1);
+}
+
+inline __m128i
+xorMul(__m128i x, uint32 c)
+{
+  return _mm_xor_si128(x, mul32(x, _mm_set1_epi32(int(c))));
+}
+
+inline __m128i
+nestedUniformScramble(__m128i x, uint32 seed)
+{
+  x = _mm_add_epi32(reverseBits(x), _mm_set1_epi32(int(seed)));
+  x = xorMul(x, 0x6c50b47c);
+  x = xorMul(x, 0xb82f1e52);
+  x = xorMul(x, 0xc7afe638);
+  x = xorMul(x, 0x8d22f6e6);
+  return reverseBits(x);
+}
+
+inline __m128i
+sobol(__m128i index, int dim)
+{
+  if (dim == 0)
+    return reverseBits(index);
+
+  // Table lookups (SSE2 has no gather)
+  uint32 x[4];
+
+  _mm_storeu_si128((__m128i*)x, index);
+  for (int i = 0; i < 4; i++)
+    x[i] = sobol(x[i], 1);
+  return _mm_loadu_si128((const __m128i*)x);
+}
+
+inline __m128
+toFloat(__m128i x)
+{
+  return _mm_mul_ps(_mm_cvtepi32_ps(_mm_srli_epi32(x, 8)),
+    _mm_set1_ps(1.0f / 16777216));
+}
+
+#endif // SIMD_X86
+
+//
+// Generate the Owen-scrambled (or only shuffled) Sobol values of the
+// samples [first, first + n) of a pixel
+//
+static void
+owenSobol(uint32 first,
+  int n,
+  int dim,
+  uint32 pixelSeed,
+  bool scrambleValue,
+  float* values)
+{
+  int i = 0;
+
+#ifdef SIMD_X86
+  uint32 pairSeed = hashCombine(pixelSeed, hashInt(uint32(dim >> 1)));
+  uint32 valueSeed = hashCombine(pairSeed, (dim & 1) + 1);
+  __m128i index = _mm_add_epi32(_mm_set1_epi32(int(first)),
+    _mm_set_epi32(3, 2, 1, 0));
+  __m128i four = _mm_set1_epi32(4);
+
+  for (; i + 4 <= n; i += 4)
+  {
+    __m128i x = sobol(nestedUniformScramble(index, pairSeed), dim & 1);
+
+    if (scrambleValue)
+      x = nestedUniformScramble(x, valueSeed);
+    _mm_storeu_ps(values + i, toFloat(x));
+    index = _mm_add_epi32(index, four);
+  }
+#endif // SIMD_X86
+  for (; i < n; i++)
+    values[i] = toFloat(owenSobol(first + i, dim, pixelSeed, scrambleValue));
+}
+
+
+//////////////////////////////////////////////////////////
+//
+// Sampler implementation
+// =======
+void
+Sampler::generate(int x, int y,
+  uint32 first,
+  int n,
+  int dim,
+  float* values) const
+//[]---------------------------------------------------[]
+//|  Generate a batch of samples                        |
+//[]---------------------------------------------------[]
+{
+  for (int i = 0; i < n; i++)
+    values[i] = sample(x, y, first + i, dim);
+}
+
+
+//////////////////////////////////////////////////////////
+//
+// IndependentSampler implementation
+// ==================
+float
+IndependentSampler::sample(int x, int y, uint32 index, int dim) const
+//[]---------------------------------------------------[]
+//|  Sample                                             |
+//[]---------------------------------------------------[]
+{
+  return toFloat(hashInt(pixelHash(x, y, index) + hashInt(uint32(dim))));
+}
+
+
+//////////////////////////////////////////////////////////
+//
+// SobolSampler implementation
+// ============
+float
+SobolSampler::sample(int x, int y, uint32 index, int dim) const
+//[]---------------------------------------------------[]
+//|  Sample                                             |
+//[]---------------------------------------------------[]
+{
+  return toFloat(owenSobol(index, dim, pixelHash(x, y, seed), true));
+}
+
+void
+SobolSampler::generate(int x, int y,
+  uint32 first,
+  int n,
+  int dim,
+  float* values) const
+//[]---------------------------------------------------[]
+//|  Generate a batch of samples                        |
+//[]---------------------------------------------------[]
+{
+  owenSobol(first, n, dim, pixelHash(x, y, seed), true, values);
+}
+
+
+//////////////////////////////////////////////////////////
+//
+// HaltonSampler implementation
+// =============
+static const uint16 primes[NUMBER_OF_PRIMES] =
+{
+    2,   3,   5,   7,  11,  13,  17,  19,  23,  29,  31,  37,  41,  43,
+   47,  53,  59,  61,  67,  71,  73,  79,  83,  89,  97, 101, 103, 107,
+  109, 113, 127, 131, 137, 139, 149, 151, 157, 163, 167, 173, 179, 181,
+  191, 193, 197, 199, 211, 223, 227, 229, 233, 239, 241, 251, 257, 263,
+  269, 271, 277, 281, 283, 293, 307, 311
+};
+
+HaltonSampler::HaltonSampler(uint32 aSeed):
+  seed(aSeed)
+//[]---------------------------------------------------[]
+//|  Constructor                                        |
+//[]---------------------------------------------------[]
+{
+  offsets = new int[NUMBER_OF_PRIMES + 1];
+  offsets[0] = 0;
+  for (int i = 0; i < NUMBER_OF_PRIMES; i++)
+    offsets[i + 1] = offsets[i] + primes[i];
+  permutations = new uint16[offsets[NUMBER_OF_PRIMES]];
+
+  Random rng(seed);
+
+  for (int i = 0; i < NUMBER_OF_PRIMES; i++)
+  {
+    uint16* p = permutations + offsets[i];
+    int b = primes[i];
+
+    for (int d = 0; d < b; d++)
+      p[d] = uint16(d);
+    // Fisher-Yates shuffle
+    for (int d = b - 1; d > 0; d--)
+      dSwap<uint16>(p[d], p[rng.nextInt() % (d + 1)]);
+  }
+}
+
+HaltonSampler::~HaltonSampler()
+//[]---------------------------------------------------[]
+//|  Destructor                                         |
+//[]---------------------------------------------------[]
+{
+  delete []permutations;
+  delete []offsets;
+}
+
+float
+HaltonSampler::sample(int x, int y, uint32 index, int dim) const
+//[]---------------------------------------------------[]
+//|  Sample                                             |
+//|                                                     |
+//|  Scrambled radical inverse; the infinitely many     |
+//|  leading zeros of the index are permuted too, which |
+//|  adds a geometric series. The dimensions from the   |
+//|  64th on are independent random numbers.            |
+//[]---------------------------------------------------[]
+{
+  uint32 h = hashInt(pixelHash(x, y, seed) + hashInt(uint32(dim)));
+
+  if (dim >= NUMBER_OF_PRIMES)
+    return toFloat(h);
+
+  const uint16* p = permutations + offsets[dim];
+  uint32 b = primes[dim];
+  double invBase = 1.0 / b;
+  double invBaseN = 1;
+  double r = 0;
+
+  for (uint32 a = index; a != 0;)
+  {
+    uint32 next = a / b;
+
+    r = r * b + p[a - next * b];
+    invBaseN *= invBase;
+    a = next;
+  }
+  r = invBaseN * (r + invBase * p[0] / (1 - invBase));
+  // Cranley-Patterson rotation
+  r += toFloat(h);
+  if (r >= 1)
+    r -= 1;
+  return dMin<float>(float(r), ONE_MINUS_EPS);
+}
+
+
+//////////////////////////////////////////////////////////
+//
+// BlueNoiseSampler implementation
+// ================
+BlueNoiseSampler::BlueNoiseSampler(uint32 aSeed):
+  seed(aSeed)
+//[]---------------------------------------------------[]
+//|  Constructor                                        |
+//|                                                     |
+//|  Void-and-cluster: the energy of a cell is the sum  |
+//|  of a toroidal Gaussian of the distances to the     |
+//|  points. Starting from a random set of 10% of the   |
+//|  cells, the point in the tightest cluster (highest  |
+//|  energy) is moved to the largest void (lowest       |
+//|  energy) until it stays put. The points are then    |
+//|  ranked by removing the tightest clusters one by    |
+//|  one, and the other cells by filling the largest    |
+//|  voids; the mask value of a cell is its rank.       |
+//[]---------------------------------------------------[]
+{
+  const int s = BLUE_NOISE_TILE_SIZE;
+  const int n = s * s;
+  std::vector<double> gaussian(n);
+  std::vector<double> energy(n, 0);
+  std::vector<char> points(n, 0);
+  std::vector<int> rank(n);
+
+  for (int y = 0; y < s; y++)
+    for (int x = 0; x < s; x++)
+    {
+      int dx = dMin<int>(x, s - x);
+      int dy = dMin<int>(y, s - y);
+
+      gaussian[y * s + x] =
+        exp(-(dx * dx + dy * dy) / (2 * BLUE_NOISE_SIGMA * BLUE_NOISE_SIGMA));
+    }
+
+  // Add (sign = 1) or remove (sign = -1) the point at cell c
+  auto splat = [&](int c, double sign)
+  {
+    int cx = c % s;
+    int cy = c / s;
+
+    points[c] = sign > 0;
+    for (int y = 0; y < s; y++)
+    {
+      int gy = ((y - cy) & (s - 1)) * s;
+
+      for (int x = 0; x < s; x++)
+        energy[y * s + x] += sign * gaussian[gy + ((x - cx) & (s - 1))];
+    }
+  };
+  // Tightest cluster (value = 1) or largest void (value = 0)
+  auto extreme = [&](char value) -> int
+  {
+    int best = -1;
+
+    for (int c = 0; c < n; c++)
+      if (points[c] == value && (best < 0 ||
+        (value ? energy[c] > energy[best] : energy[c] < energy[best])))
+        best = c;
+    return best;
+  };
+
+  Random rng(seed);
+  int numberOfPoints = n / 10;
+
+  for (int i = 0; i < numberOfPoints;)
+  {
+    int c = int(rng.nextInt() % n);
+
+    if (!points[c])
+    {
+      splat(c, 1);
+      i++;
+    }
+  }
+  for (;;)
+  {
+    int cluster = extreme(1);
+
+    splat(cluster, -1);
+
+    int hole = extreme(0);
+
+    splat(hole, 1);
+    if (hole == cluster)
+      break;
+  }
+
+  std::vector<char> initialPoints(points);
+  std::vector<double> initialEnergy(energy);
+
+  for (int r = numberOfPoints - 1; r >= 0; r--)
+  {
+    int c = extreme(1);
+
+    splat(c, -1);
+    rank[c] = r;
+  }
+  points.swap(initialPoints);
+  energy.swap(initialEnergy);
+  for (int r = numberOfPoints; r < n; r++)
+  {
+    int c = extreme(0);
+
+    splat(c, 1);
+    rank[c] = r;
+  }
+  for (int c = 0; c < n; c++)
+    mask[c] = (rank[c] + 0.5f) / n;
+}
+
+inline float
+BlueNoiseSampler::maskValue(int x, int y, int dim) const
+{
+  // Toroidal shift of the tile for the dimension
+  uint32 h = hashInt(hashCombine(seed, uint32(dim)));
+  int mx = (x + int(h)) & (BLUE_NOISE_TILE_SIZE - 1);
+  int my = (y + int(h >> 16)) & (BLUE_NOISE_TILE_SIZE - 1);
+
+  return mask[my * BLUE_NOISE_TILE_SIZE + mx];
+}
+
+float
+BlueNoiseSampler::sample(int x, int y, uint32 index, int dim) const
+//[]---------------------------------------------------[]
+//|  Sample                                             |
+//[]---------------------------------------------------[]
+{
+  float v = toFloat(owenSobol(index, dim, seed, false)) +
+    maskValue(x, y, dim);
+
+  return v >= 1 ? dMin<float>(v - 1, ONE_MINUS_EPS) : v;
+}
+
+void
+BlueNoiseSampler::generate(int x, int y,
+  uint32 first,
+  int n,
+  int dim,
+  float* values) const
+//[]---------------------------------------------------[]
+//|  Generate a batch of samples                        |
+//[]---------------------------------------------------[]
+{
+  float offset = maskValue(x, y, dim);
+
+  owenSobol(first, n, dim, seed, false, values);
+  for (int i = 0; i < n; i++)
+  {
+    float v = values[i] + offset;
+
+    values[i] = v >= 1 ? dMin<float>(v - 1, ONE_MINUS_EPS) : v;
+  }
+}
+
+
+//////////////////////////////////////////////////////////
+//
+// PixelSampler implementation
+// ============
+PixelSampler::PixelSampler(const Sampler& aSampler, int dims):
+  sampler(aSampler),
+  tableDimensions(dims),
+  table(0),
+  capacity(0),
+  x(0),
+  y(0),
+  first(0),
+  numberOfSamples(0),
+  numberOfRows(0),
+  current(0),
+  dimension(0)
+//[]---------------------------------------------------[]
+//|  Constructor                                        |
+//[]---------------------------------------------------[]
+{
+  // do nothing
+}
+
+PixelSampler::~PixelSampler()
+//[]---------------------------------------------------[]
+//|  Destructor                                         |
+//[]---------------------------------------------------[]
+{
+  delete []table;
+}
+
+void
+PixelSampler::startPixel(int px, int py, uint32 firstSample, int n)
+//[]---------------------------------------------------[]
+//|  Start pixel                                        |
+//[]---------------------------------------------------[]
+{
+  if (n > capacity)
+  {
+    delete []table;
+    table = new float[tableDimensions * n];
+    capacity = n;
+  }
+  x = px;
+  y = py;
+  first = firstSample;
+  numberOfSamples = n;
+  numberOfRows = 0;
+  startSample(0);
+}
+
+float
+PixelSampler::generateRows(int d)
+//[]---------------------------------------------------[]
+//|  Generate the dimensions up to d of all the samples |
+//|  of the pixel and get dimension d of the current    |
+//|  sample                                             |
+//[]---------------------------------------------------[]
+{
+  if (d >= tableDimensions)
+    return sampler.sample(x, y, first + current, d);
+  for (int n = numberOfSamples; numberOfRows <= d; numberOfRows++)
+    sampler.generate(x, y, first, n, numberOfRows, table + numberOfRows * n);
+  return table[d * numberOfSamples + current];
+}
@@ -0,0 +1,90 @@
+//[]------------------------------------------------------------------------[]
+//|                                                                          |
+//|                          GVSG Graphics Library                           |
+//|                               Version 1.0                                |
+//|                                                                          |
+//|              Copyright 2007-2014, Paulo Aristarco Pagliosa              |
+//|              All Rights Reserved.                                        |
+//|                                                                          |
+//[]------------------------------------------------------------------------[]
+//
+//  OVERVIEW: SamplerBenchmark.cpp
+//  ========
+//  Source file for sampler benchmark.
+
+#include <math.h>
+#include <vector>
+#include "PathTracer.h"
+#include "SamplerBenchmark.h"
+
+using namespace Graphics;
+
+#define NUMBER_OF_SAMPLERS 4
+
+//
+// Auxiliary function
+//
+static double
+rmse(const Color* image, const std::vector<Color>& reference)
+{
+  double sum = 0;
+  int n = int(reference.size());
+
+  for (int i = 0; i < n; i++)
+  {
+    Color d = image[i] - reference[i];
+
+    sum += d.r * d.r + d.g * d.g + d.b * d.b;
+  }
+  return sqrt(sum / (3.0 * n));
+}
+
+void
+Graphics::benchmarkSamplers(Scene& scene,
+  Camera* camera,
+  int W,
+  int H,
+  int maxSamples,
+  int referenceSamples,
+  FILE* f)
+{
+  PathTracer pt(scene, camera);
+
+  pt.setImageSize(W, H);
+  // Reference image, with a sampler unrelated to the tested ones
+  pt.setSampler(new SobolSampler(0x9e3779b9));
+  pt.samplesPerPixel = referenceSamples;
+  pt.render();
+
+  const Color* image = pt.getFrameBuffer();
+  std::vector<Color> reference(image, image + W * H);
+  ObjectPtr<Sampler> samplers[NUMBER_OF_SAMPLERS] =
+  {
+    new IndependentSampler(),
+    new SobolSampler(),
+    new HaltonSampler(),
+    new BlueNoiseSampler()
+  };
+
+  fprintf(f, "Sampler RMSE (%dx%d, reference: %d spp, %.2f s)\n",
+    W,
+    H,
+    referenceSamples,
+    pt.getSampleTime());
+  fprintf(f, "%6s", "spp");
+  for (int s = 0; s < NUMBER_OF_SAMPLERS; s++)
+    fprintf(f, " %12s", samplers[s]->getName());
+  fprintf(f, "\n");
+  for (int spp = 1; spp <= maxSamples; spp *= 2)
+  {
+    fprintf(f, "%6d", spp);
+    for (int s = 0; s < NUMBER_OF_SAMPLERS; s++)
+    {
+      pt.setSampler(samplers[s]);
+      pt.samplesPerPixel = spp;
+      pt.render();
+      fprintf(f, " %12.6f", rmse(pt.getFrameBuffer(), reference));
+    }
+    fprintf(f, "\n");
+  }
+}
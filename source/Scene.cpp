@@ -66,6 +66,7 @@ Scene::addActor(Actor* actor)
     System::makeUse(actor);
     if (!modifiedBounds)
       bounds.inflate(actor->model->boundingBox());
+    timestamp++;
   }
 }
 
@@ -81,6 +82,7 @@ Scene::deleteActor(Actor* actor)
     actor->scene = 0;
     actor->release();
     modifiedBounds = true;
+    timestamp++;
   }
 }
 
@@ -95,6 +97,7 @@ Scene::addLight(Light* light)
     lights.add(light);
     light->scene = this;
     System::makeUse(light);
+    timestamp++;
   }
 }
 
@@ -109,6 +112,7 @@ Scene::deleteLight(Light* light)
     lights.remove(*light);
     light->scene = 0;
     light->release();
+    timestamp++;
   }
 }
 
@@ -126,6 +130,7 @@ Scene::deleteActors()
   }
   bounds.setEmpty();
   modifiedBounds = false;
+  timestamp++;
 }
 
 void
@@ -140,6 +145,7 @@ Scene::deleteLights()
     light->scene = 0;
     light->release();
   }
+  timestamp++;
 }
 
 inline void
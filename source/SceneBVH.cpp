@@ -0,0 +1,564 @@
+//[]------------------------------------------------------------------------[]
+//|                                                                          |
+//|                          GVSG Graphics Library                           |
+//|                               Version 1.0                                |
+//|                                                                          |
+//|              Copyright 2007-2014, Paulo Aristarco Pagliosa              |
+//|              All Rights Reserved.                                        |
+//|                                                                          |
+//[]------------------------------------------------------------------------[]
+//
+//  OVERVIEW: SceneBVH.cpp
+//  ========
+//  Source file for two-level scene BVH.
+
+#include <memory.h>
+#include "BVHCache.h"
+#include "LBVHBuilder.h"
+#include "SBVHBuilder.h"
+#include "SceneBVH.h"
+#include "TreeletOptimizer.h"
+
+using namespace Graphics;
+
+//
+// Auxiliary functions
+//
+inline const AnalyticShape*
+visibleShape(const Actor* actor)
+{
+  if (!actor->isVisible())
+    return 0;
+  return dynamic_cast<const AnalyticShape*>(actor->getModel());
+}
+
+inline TriangleMesh*
+visibleMesh(const Actor* actor)
+{
+  // The mesh of an analytic shape is only a tessellation for display
+  if (!actor->isVisible() || visibleShape(actor) != 0)
+    return 0;
+  return (TriangleMesh*)actor->getModel()->triangleMesh();
+}
+
+inline bool
+isEqual(const mat4& a, const mat4& b)
+{
+  return memcmp(&a, &b, sizeof(mat4)) == 0;
+}
+
+// Normal at a hit of an instance (in instance coordinates)
+inline vec3
+hitNormal(const SceneBVH::Instance& instance, const Intersection& hit)
+{
+  if (instance.shape != 0)
+    return hit.normal;
+
+  const TriangleMesh::Data& data = instance.bvh->getMesh()->getData();
+
+  return data.normalAt(data.triangles + hit.triangleIndex, hit.p);
+}
+
+
+//////////////////////////////////////////////////////////
+//
+// SceneBVH implementation
+// ========
+SceneBVH::SceneBVH(Scene& aScene):
+  spatialSplits(false),
+  optimizeTreelets(false),
+  ownDynamicBVHs(false),
+  scene(&aScene),
+  instances(0),
+  numberOfInstances(0)
+//[]---------------------------------------------------[]
+//|  Constructor                                        |
+//[]---------------------------------------------------[]
+{
+  // do nothing
+}
+
+SceneBVH::~SceneBVH()
+//[]---------------------------------------------------[]
+//|  Destructor                                         |
+//[]---------------------------------------------------[]
+{
+  delete []instances;
+}
+
+bool
+SceneBVH::isUpToDate() const
+//[]---------------------------------------------------[]
+//|  Check if the instances match the scene actors      |
+//[]---------------------------------------------------[]
+{
+  if (numberOfNodes == 0 && numberOfInstances != 0)
+    return false;
+
+  int i = 0;
+
+  for (ActorIterator ait(scene->getActorIterator()); ait;)
+  {
+    Actor* a = ait++;
+    const AnalyticShape* shape = visibleShape(a);
+    TriangleMesh* mesh = visibleMesh(a);
+
+    if (shape == 0 && mesh == 0)
+      continue;
+    if (i == numberOfInstances || a->isDynamic())
+      return false;
+
+    const Instance& instance = instances[i++];
+
+    if (instance.actor != a || instance.shape != shape)
+      return false;
+    if (mesh != 0 && instance.bvh != getBVH(mesh))
+      return false;
+    if (!isEqual(instance.matrix, a->getModel()->getMatrix()))
+      return false;
+  }
+  return i == numberOfInstances;
+}
+
+void
+SceneBVH::rebuild()
+//[]---------------------------------------------------[]
+//|  Rebuild instances and top level                    |
+//[]---------------------------------------------------[]
+{
+  delete []instances;
+  instances = new Instance[scene->getNumberOfActors()];
+  numberOfInstances = 0;
+
+  double meshBuildTime = 0;
+  TriangleMeshBVH** rebuilt = new TriangleMeshBVH*[scene->getNumberOfActors()];
+  int numberOfRebuilt = 0;
+  LBVHBuilder lbvhBuilder;
+
+  if (ownDynamicBVHs)
+    meshBuildTime += updateOwnedBVHs(lbvhBuilder);
+  for (ActorIterator ait(scene->getActorIterator()); ait;)
+  {
+    Actor* a = ait++;
+    const AnalyticShape* shape = visibleShape(a);
+    TriangleMesh* mesh = visibleMesh(a);
+
+    if (shape == 0 && mesh == 0)
+      continue;
+
+    Instance& instance = instances[numberOfInstances++];
+
+    instance.actor = a;
+    instance.shape = shape;
+    instance.matrix = a->getModel()->getMatrix();
+    instance.matrix.inverse(instance.inverseMatrix);
+    if (shape != 0)
+    {
+      instance.bvh = 0;
+      continue;
+    }
+
+    TriangleMeshBVH* bvh = getBVH(mesh);
+    TriangleMeshBVH* owned = ownedBVH(mesh);
+
+    if (owned != 0)
+      // Already refitted by updateOwnedBVHs()
+      bvh = owned;
+    else if (a->isDynamic())
+    {
+      // Rebuild each dynamic mesh once, even if shared by many actors
+      int k = 0;
+
+      while (k < numberOfRebuilt && rebuilt[k] != bvh)
+        k++;
+      if (k == numberOfRebuilt)
+      {
+        if (bvh == 0)
+          bvh = meshBVH(mesh, lbvhBuilder);
+        else
+          bvh->refit(lbvhBuilder);
+        rebuilt[numberOfRebuilt++] = bvh;
+        meshBuildTime += bvh->getBuildTime();
+      }
+    }
+    else if (bvh == 0)
+    {
+      BinnedSAHBuilder binnedBuilder;
+      SBVHBuilder sbvhBuilder(mesh->getData());
+      BVHBuilder* builder = &binnedBuilder;
+
+      if (spatialSplits)
+        builder = &sbvhBuilder;
+
+      TreeletOptimizer optimizer(*builder);
+
+      if (optimizeTreelets)
+        builder = &optimizer;
+
+      BVHCache cache(*builder, mesh->getData(), cacheDirectory);
+
+      if (!cacheDirectory.empty())
+        builder = &cache;
+      bvh = meshBVH(mesh, *builder);
+      meshBuildTime += bvh->getBuildTime();
+    }
+    instance.bvh = bvh;
+  }
+
+  int n = numberOfInstances;
+  BVHBuilder::Reference* refs = new BVHBuilder::Reference[n];
+
+  for (int i = 0; i < n; i++)
+  {
+    const Instance& instance = instances[i];
+
+    refs[i].bounds = Bounds3(instance.shape != 0 ?
+      instance.shape->getBounds() :
+      instance.bvh->bounds(), instance.matrix);
+    refs[i].centroid = refs[i].bounds.center();
+    refs[i].index = i;
+  }
+
+  SAHBuilder builder(1);
+
+  builder.build(*this, refs, n);
+  buildTime += meshBuildTime;
+  delete []refs;
+  delete []rebuilt;
+}
+
+double
+SceneBVH::updateOwnedBVHs(BVHBuilder& builder)
+//[]---------------------------------------------------[]
+//|  Update owned BVHs                                  |
+//|                                                     |
+//|  Build or refit the BVHs of the meshes of the       |
+//|  dynamic actors, and release the ones of the meshes |
+//|  no longer used by dynamic actors. Return the build |
+//|  time.                                              |
+//[]---------------------------------------------------[]
+{
+  std::vector<ObjectPtr<TriangleMeshBVH>> bvhs;
+  double buildTime = 0;
+
+  for (ActorIterator ait(scene->getActorIterator()); ait;)
+  {
+    Actor* a = ait++;
+    TriangleMesh* mesh = visibleMesh(a);
+
+    if (mesh == 0 || !a->isDynamic())
+      continue;
+
+    // Refit each dynamic mesh once, even if shared by many actors
+    size_t k = 0;
+
+    while (k < bvhs.size() && bvhs[k]->getMesh() != mesh)
+      k++;
+    if (k < bvhs.size())
+      continue;
+
+    TriangleMeshBVH* bvh = ownedBVH(mesh);
+
+    if (bvh == 0)
+      bvh = new TriangleMeshBVH(mesh, builder);
+    else
+      bvh->refit(builder);
+    bvhs.push_back(bvh);
+    buildTime += bvh->getBuildTime();
+  }
+  ownedBVHs.swap(bvhs);
+  return buildTime;
+}
+
+TriangleMeshBVH*
+SceneBVH::ownedBVH(const TriangleMesh* mesh) const
+//[]---------------------------------------------------[]
+//|  Owned BVH of a mesh, if any                        |
+//[]---------------------------------------------------[]
+{
+  for (size_t i = 0; i < ownedBVHs.size(); i++)
+    if (ownedBVHs[i]->getMesh() == mesh)
+      return ownedBVHs[i];
+  return 0;
+}
+
+bool
+SceneBVH::update()
+//[]---------------------------------------------------[]
+//|  Update                                             |
+//[]---------------------------------------------------[]
+{
+  if (isUpToDate())
+    return false;
+  rebuild();
+  return true;
+}
+
+//
+// Auxiliary class
+//
+class InstanceIntersector
+{
+public:
+  const SceneBVH::Instance* closest;
+
+  // Constructor
+  InstanceIntersector(const SceneBVH::Instance* anInstances,
+    Intersection& aHit,
+    bool aWatertight):
+    closest(0),
+    instances(anInstances),
+    hit(aHit),
+    watertight(aWatertight)
+  {
+    // do nothing
+  }
+
+  bool operator ()(int i, Ray& ray)
+  {
+    const SceneBVH::Instance& instance = instances[i];
+    Ray r = ray.transform(instance.inverseMatrix);
+
+    if (instance.shape != 0)
+    {
+      if (!instance.shape->intersect(r, hit))
+        return false;
+      hit.triangleIndex = -1;
+    }
+    else if (!instance.bvh->intersect(r, hit, watertight))
+      return false;
+    ray.tMax = hit.distance;
+    closest = &instance;
+    return true;
+  }
+
+private:
+  const SceneBVH::Instance* instances;
+  Intersection& hit;
+  bool watertight;
+
+  InstanceIntersector& operator =(const InstanceIntersector&);
+
+}; // InstanceIntersector
+
+bool
+SceneBVH::intersect(const Ray& ray,
+  Intersection& hit,
+  bool watertight) const
+//[]---------------------------------------------------[]
+//|  Closest intersection                               |
+//[]---------------------------------------------------[]
+{
+  Ray r = ray;
+  InstanceIntersector intersector(instances, hit, watertight);
+
+  hit.distance = ray.tMax;
+  if (!BVH::intersect(r, intersector))
+    return false;
+
+  const SceneBVH::Instance* instance = intersector.closest;
+
+  hit.actor = instance->actor;
+  hit.normal = transformNormal(instance->inverseMatrix,
+    hitNormal(*instance, hit));
+  return true;
+}
+
+//
+// Auxiliary class
+//
+class InstanceOccluder
+{
+public:
+  // Constructor
+  InstanceOccluder(const SceneBVH::Instance* anInstances, bool aWatertight):
+    instances(anInstances),
+    watertight(aWatertight)
+  {
+    // do nothing
+  }
+
+  bool operator ()(int i, const Ray& ray) const
+  {
+    const SceneBVH::Instance& instance = instances[i];
+    Ray r = ray.transform(instance.inverseMatrix);
+
+    if (instance.shape != 0)
+    {
+      Intersection hit;
+
+      return instance.shape->intersect(r, hit);
+    }
+    return instance.bvh->occluded(r, ray.tMax, watertight);
+  }
+
+private:
+  const SceneBVH::Instance* instances;
+  bool watertight;
+
+}; // InstanceOccluder
+
+bool
+SceneBVH::occluded(const Ray& ray, REAL tMax, bool watertight) const
+//[]---------------------------------------------------[]
+//|  Any intersection                                   |
+//[]---------------------------------------------------[]
+{
+  Ray r = ray;
+  InstanceOccluder occluder(instances, watertight);
+
+  r.tMax = tMax;
+  return BVH::occluded(r, occluder);
+}
+
+//
+// Auxiliary classes
+//
+class PacketInstanceIntersector
+{
+public:
+  const SceneBVH::Instance* closest[RAY_PACKET_SIZE];
+
+  // Constructor
+  PacketInstanceIntersector(const SceneBVH::Instance* anInstances,
+    Intersection* aHits):
+    instances(anInstances),
+    hits(aHits)
+  {
+    // do nothing
+  }
+
+  int operator ()(int i, RayPacket& packet, int mask)
+  {
+    const SceneBVH::Instance& instance = instances[i];
+    RayPacket p;
+
+    p.transform(packet, instance.inverseMatrix);
+
+    int m = 0;
+
+    if (instance.shape == 0)
+      m = instance.bvh->intersect(p, mask, hits);
+    else
+      for (int k = mask; k != 0; k &= k - 1)
+      {
+        int j = lowestBit(k);
+
+        if (instance.shape->intersect(p.getRay(j), hits[j]))
+        {
+          p.tMax[j] = hits[j].distance;
+          hits[j].triangleIndex = -1;
+          m |= 1 << j;
+        }
+      }
+
+    for (int k = m; k != 0; k &= k - 1)
+    {
+      int j = lowestBit(k);
+
+      packet.tMax[j] = p.tMax[j];
+      closest[j] = &instance;
+    }
+    return m;
+  }
+
+private:
+  const SceneBVH::Instance* instances;
+  Intersection* hits;
+
+  PacketInstanceIntersector& operator =(const PacketInstanceIntersector&);
+
+}; // PacketInstanceIntersector
+
+class PacketInstanceOccluder
+{
+public:
+  // Constructor
+  PacketInstanceOccluder(const SceneBVH::Instance* anInstances):
+    instances(anInstances)
+  {
+    // do nothing
+  }
+
+  int operator ()(int i, const RayPacket& packet, int mask) const
+  {
+    const SceneBVH::Instance& instance = instances[i];
+    RayPacket p;
+
+    p.transform(packet, instance.inverseMatrix);
+    if (instance.shape == 0)
+      return instance.bvh->occluded(p, mask);
+
+    int m = 0;
+
+    for (int k = mask; k != 0; k &= k - 1)
+    {
+      int j = lowestBit(k);
+      Intersection hit;
+
+      if (instance.shape->intersect(p.getRay(j), hit))
+        m |= 1 << j;
+    }
+    return m;
+  }
+
+private:
+  const SceneBVH::Instance* instances;
+
+}; // PacketInstanceOccluder
+
+int
+SceneBVH::intersect(const RayPacket& packet, Intersection* hits) const
+//[]---------------------------------------------------[]
+//|  Closest intersections of a packet                  |
+//[]---------------------------------------------------[]
+{
+  RayPacket p = packet;
+  PacketInstanceIntersector intersector(instances, hits);
+  int mask = p.getMask();
+  int m;
+
+  for (int i = 0; i < p.size; i++)
+    hits[i].distance = p.tMax[i];
+  switch (simdWidth())
+  {
+    case 8:
+      m = BVH::intersect<8>(p, mask, intersector);
+      break;
+    case 4:
+      m = BVH::intersect<4>(p, mask, intersector);
+      break;
+    default:
+      m = BVH::intersect<1>(p, mask, intersector);
+  }
+  for (int k = m; k != 0; k &= k - 1)
+  {
+    int i = lowestBit(k);
+    const SceneBVH::Instance* instance = intersector.closest[i];
+    Intersection& hit = hits[i];
+
+    hit.actor = instance->actor;
+    hit.normal = transformNormal(instance->inverseMatrix,
+      hitNormal(*instance, hit));
+  }
+  return m;
+}
+
+int
+SceneBVH::occluded(const RayPacket& packet) const
+//[]---------------------------------------------------[]
+//|  Any intersection of a packet                       |
+//[]---------------------------------------------------[]
+{
+  PacketInstanceOccluder occluder(instances);
+  int mask = packet.getMask();
+
+  switch (simdWidth())
+  {
+    case 8:
+      return BVH::occluded<8>(packet, mask, occluder);
+    case 4:
+      return BVH::occluded<4>(packet, mask, occluder);
+  }
+  return BVH::occluded<1>(packet, mask, occluder);
+}
@@ -0,0 +1,130 @@
+//[]------------------------------------------------------------------------[]
+//|                                                                          |
+//|                          GVSG Graphics Library                           |
+//|                               Version 1.0                                |
+//|                                                                          |
+//|              Copyright 2007-2014, Paulo Aristarco Pagliosa              |
+//|              All Rights Reserved.                                        |
+//|                                                                          |
+//[]------------------------------------------------------------------------[]
+//
+//  OVERVIEW: SceneQuery.cpp
+//  ========
+//  Source file for batch scene ray queries.
+
+#include <atomic>
+#include "SceneQuery.h"
+
+using namespace Graphics;
+
+//
+// Auxiliary functions
+//
+inline Ray
+batchRay(const RayBatch& rays, int i)
+{
+  const REAL* const* o = rays.origin;
+  const REAL* const* d = rays.direction;
+
+  return Ray(vec3(o[0][i], o[1][i], o[2][i]),
+    vec3(d[0][i], d[1][i], d[2][i]),
+    0,
+    rays.tMax != 0 ? rays.tMax[i] : FloatInfo<REAL>::inf());
+}
+
+inline int
+numberOfChunks(const RayBatch& rays)
+{
+  return (rays.size + RAY_QUERY_CHUNK_SIZE - 1) / RAY_QUERY_CHUNK_SIZE;
+}
+
+
+//////////////////////////////////////////////////////////
+//
+// SceneQuery implementation
+// ==========
+SceneQuery::SceneQuery(Scene& scene):
+  watertight(false),
+  bvh(new SceneBVH(scene))
+//[]---------------------------------------------------[]
+//|  Constructor                                        |
+//[]---------------------------------------------------[]
+{
+  // The renderers refit the shared BVHs of the dynamic meshes in place
+  bvh->ownDynamicBVHs = true;
+}
+
+bool
+SceneQuery::update()
+//[]---------------------------------------------------[]
+//|  Update                                             |
+//[]---------------------------------------------------[]
+{
+  return bvh->update();
+}
+
+int
+SceneQuery::intersect(const RayBatch& rays, const HitBatch& hits) const
+//[]---------------------------------------------------[]
+//|  Closest hits of a batch                            |
+//[]---------------------------------------------------[]
+{
+  std::atomic<int> count(0);
+
+  parallelFor(rays.size, numberOfChunks(rays),
+    [this, &rays, &hits, &count](int, int begin, int end)
+  {
+    int n = 0;
+
+    for (int i = begin; i < end; i++)
+    {
+      Intersection hit;
+      bool isHit = bvh->intersect(batchRay(rays, i), hit, watertight);
+
+      if (isHit)
+        n++;
+      else
+        hit = Intersection();
+      if (hits.distance != 0)
+        hits.distance[i] = hit.distance;
+      if (hits.actor != 0)
+        hits.actor[i] = hit.actor;
+      if (hits.triangleIndex != 0)
+        hits.triangleIndex[i] = hit.triangleIndex;
+
+      bool isTriangle = hit.triangleIndex >= 0;
+
+      if (hits.u != 0)
+        hits.u[i] = isTriangle ? hit.p.y : 0;
+      if (hits.v != 0)
+        hits.v[i] = isTriangle ? hit.p.z : 0;
+    }
+    count += n;
+  });
+  return count;
+}
+
+int
+SceneQuery::occluded(const RayBatch& rays, bool* hits) const
+//[]---------------------------------------------------[]
+//|  Any hit of a batch                                 |
+//[]---------------------------------------------------[]
+{
+  std::atomic<int> count(0);
+
+  parallelFor(rays.size, numberOfChunks(rays),
+    [this, &rays, hits, &count](int, int begin, int end)
+  {
+    int n = 0;
+
+    for (int i = begin; i < end; i++)
+    {
+      Ray ray = batchRay(rays, i);
+
+      if ((hits[i] = bvh->occluded(ray, ray.tMax, watertight)))
+        n++;
+    }
+    count += n;
+  });
+  return count;
+}
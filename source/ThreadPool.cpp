@@ -0,0 +1,179 @@
+//[]------------------------------------------------------------------------[]
+//|                                                                          |
+//|                        GVSG Foundation Classes                           |
+//|                               Version 1.0                                |
+//|                                                                          |
+//|              Copyright 2007-2014, Paulo Aristarco Pagliosa              |
+//|              All Rights Reserved.                                        |
+//|                                                                          |
+//[]------------------------------------------------------------------------[]
+//
+//  OVERVIEW: ThreadPool.cpp
+//  ========
+//  Source file for thread pool and task group.
+
+#include "ThreadPool.h"
+
+using namespace System;
+
+// Function-local statics are not initialized in a thread-safe way by
+// every compiler we support (e.g., VS2013)
+static std::once_flag defaultPoolFlag;
+static ThreadPool* defaultPool;
+
+
+//////////////////////////////////////////////////////////
+//
+// ThreadPool implementation
+// ==========
+ThreadPool::ThreadPool(int n):
+  done(false)
+//[]---------------------------------------------------[]
+//|  Constructor                                        |
+//[]---------------------------------------------------[]
+{
+  if (n <= 0)
+    n = (int)std::thread::hardware_concurrency();
+  if (n <= 0)
+    n = 1;
+  numberOfThreads = n;
+  threads = new std::thread[n];
+  for (int i = 0; i < n; i++)
+    threads[i] = std::thread(&ThreadPool::workerLoop, this);
+}
+
+ThreadPool::~ThreadPool()
+//[]---------------------------------------------------[]
+//|  Destructor                                         |
+//[]---------------------------------------------------[]
+{
+  {
+    std::unique_lock<std::mutex> guard(lock);
+    done = true;
+  }
+  wakeUp.notify_all();
+  for (int i = 0; i < numberOfThreads; i++)
+    threads[i].join();
+  delete []threads;
+}
+
+ThreadPool&
+ThreadPool::getDefault()
+//[]---------------------------------------------------[]
+//|  Default pool                                       |
+//[]---------------------------------------------------[]
+{
+  std::call_once(defaultPoolFlag, []()
+  {
+    defaultPool = new ThreadPool;
+  });
+  return *defaultPool;
+}
+
+void
+ThreadPool::enqueue(const Task& task)
+//[]---------------------------------------------------[]
+//|  Enqueue task                                       |
+//[]---------------------------------------------------[]
+{
+  {
+    std::unique_lock<std::mutex> guard(lock);
+    tasks.push_back(task);
+  }
+  wakeUp.notify_one();
+}
+
+inline bool
+ThreadPool::popTask(Task& task)
+{
+  std::unique_lock<std::mutex> guard(lock);
+
+  if (tasks.empty())
+    return false;
+  task = tasks.front();
+  tasks.pop_front();
+  return true;
+}
+
+bool
+ThreadPool::runPendingTask()
+//[]---------------------------------------------------[]
+//|  Run pending task                                   |
+//[]---------------------------------------------------[]
+{
+  Task task;
+
+  if (!popTask(task))
+    return false;
+  task();
+  return true;
+}
+
+void
+ThreadPool::workerLoop()
+//[]---------------------------------------------------[]
+//|  Worker loop                                        |
+//[]---------------------------------------------------[]
+{
+  for (;;)
+  {
+    Task task;
+
+    {
+      std::unique_lock<std::mutex> guard(lock);
+
+      while (!done && tasks.empty())
+        wakeUp.wait(guard);
+      if (tasks.empty())
+        return;
+      task = tasks.front();
+      tasks.pop_front();
+    }
+    task();
+  }
+}
+
+
+//////////////////////////////////////////////////////////
+//
+// TaskGroup implementation
+// =========
+void
+TaskGroup::run(const Task& task)
+//[]---------------------------------------------------[]
+//|  Run task                                           |
+//[]---------------------------------------------------[]
+{
+  pending++;
+  pool.enqueue([this, task]()
+  {
+    task();
+
+    // Decrement under the lock, so that wait() cannot return (and the
+    // group be destroyed) before the notification
+    std::unique_lock<std::mutex> guard(lock);
+
+    if (--pending == 0)
+      finished.notify_all();
+  });
+}
+
+void
+TaskGroup::wait()
+//[]---------------------------------------------------[]
+//|  Wait for all tasks of the group                    |
+//[]---------------------------------------------------[]
+{
+  while (pending > 0)
+    if (!pool.runPendingTask())
+    {
+      // The tasks left are running in other threads
+      std::unique_lock<std::mutex> guard(lock);
+
+      while (pending > 0)
+        finished.wait(guard);
+    }
+
+  // Synchronize with the last task
+  std::unique_lock<std::mutex> guard(lock);
+}
@@ -0,0 +1,258 @@
+//[]------------------------------------------------------------------------[]
+//|                                                                          |
+//|                        GVSG Foundation Classes                           |
+//|                               Version 1.0                                |
+//|                                                                          |
+//|              Copyright 2007-2014, Paulo Aristarco Pagliosa              |
+//|              All Rights Reserved.                                        |
+//|                                                                          |
+//[]------------------------------------------------------------------------[]
+//
+//  OVERVIEW: TileScheduler.cpp
+//  ========
+//  Source file for image tile scheduler.
+
+#include <algorithm>
+#include <chrono>
+#include <vector>
+#include "TileScheduler.h"
+
+using namespace System;
+
+typedef std::chrono::high_resolution_clock Clock;
+
+//
+// Auxiliary function
+//
+inline double
+secondsBetween(const Clock::time_point& t1, const Clock::time_point& t2)
+{
+  return std::chrono::duration<double>(t2 - t1).count();
+}
+
+unsigned
+System::hilbertIndex(unsigned n, unsigned x, unsigned y)
+{
+  unsigned d = 0;
+
+  for (unsigned s = n / 2; s > 0; s /= 2)
+  {
+    unsigned rx = (x & s) != 0;
+    unsigned ry = (y & s) != 0;
+
+    d += s * s * ((3 * rx) ^ ry);
+    // Rotate the quadrant
+    if (ry == 0)
+    {
+      if (rx == 1)
+      {
+        x = s - 1 - x;
+        y = s - 1 - y;
+      }
+
+      unsigned t = x;
+
+      x = y;
+      y = t;
+    }
+  }
+  return d;
+}
+
+unsigned
+System::mortonIndex(unsigned x, unsigned y)
+{
+  unsigned d = 0;
+
+  for (unsigned i = 0; i < 16; i++)
+    d |= ((x >> i) & 1) << (2 * i) | ((y >> i) & 1) << (2 * i + 1);
+  return d;
+}
+
+//
+// Auxiliary struct
+//
+struct TileScheduler::Worker
+{
+  std::deque<int> tiles;
+  std::mutex lock;
+
+}; // Worker
+
+
+//////////////////////////////////////////////////////////
+//
+// TileScheduler implementation
+// =============
+TileScheduler::TileScheduler(int aTileSize, TileOrder order):
+  tileSize(aTileSize),
+  tileOrder(order),
+  workers(0),
+  stats(0),
+  numberOfWorkers(0),
+  runTime(0)
+//[]---------------------------------------------------[]
+//|  Constructor                                        |
+//[]---------------------------------------------------[]
+{
+  // do nothing
+}
+
+TileScheduler::~TileScheduler()
+//[]---------------------------------------------------[]
+//|  Destructor                                         |
+//[]---------------------------------------------------[]
+{
+  delete []workers;
+  delete []stats;
+}
+
+void
+TileScheduler::resize(int n)
+{
+  if (n == numberOfWorkers)
+    return;
+  delete []workers;
+  delete []stats;
+  workers = new Worker[n];
+  stats = new WorkerStats[n];
+  numberOfWorkers = n;
+}
+
+bool
+TileScheduler::nextTile(int w, int& tile, bool& stolen)
+//[]---------------------------------------------------[]
+//|  Get the next tile of worker w                      |
+//[]---------------------------------------------------[]
+{
+  {
+    Worker& worker = workers[w];
+    std::unique_lock<std::mutex> guard(worker.lock);
+
+    if (!worker.tiles.empty())
+    {
+      tile = worker.tiles.front();
+      worker.tiles.pop_front();
+      stolen = false;
+      return true;
+    }
+  }
+  for (int k = 1; k < numberOfWorkers; k++)
+  {
+    Worker& victim = workers[(w + k) % numberOfWorkers];
+    std::unique_lock<std::mutex> guard(victim.lock);
+
+    if (!victim.tiles.empty())
+    {
+      tile = victim.tiles.back();
+      victim.tiles.pop_back();
+      stolen = true;
+      return true;
+    }
+  }
+  // Tiles are never added during a run, so all the deques are empty
+  return false;
+}
+
+void
+TileScheduler::run(int W, int H, const TileFunction& f, ThreadPool& pool)
+//[]---------------------------------------------------[]
+//|  Run                                                |
+//[]---------------------------------------------------[]
+{
+  Clock::time_point start = Clock::now();
+  int ts = tileSize > 0 ? tileSize : 1;
+  int nx = (W + ts - 1) / ts;
+  int ny = (H + ts - 1) / ts;
+  int numberOfTiles = nx * ny;
+  std::vector<int> order(numberOfTiles);
+
+  for (int t = 0; t < numberOfTiles; t++)
+    order[t] = t;
+  if (tileOrder != RowMajor)
+  {
+    unsigned n = 1;
+
+    while (n < unsigned(nx) || n < unsigned(ny))
+      n *= 2;
+
+    std::vector<unsigned> keys(numberOfTiles);
+
+    for (int t = 0; t < numberOfTiles; t++)
+    {
+      unsigned x = t % nx;
+      unsigned y = t / nx;
+
+      keys[t] = tileOrder == Hilbert ? hilbertIndex(n, x, y) :
+        mortonIndex(x, y);
+    }
+    std::sort(order.begin(), order.end(), [&keys](int a, int b)
+    {
+      return keys[a] < keys[b];
+    });
+  }
+  resize(pool.size());
+  for (int w = 0; w < numberOfWorkers; w++)
+  {
+    int b = int((long long)numberOfTiles * w / numberOfWorkers);
+    int e = int((long long)numberOfTiles * (w + 1) / numberOfWorkers);
+
+    workers[w].tiles.assign(order.begin() + b, order.begin() + e);
+    stats[w].numberOfTiles = stats[w].numberOfStolenTiles = 0;
+    stats[w].busyTime = 0;
+  }
+
+  TaskGroup group(pool);
+
+  for (int w = 0; w < numberOfWorkers; w++)
+    group.run([this, w, ts, nx, W, H, &f]()
+    {
+      WorkerStats& s = stats[w];
+      int tile;
+      bool stolen;
+
+      while (nextTile(w, tile, stolen))
+      {
+        Clock::time_point t1 = Clock::now();
+        int x = (tile % nx) * ts;
+        int y = (tile / nx) * ts;
+
+        f(x, y, std::min(x + ts, W), std::min(y + ts, H));
+        s.busyTime += secondsBetween(t1, Clock::now());
+        s.numberOfTiles++;
+        if (stolen)
+          s.numberOfStolenTiles++;
+      }
+    });
+  group.wait();
+  runTime = secondsBetween(start, Clock::now());
+  for (int w = 0; w < numberOfWorkers; w++)
+    stats[w].idleTime = std::max(runTime - stats[w].busyTime, 0.0);
+}
+
+void
+TileScheduler::printStats(FILE* f) const
+//[]---------------------------------------------------[]
+//|  Print stats                                        |
+//[]---------------------------------------------------[]
+{
+  static const char* orders[] = {"row-major", "Morton", "Hilbert"};
+
+  fprintf(f, "Tiles: %dx%d, %s order, %.3f s\n",
+    tileSize,
+    tileSize,
+    orders[tileOrder],
+    runTime);
+  for (int w = 0; w < numberOfWorkers; w++)
+  {
+    const WorkerStats& s = stats[w];
+
+    fprintf(f, "  thread %2d: %4d tiles (%3d stolen), "
+      "busy %.3f s, idle %.3f s\n",
+      w,
+      s.numberOfTiles,
+      s.numberOfStolenTiles,
+      s.busyTime,
+      s.idleTime);
+  }
+}
@@ -0,0 +1,257 @@
+//[]------------------------------------------------------------------------[]
+//|                                                                          |
+//|                          GVSG Graphics Library                           |
+//|                               Version 1.0                                |
+//|                                                                          |
+//|              Copyright 2007-2014, Paulo Aristarco Pagliosa              |
+//|              All Rights Reserved.                                        |
+//|                                                                          |
+//[]------------------------------------------------------------------------[]
+//
+//  OVERVIEW: TreeletOptimizer.cpp
+//  ========
+//  Source file for BVH treelet optimizer.
+
+#include "TreeletOptimizer.h"
+
+using namespace Graphics;
+
+
+//////////////////////////////////////////////////////////
+//
+// TreeletOptimizer implementation
+// ================
+void
+TreeletOptimizer::execute(BVH& bvh, Reference* refs, int n)
+//[]---------------------------------------------------[]
+//|  Build                                              |
+//[]---------------------------------------------------[]
+{
+  builder.build(bvh, refs, n);
+
+  int numberOfNodes = numberOfNodesOf(bvh);
+
+  // At least three leaves are needed for a treelet to be restructured
+  if (numberOfNodes < 5)
+    return;
+  nodes = nodesOf(bvh);
+  children = new int[numberOfNodes][2];
+  costs = new REAL[numberOfNodes];
+  heights = new int[numberOfNodes];
+  for (int i = 0; i < numberOfNodes; i++)
+    if (!nodes[i].isLeaf())
+    {
+      children[i][0] = i + 1;
+      children[i][1] = nodes[i].index;
+    }
+
+  int taskDepth = 0;
+
+  // Spawn about four tasks per thread for large trees
+  if (numberOfNodes >= BVH_MIN_PARALLEL_REFIT)
+    for (int k = ThreadPool::getDefault().size() * 4; k > 1; k >>= 1)
+      taskDepth++;
+  for (int k = 0; k < numberOfIterations; k++)
+    optimizeNode(0, 0, taskDepth);
+
+  BVH::Node* ordered = new BVH::Node[numberOfNodes];
+  int count = 0;
+
+  emit(ordered, 0, count);
+  delete []nodes;
+  nodesOf(bvh) = ordered;
+  delete []children;
+  delete []costs;
+  delete []heights;
+}
+
+void
+TreeletOptimizer::optimizeNode(int i, int depth, int taskDepth)
+//[]---------------------------------------------------[]
+//|  Optimize the subtree rooted at node i (bottom-up)  |
+//[]---------------------------------------------------[]
+{
+  const BVH::Node& node = nodes[i];
+
+  if (node.isLeaf())
+  {
+    costs[i] = SAH_INTERSECTION_COST * node.count * node.bounds.area();
+    heights[i] = 0;
+    return;
+  }
+
+  int c1 = children[i][0];
+  int c2 = children[i][1];
+
+  if (taskDepth == 0)
+  {
+    optimizeNode(c1, depth + 1, 0);
+    optimizeNode(c2, depth + 1, 0);
+  }
+  else
+  {
+    TaskGroup group;
+
+    group.run([this, c1, depth, taskDepth]()
+    {
+      optimizeNode(c1, depth + 1, taskDepth - 1);
+    });
+    optimizeNode(c2, depth + 1, taskDepth - 1);
+    group.wait();
+  }
+  costs[i] = SAH_TRAVERSAL_COST * node.bounds.area() + costs[c1] + costs[c2];
+  heights[i] = 1 + dMax<int>(heights[c1], heights[c2]);
+  restructure(i, depth);
+}
+
+void
+TreeletOptimizer::restructure(int i, int depth)
+//[]---------------------------------------------------[]
+//|  Restructure the treelet rooted at node i           |
+//|                                                     |
+//|  The cost of the optimal subtree over each subset   |
+//|  s of the treelet leaves is the traversal cost of   |
+//|  the bounds of s plus the minimum, over the         |
+//|  partitions of s in two subsets, of the sum of      |
+//|  their costs. The interior nodes of the treelet are |
+//|  reused by the new topology.                        |
+//[]---------------------------------------------------[]
+{
+  int maxLeaves = dMin<int>(dMax<int>(treeletSize, 3), MAX_TREELET_SIZE);
+  int leaves[MAX_TREELET_SIZE];
+  int interiors[MAX_TREELET_SIZE - 1];
+  int m = 2;
+  int k = 1;
+
+  leaves[0] = children[i][0];
+  leaves[1] = children[i][1];
+  interiors[0] = i;
+  while (m < maxLeaves)
+  {
+    int best = -1;
+    REAL bestArea = -1;
+
+    for (int j = 0; j < m; j++)
+      if (!nodes[leaves[j]].isLeaf())
+      {
+        REAL area = nodes[leaves[j]].bounds.area();
+
+        if (area > bestArea)
+        {
+          bestArea = area;
+          best = j;
+        }
+      }
+    if (best < 0)
+      break;
+
+    int c = leaves[best];
+
+    interiors[k++] = c;
+    leaves[best] = children[c][0];
+    leaves[m++] = children[c][1];
+  }
+  if (m < 3)
+    return;
+
+  Bounds3 bounds[1 << MAX_TREELET_SIZE];
+  REAL cost[1 << MAX_TREELET_SIZE];
+  int height[1 << MAX_TREELET_SIZE];
+  int split[1 << MAX_TREELET_SIZE];
+  int full = (1 << m) - 1;
+
+  for (int s = 1; s <= full; s++)
+  {
+    int low = s & -s;
+
+    if (s == low)
+    {
+      int leaf = leaves[lowestBit(s)];
+
+      bounds[s] = nodes[leaf].bounds;
+      cost[s] = costs[leaf];
+      height[s] = heights[leaf];
+      continue;
+    }
+    bounds[s] = bounds[low];
+    bounds[s].inflate(bounds[s ^ low]);
+
+    REAL best = FloatInfo<REAL>::inf();
+
+    // Each partition is visited once: p holds the lowest bit of s
+    for (int p = (s - 1) & s; p > 0; p = (p - 1) & s)
+      if ((p & low) != 0)
+      {
+        REAL c = cost[p] + cost[s ^ p];
+
+        if (c < best)
+        {
+          best = c;
+          split[s] = p;
+        }
+      }
+    cost[s] = SAH_TRAVERSAL_COST * bounds[s].area() + best;
+    height[s] = 1 + dMax<int>(height[split[s]], height[s ^ split[s]]);
+  }
+  if (cost[full] >= costs[i] * (1 - (REAL)1e-5))
+    return;
+  if (depth + height[full] > BVH_MAX_DEPTH - 1)
+    return;
+
+  int stack[2 * MAX_TREELET_SIZE][2];
+  int top = 0;
+
+  k = 1;
+  stack[top][0] = full;
+  stack[top++][1] = i;
+  while (top > 0)
+  {
+    int s = stack[--top][0];
+    int node = stack[top][1];
+    int sets[2] = {split[s], s ^ split[s]};
+    int axis = 0;
+    vec3 d = bounds[sets[1]].center() - bounds[sets[0]].center();
+
+    for (int a = 1; a < 3; a++)
+      if (fabs(d[a]) > fabs(d[axis]))
+        axis = a;
+    // The first child must be the one on the negative side of axis
+    if (d[axis] < 0)
+      dSwap<int>(sets[0], sets[1]);
+    for (int j = 0; j < 2; j++)
+    {
+      int t = sets[j];
+
+      if (t == (t & -t))
+        children[node][j] = leaves[lowestBit(t)];
+      else
+      {
+        children[node][j] = interiors[k++];
+        stack[top][0] = t;
+        stack[top++][1] = children[node][j];
+      }
+    }
+    nodes[node].bounds = bounds[s];
+    nodes[node].axis = uint16(axis);
+    costs[node] = cost[s];
+    heights[node] = height[s];
+  }
+}
+
+int
+TreeletOptimizer::emit(BVH::Node* dst, int i, int& count) const
+//[]---------------------------------------------------[]
+//|  Copy the subtree rooted at node i in depth-first   |
+//|  order into dst                                     |
+//[]---------------------------------------------------[]
+{
+  int j = count++;
+
+  dst[j] = nodes[i];
+  if (!nodes[i].isLeaf())
+  {
+    emit(dst, children[i][0], count);
+    dst[j].index = emit(dst, children[i][1], count);
+  }
+  return j;
+}
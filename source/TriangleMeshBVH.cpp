@@ -0,0 +1,636 @@
+//[]------------------------------------------------------------------------[]
+//|                                                                          |
+//|                          GVSG Graphics Library                           |
+//|                               Version 1.0                                |
+//|                                                                          |
+//|              Copyright 2007-2014, Paulo Aristarco Pagliosa              |
+//|              All Rights Reserved.                                        |
+//|                                                                          |
+//[]------------------------------------------------------------------------[]
+//
+//  OVERVIEW: TriangleMeshBVH.cpp
+//  ========
+//  Source file for triangle mesh BVH.
+
+#include "BinnedSAHBuilder.h"
+#include "TriangleMeshBVH.h"
+
+using namespace Graphics;
+
+
+//////////////////////////////////////////////////////////
+//
+// TriangleMeshBVH implementation
+// ===============
+TriangleMeshBVH::TriangleMeshBVH(const TriangleMesh* aMesh,
+  BVHBuilder& builder):
+  mesh(aMesh),
+  bvh4(0),
+  bvh8(0)
+//[]---------------------------------------------------[]
+//|  Constructor                                        |
+//[]---------------------------------------------------[]
+{
+  rebuild(builder);
+}
+
+TriangleMeshBVH::~TriangleMeshBVH()
+//[]---------------------------------------------------[]
+//|  Destructor                                         |
+//[]---------------------------------------------------[]
+{
+  delete bvh4;
+  delete bvh8;
+}
+
+void
+TriangleMeshBVH::collapse()
+//[]---------------------------------------------------[]
+//|  Collapse into a wide BVH                           |
+//[]---------------------------------------------------[]
+{
+  delete bvh4;
+  delete bvh8;
+  bvh4 = 0;
+  bvh8 = 0;
+  switch (wideBVHWidth())
+  {
+    case 4:
+      bvh4 = new TriangleMeshWideBVH<4>(*this, mesh->getData());
+      break;
+    case 8:
+      bvh8 = new TriangleMeshWideBVH<8>(*this, mesh->getData());
+      break;
+  }
+}
+
+void
+TriangleMeshBVH::rebuild(BVHBuilder& builder)
+//[]---------------------------------------------------[]
+//|  Rebuild                                            |
+//[]---------------------------------------------------[]
+{
+  const TriangleMesh::Arrays& data = mesh->getData();
+  int n = data.numberOfTriangles;
+  BVHBuilder::Reference* refs = new BVHBuilder::Reference[n];
+  const TriangleMesh::Triangle* t = data.triangles;
+
+  for (int i = 0; i < n; i++, t++)
+  {
+    const vec3& v0 = data.vertices[t->v[0]];
+    const vec3& v1 = data.vertices[t->v[1]];
+    const vec3& v2 = data.vertices[t->v[2]];
+
+    refs[i].bounds.inflate(v0);
+    refs[i].bounds.inflate(v1);
+    refs[i].bounds.inflate(v2);
+    refs[i].centroid = triangleCenter(v0, v1, v2);
+    refs[i].index = i;
+  }
+  builder.build(*this, refs, n);
+  delete []refs;
+  collapse();
+}
+
+bool
+TriangleMeshBVH::refit(BVHBuilder& builder, REAL maxDegradation)
+//[]---------------------------------------------------[]
+//|  Refit                                              |
+//[]---------------------------------------------------[]
+{
+  const TriangleMesh::Arrays& data = mesh->getData();
+
+  if (data.numberOfTriangles == numberOfPrimitives)
+  {
+    BVH::refit([&data](int i) -> Bounds3
+    {
+      const TriangleMesh::Triangle& t = data.triangles[i];
+      Bounds3 b;
+
+      b.inflate(data.vertices[t.v[0]]);
+      b.inflate(data.vertices[t.v[1]]);
+      b.inflate(data.vertices[t.v[2]]);
+      return b;
+    });
+    if (getDegradation() <= maxDegradation)
+    {
+      collapse();
+      return false;
+    }
+  }
+  rebuild(builder);
+  return true;
+}
+
+//
+// Auxiliary function
+//
+inline bool
+hitTriangle(const TriangleMesh::Arrays& data,
+  int i,
+  const Ray& ray,
+  const RayShear* shear,
+  REAL& d,
+  REAL& b1,
+  REAL& b2)
+{
+  const TriangleMesh::Triangle& t = data.triangles[i];
+  const vec3& v0 = data.vertices[t.v[0]];
+  const vec3& v1 = data.vertices[t.v[1]];
+  const vec3& v2 = data.vertices[t.v[2]];
+
+  if (shear != 0)
+    return intersectTriangle(ray, *shear, v0, v1, v2, d, b1, b2);
+  return intersectTriangle(ray, v0, v1, v2, d, b1, b2);
+}
+
+//
+// Auxiliary classes
+//
+class TriangleIntersector
+{
+public:
+  // Constructor
+  TriangleIntersector(const TriangleMesh::Arrays& aData,
+    Intersection& aHit,
+    const RayShear* aShear = 0):
+    data(aData),
+    hit(aHit),
+    shear(aShear)
+  {
+    // do nothing
+  }
+
+  bool operator ()(int i, Ray& ray)
+  {
+    REAL d;
+    REAL b1;
+    REAL b2;
+
+    if (!hitTriangle(data, i, ray, shear, d, b1, b2))
+      return false;
+    ray.tMax = hit.distance = d;
+    hit.triangleIndex = i;
+    hit.p.set(1 - b1 - b2, b1, b2);
+    return true;
+  }
+
+private:
+  const TriangleMesh::Arrays& data;
+  Intersection& hit;
+  const RayShear* shear;
+
+  TriangleIntersector& operator =(const TriangleIntersector&);
+
+}; // TriangleIntersector
+
+class TriangleOccluder
+{
+public:
+  // Constructor
+  TriangleOccluder(const TriangleMesh::Arrays& aData,
+    const RayShear* aShear = 0):
+    data(aData),
+    shear(aShear)
+  {
+    // do nothing
+  }
+
+  bool operator ()(int i, const Ray& ray) const
+  {
+    REAL d;
+    REAL b1;
+    REAL b2;
+
+    return hitTriangle(data, i, ray, shear, d, b1, b2);
+  }
+
+private:
+  const TriangleMesh::Arrays& data;
+  const RayShear* shear;
+
+  TriangleOccluder& operator =(const TriangleOccluder&);
+
+}; // TriangleOccluder
+
+bool
+TriangleMeshBVH::intersect(const Ray& ray,
+  Intersection& hit,
+  bool watertight) const
+//[]---------------------------------------------------[]
+//|  Closest intersection                               |
+//[]---------------------------------------------------[]
+{
+  if (bvh8 != 0)
+    return bvh8->intersect(ray, hit, watertight);
+  if (bvh4 != 0)
+    return bvh4->intersect(ray, hit, watertight);
+
+  Ray r = ray;
+  RayShear shear(ray.direction);
+  TriangleIntersector intersector(mesh->getData(),
+    hit,
+    watertight ? &shear : 0);
+
+  return BVH::intersect(r, intersector);
+}
+
+bool
+TriangleMeshBVH::occluded(const Ray& ray, REAL tMax, bool watertight) const
+//[]---------------------------------------------------[]
+//|  Any intersection                                   |
+//[]---------------------------------------------------[]
+{
+  Ray r = ray;
+
+  r.tMax = tMax;
+  if (bvh8 != 0)
+    return bvh8->occluded(r, watertight);
+  if (bvh4 != 0)
+    return bvh4->occluded(r, watertight);
+
+  RayShear shear(ray.direction);
+  TriangleOccluder occluder(mesh->getData(), watertight ? &shear : 0);
+
+  return BVH::occluded(r, occluder);
+}
+
+//
+// Auxiliary classes
+//
+template <int W>
+class PacketTriangleIntersector
+{
+public:
+  // Constructor
+  PacketTriangleIntersector(const TriangleMesh::Arrays& aData,
+    Intersection* aHits):
+    data(aData),
+    hits(aHits)
+  {
+    // do nothing
+  }
+
+  int operator ()(int i, RayPacket& packet, int mask)
+  {
+    const TriangleMesh::Triangle& t = data.triangles[i];
+    float d[RAY_PACKET_SIZE];
+    float b1[RAY_PACKET_SIZE];
+    float b2[RAY_PACKET_SIZE];
+    int m = packetTriangleHits<W>(data.vertices[t.v[0]],
+      data.vertices[t.v[1]],
+      data.vertices[t.v[2]],
+      packet,
+      mask,
+      d,
+      b1,
+      b2);
+
+    for (int k = m; k != 0; k &= k - 1)
+    {
+      int j = lowestBit(k);
+      Intersection& hit = hits[j];
+
+      packet.tMax[j] = hit.distance = d[j];
+      hit.triangleIndex = i;
+      hit.p.set(1 - b1[j] - b2[j], b1[j], b2[j]);
+    }
+    return m;
+  }
+
+private:
+  const TriangleMesh::Arrays& data;
+  Intersection* hits;
+
+  PacketTriangleIntersector& operator =(const PacketTriangleIntersector&);
+
+}; // PacketTriangleIntersector
+
+template <int W>
+class PacketTriangleOccluder
+{
+public:
+  // Constructor
+  PacketTriangleOccluder(const TriangleMesh::Arrays& aData):
+    data(aData)
+  {
+    // do nothing
+  }
+
+  int operator ()(int i, const RayPacket& packet, int mask) const
+  {
+    const TriangleMesh::Triangle& t = data.triangles[i];
+    float d[RAY_PACKET_SIZE];
+    float b1[RAY_PACKET_SIZE];
+    float b2[RAY_PACKET_SIZE];
+
+    return packetTriangleHits<W>(data.vertices[t.v[0]],
+      data.vertices[t.v[1]],
+      data.vertices[t.v[2]],
+      packet,
+      mask,
+      d,
+      b1,
+      b2);
+  }
+
+private:
+  const TriangleMesh::Arrays& data;
+
+  PacketTriangleOccluder& operator =(const PacketTriangleOccluder&);
+
+}; // PacketTriangleOccluder
+
+int
+TriangleMeshBVH::intersect(RayPacket& packet,
+  int mask,
+  Intersection* hits) const
+//[]---------------------------------------------------[]
+//|  Closest intersections of a packet                  |
+//|                                                     |
+//|  The packet traverses the binary tree, since the    |
+//|  wide tree tests one ray against many children.     |
+//[]---------------------------------------------------[]
+{
+  switch (simdWidth())
+  {
+    case 8:
+    {
+      PacketTriangleIntersector<8> intersector(mesh->getData(), hits);
+
+      return BVH::intersect<8>(packet, mask, intersector);
+    }
+    case 4:
+    {
+      PacketTriangleIntersector<4> intersector(mesh->getData(), hits);
+
+      return BVH::intersect<4>(packet, mask, intersector);
+    }
+  }
+
+  PacketTriangleIntersector<1> intersector(mesh->getData(), hits);
+
+  return BVH::intersect<1>(packet, mask, intersector);
+}
+
+int
+TriangleMeshBVH::occluded(const RayPacket& packet, int mask) const
+//[]---------------------------------------------------[]
+//|  Any intersection of a packet                       |
+//[]---------------------------------------------------[]
+{
+  switch (simdWidth())
+  {
+    case 8:
+    {
+      PacketTriangleOccluder<8> occluder(mesh->getData());
+
+      return BVH::occluded<8>(packet, mask, occluder);
+    }
+    case 4:
+    {
+      PacketTriangleOccluder<4> occluder(mesh->getData());
+
+      return BVH::occluded<4>(packet, mask, occluder);
+    }
+  }
+
+  PacketTriangleOccluder<1> occluder(mesh->getData());
+
+  return BVH::occluded<1>(packet, mask, occluder);
+}
+
+TriangleMeshBVH*
+Graphics::meshBVH(TriangleMesh* mesh, BVHBuilder& builder)
+//[]---------------------------------------------------[]
+//|  Get mesh BVH                                       |
+//[]---------------------------------------------------[]
+{
+  TriangleMeshBVH* bvh = getBVH(mesh);
+
+  if (bvh == 0)
+  {
+    bvh = new TriangleMeshBVH(mesh, builder);
+    mesh->accelerationData = bvh;
+  }
+  return bvh;
+}
+
+TriangleMeshBVH*
+Graphics::meshBVH(TriangleMesh* mesh)
+//[]---------------------------------------------------[]
+//|  Get mesh BVH                                       |
+//[]---------------------------------------------------[]
+{
+  BinnedSAHBuilder builder;
+  return meshBVH(mesh, builder);
+}
+
+
+//////////////////////////////////////////////////////////
+//
+// TriangleMeshWideBVH implementation
+// ===================
+template <int N>
+TriangleMeshWideBVH<N>::TriangleMeshWideBVH(const BVH& bvh,
+  const TriangleMesh::Arrays& aData):
+  WideBVH<N>(bvh, N),
+  data(aData)
+//[]---------------------------------------------------[]
+//|  Constructor                                        |
+//[]---------------------------------------------------[]
+{
+  int n = this->getNumberOfBlocks();
+  const int* ids = this->getBlockIds();
+
+  blocks = new TriangleBlock<N>[n];
+  for (int b = 0; b < n; b++)
+    for (int i = 0; i < N; i++, ids++)
+      if (*ids < 0)
+        blocks[b].setEmpty(i);
+      else
+      {
+        const TriangleMesh::Triangle& t = data.triangles[*ids];
+
+        blocks[b].set(i,
+          *ids,
+          data.vertices[t.v[0]],
+          data.vertices[t.v[1]],
+          data.vertices[t.v[2]]);
+      }
+}
+
+//
+// Auxiliary classes
+//
+template <int N>
+class TriangleBlockIntersector
+{
+public:
+  // Constructor
+  TriangleBlockIntersector(const TriangleBlock<N>* aBlocks,
+    Intersection& aHit):
+    blocks(aBlocks),
+    hit(aHit)
+  {
+    // do nothing
+  }
+
+  bool operator ()(int b, Ray& ray)
+  {
+    REAL d;
+    REAL b1;
+    REAL b2;
+    int i = intersectTriangleBlock<N>(blocks[b], ray, d, b1, b2);
+
+    if (i < 0)
+      return false;
+    ray.tMax = hit.distance = d;
+    hit.triangleIndex = blocks[b].id[i];
+    hit.p.set(1 - b1 - b2, b1, b2);
+    return true;
+  }
+
+private:
+  const TriangleBlock<N>* blocks;
+  Intersection& hit;
+
+  TriangleBlockIntersector& operator =(const TriangleBlockIntersector&);
+
+}; // TriangleBlockIntersector
+
+template <int N>
+class TriangleBlockOccluder
+{
+public:
+  // Constructor
+  TriangleBlockOccluder(const TriangleBlock<N>* aBlocks):
+    blocks(aBlocks)
+  {
+    // do nothing
+  }
+
+  bool operator ()(int b, const Ray& ray) const
+  {
+    return occludedTriangleBlock<N>(blocks[b], ray);
+  }
+
+private:
+  const TriangleBlock<N>* blocks;
+
+}; // TriangleBlockOccluder
+
+template <int N>
+class WatertightBlockIntersector
+{
+public:
+  // Constructor
+  WatertightBlockIntersector(const TriangleBlock<N>* aBlocks,
+    const TriangleMesh::Arrays& aData,
+    const RayShear& aShear,
+    Intersection& aHit):
+    blocks(aBlocks),
+    intersector(aData, aHit, &aShear)
+  {
+    // do nothing
+  }
+
+  bool operator ()(int b, Ray& ray)
+  {
+    // Use the mesh vertices: the vertices rebuilt from the block
+    // edges are not exactly shared by adjacent triangles
+    const int* id = blocks[b].id;
+    bool hit = false;
+
+    for (int i = 0; i < N && id[i] >= 0; i++)
+      if (intersector(id[i], ray))
+        hit = true;
+    return hit;
+  }
+
+private:
+  const TriangleBlock<N>* blocks;
+  TriangleIntersector intersector;
+
+  WatertightBlockIntersector& operator =(const WatertightBlockIntersector&);
+
+}; // WatertightBlockIntersector
+
+template <int N>
+class WatertightBlockOccluder
+{
+public:
+  // Constructor
+  WatertightBlockOccluder(const TriangleBlock<N>* aBlocks,
+    const TriangleMesh::Arrays& aData,
+    const RayShear& aShear):
+    blocks(aBlocks),
+    occluder(aData, &aShear)
+  {
+    // do nothing
+  }
+
+  bool operator ()(int b, const Ray& ray) const
+  {
+    const int* id = blocks[b].id;
+
+    for (int i = 0; i < N && id[i] >= 0; i++)
+      if (occluder(id[i], ray))
+        return true;
+    return false;
+  }
+
+private:
+  const TriangleBlock<N>* blocks;
+  TriangleOccluder occluder;
+
+  WatertightBlockOccluder& operator =(const WatertightBlockOccluder&);
+
+}; // WatertightBlockOccluder
+
+template <int N>
+bool
+TriangleMeshWideBVH<N>::intersect(const Ray& ray,
+  Intersection& hit,
+  bool watertight) const
+//[]---------------------------------------------------[]
+//|  Closest intersection                               |
+//[]---------------------------------------------------[]
+{
+  Ray r = ray;
+
+  if (watertight)
+  {
+    RayShear shear(ray.direction);
+    WatertightBlockIntersector<N> intersector(blocks, data, shear, hit);
+
+    return WideBVH<N>::intersect(r, intersector);
+  }
+
+  TriangleBlockIntersector<N> intersector(blocks, hit);
+
+  return WideBVH<N>::intersect(r, intersector);
+}
+
+template <int N>
+bool
+TriangleMeshWideBVH<N>::occluded(const Ray& ray, bool watertight) const
+//[]---------------------------------------------------[]
+//|  Any intersection                                   |
+//[]---------------------------------------------------[]
+{
+  if (watertight)
+  {
+    RayShear shear(ray.direction);
+    WatertightBlockOccluder<N> occluder(blocks, data, shear);
+
+    return WideBVH<N>::occluded(ray, occluder);
+  }
+
+  TriangleBlockOccluder<N> occluder(blocks);
+
+  return WideBVH<N>::occluded(ray, occluder);
+}
+
+template class TriangleMeshWideBVH<4>;
+template class TriangleMeshWideBVH<8>;
@@ -0,0 +1,371 @@
+//[]------------------------------------------------------------------------[]
+//|                                                                          |
+//|                          GVSG Graphics Library                           |
+//|                               Version 1.0                                |
+//|                                                                          |
+//|              Copyright 2007-2014, Paulo Aristarco Pagliosa              |
+//|              All Rights Reserved.                                        |
+//|                                                                          |
+//[]------------------------------------------------------------------------[]
+//
+//  OVERVIEW: WavefrontTracer.cpp
+//  ========
+//  Source file for wavefront ray tracer.
+
+#include "Morton.h"
+#include "WavefrontTracer.h"
+#include "RayTracerUtil.h"
+
+using namespace Graphics;
+
+#define DFL_WAVE_SIZE     (1 << 16)
+#define SHADING_CHUNK     1024
+#define MIN_PARALLEL_RAYS 1024
+#define ORIGIN_BITS       9
+
+//
+// Auxiliary functions
+//
+inline int
+numberOfChunks(int n)
+{
+  return n < MIN_PARALLEL_RAYS ? 1 : ThreadPool::getDefault().size() * 4;
+}
+
+inline uint32
+quantize(REAL x, REAL k)
+{
+  const int maxCell = (1 << ORIGIN_BITS) - 1;
+  int i = int(x * k);
+
+  return uint32(i < 0 ? 0 : i > maxCell ? maxCell : i);
+}
+
+
+//////////////////////////////////////////////////////////
+//
+// WavefrontTracer implementation
+// ===============
+WavefrontTracer::WavefrontTracer(Scene& scene, Camera* camera):
+  RayTracer(scene, camera),
+  waveSize(DFL_WAVE_SIZE),
+  sortRays(true),
+  numberOfRays(0),
+  numberOfShadowRays(0)
+//[]---------------------------------------------------[]
+//|  Constructor                                        |
+//[]---------------------------------------------------[]
+{
+  // do nothing
+}
+
+void
+WavefrontTracer::scan()
+//[]---------------------------------------------------[]
+//|  Scan the image                                     |
+//|                                                     |
+//|  The image is split into waves of whole rows.       |
+//[]---------------------------------------------------[]
+{
+  numberOfRays = numberOfShadowRays = 0;
+  lights.clear();
+  for (LightIterator lit(scene->getLightIterator()); lit;)
+  {
+    Light* light = lit++;
+
+    if (light->isTurnedOn())
+      lights.push_back(light);
+  }
+
+  int rows = dMax<int>(1, waveSize / dMax<int>(W, 1));
+
+  for (int y = 0; y < H; y += rows)
+    renderWave(y, dMin<int>(y + rows, H));
+}
+
+void
+WavefrontTracer::renderWave(int y1, int y2)
+//[]---------------------------------------------------[]
+//|  Render the rows [y1, y2)                           |
+//[]---------------------------------------------------[]
+{
+  int n = (y2 - y1) * W;
+
+  radiance.assign(n, Color::black);
+  rays.resize(n);
+  parallelFor(n, numberOfChunks(n), [this, y1](int, int begin, int end)
+  {
+    for (int i = begin; i < end; i++)
+    {
+      PathRay& r = rays[i];
+
+      r.ray = makePixelRay(i % W, y1 + i / W);
+      r.weight = Color::white;
+      r.importance = 1;
+      r.pixel = i;
+    }
+  });
+  for (int level = 0; !rays.empty(); level++)
+  {
+    numberOfRays += rays.size();
+    intersectRays();
+    binRays();
+    shadeRays(level);
+    traceShadowRays();
+    if (sortRays)
+      sortRaysByOctantAndOrigin();
+  }
+  for (int i = 0; i < n; i++)
+    storeSample(i % W, y1 + i / W, radiance[i]);
+}
+
+void
+WavefrontTracer::intersectRays()
+//[]---------------------------------------------------[]
+//|  Intersect the ray stream                           |
+//|                                                     |
+//|  The key of a ray is the index of the material hit  |
+//|  or, if it missed, the number of materials.         |
+//[]---------------------------------------------------[]
+{
+  int n = int(rays.size());
+  int miss = MaterialFactory::size();
+
+  hits.resize(n);
+  colors.resize(n);
+  keys.resize(n);
+  parallelFor(n, numberOfChunks(n), [this, miss](int, int begin, int end)
+  {
+    for (int i = begin; i < end; i++)
+    {
+      Intersection& hit = hits[i] = Intersection();
+
+      keys[i] = intersect(rays[i].ray, hit) ?
+        int(hit.actor->getModel()->getMaterial()->getIndex()) : miss;
+    }
+  });
+}
+
+void
+WavefrontTracer::binRays()
+//[]---------------------------------------------------[]
+//|  Bin the rays into per-material queues              |
+//|                                                     |
+//|  Counting sort of the ray indices by their keys;    |
+//|  the queue of key k is [offsets[k], offsets[k+1]).  |
+//[]---------------------------------------------------[]
+{
+  int n = int(rays.size());
+  int m = MaterialFactory::size() + 1;
+
+  queueOffsets.assign(m + 1, 0);
+  for (int i = 0; i < n; i++)
+    queueOffsets[keys[i] + 1]++;
+  for (int k = 1; k <= m; k++)
+    queueOffsets[k] += queueOffsets[k - 1];
+  queue.resize(n);
+  for (int i = 0; i < n; i++)
+    queue[queueOffsets[keys[i]]++] = i;
+  // Each offset now is the end of its queue
+  for (int k = m; k > 0; k--)
+    queueOffsets[k] = queueOffsets[k - 1];
+  queueOffsets[0] = 0;
+}
+
+void
+WavefrontTracer::shadeRays(int level)
+//[]---------------------------------------------------[]
+//|  Shade the queues of the materials                  |
+//|                                                     |
+//|  Each queue is split into chunks, shaded in         |
+//|  parallel. The shadow rays and the rays of the next |
+//|  bounce are then gathered in chunk order, so that   |
+//|  the image does not depend on the thread timing.    |
+//[]---------------------------------------------------[]
+{
+  int miss = int(queueOffsets.size()) - 2;
+
+  // Only the primary rays see the background
+  if (level == 0)
+    for (int k = queueOffsets[miss], e = queueOffsets[miss + 1]; k < e; k++)
+      radiance[rays[queue[k]].pixel] += background();
+
+  int numberOfTasks = 0;
+
+  for (int m = 0; m < miss; m++)
+    for (int b = queueOffsets[m], e = queueOffsets[m + 1]; b < e;
+      b += SHADING_CHUNK)
+    {
+      if (numberOfTasks == int(tasks.size()))
+        tasks.resize(numberOfTasks + 1);
+
+      ShadingTask& task = tasks[numberOfTasks++];
+
+      task.begin = b;
+      task.end = dMin<int>(b + SHADING_CHUNK, e);
+    }
+  if (numberOfTasks > 0)
+    parallelFor(numberOfTasks, numberOfTasks, [this, level](int c, int, int)
+    {
+      shadeQueue(tasks[c], level);
+    });
+  for (int k = 0, e = queueOffsets[miss]; k < e; k++)
+  {
+    int i = queue[k];
+
+    radiance[rays[i].pixel] += colors[i];
+  }
+  shadowRays.clear();
+  nextRays.clear();
+  for (int t = 0; t < numberOfTasks; t++)
+  {
+    const ShadingTask& task = tasks[t];
+
+    shadowRays.insert(shadowRays.end(),
+      task.shadowRays.begin(),
+      task.shadowRays.end());
+    nextRays.insert(nextRays.end(), task.rays.begin(), task.rays.end());
+  }
+  rays.swap(nextRays);
+}
+
+void
+WavefrontTracer::shadeQueue(ShadingTask& task, int level)
+//[]---------------------------------------------------[]
+//|  Shade a chunk of a material queue (Whitted model)  |
+//[]---------------------------------------------------[]
+{
+  bool recurse = level < maxRecursionLevel;
+  int numberOfLights = int(lights.size());
+
+  task.shadowRays.clear();
+  task.rays.clear();
+  for (int k = task.begin; k < task.end; k++)
+  {
+    int i = queue[k];
+    const PathRay& r = rays[i];
+    ShadingPoint p;
+
+    setShadingPoint(r.ray, hits[i], p);
+    colors[i] = r.weight * (scene->ambientLight * p.surface->ambient);
+    for (int j = 0; j < numberOfLights; j++)
+    {
+      Light* light = lights[j];
+      vec3 L;
+      REAL d;
+
+      light->lightVector(p.P, L, d);
+      if (p.N.dot(L) <= 0)
+        continue;
+
+      Color c = lightColor(p, light, L, d);
+
+      if (isBlack(c))
+        continue;
+
+      ShadowRay sr;
+
+      sr.ray = Ray(p.P, L, RT_EPS, d);
+      sr.color = r.weight * c;
+      sr.pixel = r.pixel;
+      task.shadowRays.push_back(sr);
+    }
+    if (!recurse)
+      continue;
+
+    PathRay next;
+
+    next.pixel = r.pixel;
+    if (reflectedRay(p, r.importance, next.ray, next.importance))
+    {
+      next.weight = r.weight * p.surface->specular;
+      task.rays.push_back(next);
+    }
+    if (refractedRay(p, r.importance, next.ray, next.importance))
+    {
+      next.weight = r.weight * p.surface->transparency;
+      task.rays.push_back(next);
+    }
+  }
+}
+
+void
+WavefrontTracer::traceShadowRays()
+//[]---------------------------------------------------[]
+//|  Trace the shadow ray stream                        |
+//[]---------------------------------------------------[]
+{
+  int n = int(shadowRays.size());
+
+  numberOfShadowRays += n;
+  occluded.resize(n);
+  parallelFor(n, numberOfChunks(n), [this](int, int begin, int end)
+  {
+    for (int i = begin; i < end; i++)
+      occluded[i] = shadow(shadowRays[i].ray);
+  });
+  for (int i = 0; i < n; i++)
+    if (!occluded[i])
+      radiance[shadowRays[i].pixel] += shadowRays[i].color;
+}
+
+void
+WavefrontTracer::sortRaysByOctantAndOrigin()
+//[]---------------------------------------------------[]
+//|  Sort the rays of the next bounce                   |
+//|                                                     |
+//|  The sort key of a ray has the octant of its        |
+//|  direction in the upper 3 bits and the Morton code  |
+//|  of its origin, quantized in the scene bounds, in   |
+//|  the lower 27 bits. The 64-bit codes hold the key   |
+//|  in the upper half and the ray index in the lower   |
+//|  one, and are sorted by a parallel radix sort of    |
+//|  the keys (see radixSort).                          |
+//[]---------------------------------------------------[]
+{
+  int n = int(rays.size());
+
+  if (n < 2)
+    return;
+
+  Bounds3 b = bvh->bounds();
+  const vec3& origin = b.getMin();
+  vec3 size = b.size();
+  vec3 k;
+
+  for (int i = 0; i < 3; i++)
+    k[i] = size[i] > 0 ? ((1 << ORIGIN_BITS) - 1) / size[i] : 0;
+  codes.resize(n);
+  sortedCodes.resize(n);
+  parallelFor(n, numberOfChunks(n), [this, &origin, &k](int, int begin, int end)
+  {
+    for (int i = begin; i < end; i++)
+    {
+      const vec3& d = rays[i].ray.direction;
+      vec3 p = rays[i].ray.origin - origin;
+      uint32 octant = (d.x < 0) | ((d.y < 0) << 1) | ((d.z < 0) << 2);
+      uint32 key = (octant << 3 * ORIGIN_BITS) |
+        spreadBits(quantize(p.x, k.x)) |
+        (spreadBits(quantize(p.y, k.y)) << 1) |
+        (spreadBits(quantize(p.z, k.z)) << 2);
+
+      codes[i] = ((unsigned long long)key << 32) | uint32(i);
+    }
+  });
+
+  const unsigned long long* sorted = radixSort(&codes[0],
+    &sortedCodes[0],
+    n,
+    32,
+    32 + 3 * ORIGIN_BITS + 3,
+    numberOfChunks(n),
+    [](unsigned long long code)
+    {
+      return code;
+    });
+
+  nextRays.resize(n);
+  for (int i = 0; i < n; i++)
+    nextRays[i] = rays[uint32(sorted[i])];
+  rays.swap(nextRays);
+}
@@ -0,0 +1,202 @@
+//[]------------------------------------------------------------------------[]
+//|                                                                          |
+//|                          GVSG Graphics Library                           |
+//|                               Version 1.0                                |
+//|                                                                          |
+//|              Copyright 2007-2014, Paulo Aristarco Pagliosa              |
+//|              All Rights Reserved.                                        |
+//|                                                                          |
+//[]------------------------------------------------------------------------[]
+//
+//  OVERVIEW: WideBVH.cpp
+//  ========
+//  Source file for wide (4/8-ary) BVH.
+
+#include "WideBVH.h"
+
+using namespace Graphics;
+
+
+//////////////////////////////////////////////////////////
+//
+// WideBVH implementation
+// =======
+template <int N>
+WideBVH<N>::WideBVH(const BVH& bvh, int blockSize):
+  nodes(0),
+  numberOfNodes(0),
+  blockIds(0),
+  numberOfBlocks(0),
+  blockSize(blockSize),
+  primitiveIds(bvh.getPrimitiveIds()),
+  subtreeCounts(0)
+//[]---------------------------------------------------[]
+//|  Constructor                                        |
+//[]---------------------------------------------------[]
+{
+  int n = bvh.getNumberOfNodes();
+
+  if (n == 0)
+    return;
+  // Each wide node replaces at least one binary interior node, and
+  // each of the (at most n / 2 + 1) leaves pads less than a block
+  nodes = new Node[n / 2 + 1];
+  blockIds = new int[bvh.getNumberOfPrimitiveIds() +
+    (n / 2 + 1) * (blockSize - 1)];
+  subtreeCounts = new int[n];
+  countPrimitives(bvh.getNodes(), 0);
+  collapse(bvh.getNodes(), 0);
+  delete []subtreeCounts;
+  subtreeCounts = 0;
+}
+
+template <int N>
+int
+WideBVH<N>::countPrimitives(const BVH::Node* src, int i)
+//[]---------------------------------------------------[]
+//|  Count the primitives of the subtree of node i      |
+//[]---------------------------------------------------[]
+{
+  const BVH::Node& node = src[i];
+
+  return subtreeCounts[i] = node.isLeaf() ? node.count :
+    countPrimitives(src, i + 1) + countPrimitives(src, node.index);
+}
+
+template <int N>
+int
+WideBVH<N>::gatherPrimitives(const BVH::Node* src, int i, int* ids) const
+//[]---------------------------------------------------[]
+//|  Copy the primitive ids of the subtree of node i    |
+//[]---------------------------------------------------[]
+{
+  const BVH::Node& node = src[i];
+
+  if (!node.isLeaf())
+  {
+    int n = gatherPrimitives(src, i + 1, ids);
+
+    return n + gatherPrimitives(src, node.index, ids + n);
+  }
+  for (int k = 0; k < node.count; k++)
+    ids[k] = primitiveIds[node.index + k];
+  return node.count;
+}
+
+template <int N>
+inline bool
+WideBVH<N>::isWideLeaf(const BVH::Node* src, int i) const
+{
+  return src[i].isLeaf() || subtreeCounts[i] <= blockSize;
+}
+
+template <int N>
+int
+WideBVH<N>::makeBlocks(const BVH::Node* src, int i)
+//[]---------------------------------------------------[]
+//|  Group the primitives of the subtree of node i in   |
+//|  blocks                                             |
+//[]---------------------------------------------------[]
+{
+  int* ids = blockIds + numberOfBlocks * blockSize;
+  int count = gatherPrimitives(src, i, ids);
+  int n = (count + blockSize - 1) / blockSize;
+
+  for (int k = count, e = n * blockSize; k < e; k++)
+    ids[k] = -1;
+  numberOfBlocks += n;
+  return n;
+}
+
+template <int N>
+int
+WideBVH<N>::collapse(const BVH::Node* src, int i)
+//[]---------------------------------------------------[]
+//|  Collapse binary node i                             |
+//|                                                     |
+//|  The children of a wide node are found by opening,  |
+//|  while there are less than N of them, the interior  |
+//|  child with the largest surface area. Children with |
+//|  at most blockSize primitives are not opened.       |
+//[]---------------------------------------------------[]
+{
+  int children[N];
+  int n = 0;
+
+  if (isWideLeaf(src, i))
+    children[n++] = i;
+  else
+  {
+    children[n++] = i + 1;
+    children[n++] = src[i].index;
+  }
+  while (n < N)
+  {
+    int best = -1;
+    REAL bestArea = -1;
+
+    for (int k = 0; k < n; k++)
+      if (!isWideLeaf(src, children[k]))
+      {
+        REAL area = src[children[k]].bounds.area();
+
+        if (area > bestArea)
+        {
+          bestArea = area;
+          best = k;
+        }
+      }
+    if (best < 0)
+      break;
+
+    int c = children[best];
+
+    children[best] = c + 1;
+    children[n++] = src[c].index;
+  }
+
+  int w = numberOfNodes++;
+
+  nodes[w].numberOfChildren = n;
+  for (int k = 0; k < N; k++)
+  {
+    Node& node = nodes[w];
+
+    if (k >= n)
+    {
+      // Empty slot: inverted bounds are never hit
+      for (int a = 0; a < 3; a++)
+      {
+        node.bounds[0][a][k] = +FloatInfo<float>::inf();
+        node.bounds[1][a][k] = -FloatInfo<float>::inf();
+      }
+      node.child[k] = 0;
+      node.count[k] = 0;
+      continue;
+    }
+
+    const BVH::Node& c = src[children[k]];
+    const vec3& p1 = c.bounds.getMin();
+    const vec3& p2 = c.bounds.getMax();
+
+    for (int a = 0; a < 3; a++)
+    {
+      node.bounds[0][a][k] = p1[a];
+      node.bounds[1][a][k] = p2[a];
+    }
+    if (isWideLeaf(src, children[k]))
+    {
+      node.child[k] = numberOfBlocks;
+      node.count[k] = uint16(makeBlocks(src, children[k]));
+    }
+    else
+    {
+      node.child[k] = collapse(src, children[k]);
+      node.count[k] = 0;
+    }
+  }
+  return w;
+}
+
+template class WideBVH<4>;
+template class WideBVH<8>;